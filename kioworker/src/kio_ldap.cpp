@@ -8,11 +8,17 @@
 #include "kio_ldap.h"
 #include "kldap_debug.h"
 
+#include <kldapcore/ldapbatchwriter.h>
+#include <kldapcore/ldapconnectionpool.h>
+#include <kldapcore/ldapentrystream.h>
 #include <kldapcore/ldif.h>
+#include <kldapcore/ldifwriter.h>
 
 #include <KLocalizedString>
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDebug>
+#include <QHash>
 
 #ifdef Q_OS_WIN
 #include <Winsock2.h>
@@ -25,6 +31,15 @@
 using namespace KIO;
 using namespace KLDAPCore;
 
+// the page size of listDir() if the URL does not set one
+#define LISTDIR_PAGE_SIZE 500
+// the number of subordinate probes which are sent without waiting
+#define LISTDIR_MAX_PROBES 64
+// how long stat() and listDir() results are reused, in milliseconds
+#define LDAP_CACHE_TTL 30000
+// the number of UDS entries which are cached
+#define LDAP_CACHE_SIZE 65536
+
 // Pseudo plugin class to embed meta data
 class KIOPluginForMetaData : public QObject
 {
@@ -66,7 +81,7 @@ LDAPProtocol::LDAPProtocol(const QByteArray &protocol, const QByteArray &pool, c
     : WorkerBase(protocol, pool, app)
     , mProtocol(protocol)
 {
-    mOp.setConnection(mConn);
+    mCache.setMaxCost(LDAP_CACHE_SIZE);
     qCDebug(KLDAP_LOG) << "LDAPProtocol::LDAPProtocol (" << protocol << ")";
 }
 
@@ -75,16 +90,14 @@ LDAPProtocol::~LDAPProtocol()
     closeConnection();
 }
 
-KIO::WorkerResult LDAPProtocol::LDAPErr(int err)
+KIO::WorkerResult LDAPProtocol::LDAPErr(int err, const QString &info)
 {
     QString extramsg;
-    if (mConnected) {
-        if (err == KLDAP_SUCCESS) {
-            err = mConn.ldapErrorCode();
-        }
-        if (err != KLDAP_SUCCESS) {
-            extramsg = i18n("\nAdditional info: ") + mConn.ldapErrorString();
-        }
+    if (mConn && err == KLDAP_SUCCESS) {
+        err = mConn->ldapErrorCode();
+    }
+    if (err != KLDAP_SUCCESS && (mConn || !info.isEmpty())) {
+        extramsg = i18n("\nAdditional info: ") + (info.isEmpty() ? mConn->ldapErrorString() : info);
     }
     if (err == KLDAP_SUCCESS) {
         return KIO::WorkerResult::pass();
@@ -97,8 +110,10 @@ KIO::WorkerResult LDAPProtocol::LDAPErr(int err)
         msg += extramsg;
     }
 
-    /* FIXME: No need to close on all errors */
-    closeConnection();
+    // errors of single operations leave the connection usable
+    if (LdapConnectionPool::isConnectionError(err)) {
+        releaseConnection(false);
+    }
 
     switch (err) {
     /* FIXME: is it worth mapping the following error codes to kio errors?
@@ -223,25 +238,109 @@ void LDAPProtocol::LDAPEntry2UDSEntry(const LdapDN &dn, UDSEntry &entry, const L
     entry.fastInsert(KIO::UDSEntry::UDS_URL, url.toDisplayString());
 }
 
+/**
+ * Returns the key of the cached result of @p operation on @p url, or an
+ * empty string if the result must not be cached. Like the connection key,
+ * it holds only a hash of the password. Controls from the metadata may
+ * change the result, so such requests are not cached.
+ */
+QString LDAPProtocol::cacheKey(QLatin1String operation, const QUrl &url) const
+{
+    if (hasMetaData(QStringLiteral("SERVER_CTRL0")) || hasMetaData(QStringLiteral("CLIENT_CTRL0"))) {
+        return {};
+    }
+    const QByteArray password = QCryptographicHash::hash(url.password().toUtf8(), QCryptographicHash::Sha256);
+    return QString(operation) + QLatin1Char(':') + url.toString(QUrl::RemovePassword) + QLatin1Char('\n') + QString::fromLatin1(password.toHex());
+}
+
+const LDAPProtocol::CacheEntry *LDAPProtocol::cachedEntry(const QString &key)
+{
+    if (key.isEmpty()) {
+        return nullptr;
+    }
+    const CacheEntry *entry = mCache.object(key);
+    if (entry && entry->expiry.hasExpired()) {
+        mCache.remove(key);
+        return nullptr;
+    }
+    return entry;
+}
+
+void LDAPProtocol::cacheEntry(const QString &key, const LdapDN &dn, const UDSEntryList &entries)
+{
+    if (key.isEmpty()) {
+        return;
+    }
+    auto entry = new CacheEntry;
+    entry->dn = dn;
+    entry->expiry = QDeadlineTimer(LDAP_CACHE_TTL);
+    entry->entries = entries;
+    mCache.insert(key, entry, qMax<qsizetype>(1, entries.count()));
+}
+
+static QString kldap_normalized_dn(const LdapDN &dn)
+{
+    QString str = dn.toString().toLower();
+    str.replace(QLatin1String(", "), QLatin1String(","));
+    return str;
+}
+
+/**
+ * Returns the DN which a rename of @p dn to @p newRdn below @p newSuperior,
+ * or below the old parent if it is empty, gives the entry.
+ */
+static LdapDN kldap_renamed_dn(const LdapDN &dn, const QString &newRdn, const QString &newSuperior)
+{
+    const QString parent = newSuperior.isEmpty() ? dn.toString(dn.depth() - 2) : newSuperior;
+    return LdapDN(parent.isEmpty() ? newRdn : newRdn + QLatin1Char(',') + parent);
+}
+
+/**
+ * Drops the cached results which a change of @p dn may affect: those of
+ * the entry, of its ancestors, whose listings contain it, and of the
+ * entries below it, which a rename moves.
+ */
+void LDAPProtocol::invalidateCache(const LdapDN &dn)
+{
+    const QString changed = kldap_normalized_dn(dn);
+    const QList<QString> keys = mCache.keys();
+    for (const QString &key : keys) {
+        const QString cached = kldap_normalized_dn(mCache.object(key)->dn);
+        if (cached.isEmpty() || changed.isEmpty() || cached == changed || changed.endsWith(QLatin1Char(',') + cached)
+            || cached.endsWith(QLatin1Char(',') + changed)) {
+            mCache.remove(key);
+        }
+    }
+}
+
 KIO::WorkerResult LDAPProtocol::changeCheck(const LdapUrl &url)
 {
     LdapServer server;
     server.setUrl(url);
 
-    if (mConnected) {
-        if (server.host() != mServer.host() || server.port() != mServer.port() || server.baseDn() != mServer.baseDn() || server.user() != mServer.user()
-            || server.bindDn() != mServer.bindDn() || server.realm() != mServer.realm() || server.password() != mServer.password()
-            || server.timeLimit() != mServer.timeLimit() || server.sizeLimit() != mServer.sizeLimit() || server.version() != mServer.version()
-            || server.security() != mServer.security() || server.auth() != mServer.auth() || server.mech() != mServer.mech()) {
-            closeConnection();
-            mServer = server;
-            return openConnection();
-        }
-        return KIO::WorkerResult::pass();
+    // only another transport or other credentials need another connection
+    const QByteArray key = LdapConnectionPool::connectionKey(server);
+    if (mConn && key != mConnKey) {
+        closeConnection();
+    }
+    if (!mConn) {
+        mServer = server;
+        mConnKey = key;
+        return openConnection();
     }
 
+    // the base DN and the limits are applied per operation, keep the credentials the bind used
+    server.setBindDn(mServer.bindDn());
+    server.setUser(mServer.user());
+    server.setPassword(mServer.password());
     mServer = server;
-    return openConnection();
+    mConn->setServer(mServer);
+    // an operation which failed before left its error behind
+    mConn->clearLdapError();
+    if (!mConn->setSizeLimit(mServer.sizeLimit()) || !mConn->setTimeLimit(mServer.timeLimit())) {
+        return LDAPErr();
+    }
+    return KIO::WorkerResult::pass();
 }
 
 void LDAPProtocol::setHost(const QString &host, quint16 port, const QString &user, const QString &password)
@@ -273,17 +372,10 @@ void LDAPProtocol::setHost(const QString &host, quint16 port, const QString &use
 
 KIO::WorkerResult LDAPProtocol::openConnection()
 {
-    if (mConnected) {
+    if (mConn) {
         return KIO::WorkerResult::pass();
     }
 
-    mConn.setServer(mServer);
-    if (mConn.connect() != 0) {
-        return KIO::WorkerResult::fail(ERR_CANNOT_CONNECT, mConn.connectionError());
-    }
-
-    mConnected = true;
-
     AuthInfo info;
     info.url.setScheme(QLatin1String(mProtocol));
     info.url.setHost(mServer.host());
@@ -300,8 +392,11 @@ KIO::WorkerResult LDAPProtocol::openConnection()
     bool firstauth = true;
 
     while (true) {
-        int retval = mOp.bind_s();
-        if (retval == 0) {
+        // an idle connection with the same transport and credentials is reused without binding again
+        int retval;
+        QString errorString;
+        mConn = LdapConnectionPool::self()->acquire(mServer, retval, errorString);
+        if (mConn) {
             break;
         }
         if (retval == KLDAP_INVALID_CREDENTIALS || retval == KLDAP_INSUFFICIENT_ACCESS || retval == KLDAP_INAPPROPRIATE_AUTH
@@ -313,7 +408,6 @@ KIO::WorkerResult LDAPProtocol::openConnection()
                     mServer.setBindDn(info.username);
                 }
                 mServer.setPassword(info.password);
-                mConn.setServer(mServer);
                 cached = false;
             } else {
                 const int errorCode = firstauth ? openPasswordDialog(info) : openPasswordDialog(info, i18n("Invalid authorization information."));
@@ -322,7 +416,6 @@ KIO::WorkerResult LDAPProtocol::openConnection()
                         cacheAuthentication(info);
                     }
                 } else {
-                    closeConnection();
                     if (errorCode == ERR_USER_CANCELED) {
                         return KIO::WorkerResult::fail(ERR_USER_CANCELED, i18n("LDAP connection canceled."));
                     }
@@ -335,26 +428,33 @@ KIO::WorkerResult LDAPProtocol::openConnection()
                 }
                 mServer.setPassword(info.password);
                 firstauth = false;
-                mConn.setServer(mServer);
             }
+        } else if (retval == KLDAP_BUSY || retval == KLDAP_SASL_ERROR || LdapConnectionPool::isConnectionError(retval)) {
+            return KIO::WorkerResult::fail(ERR_CANNOT_CONNECT, errorString);
         } else {
-            const KIO::WorkerResult errorResult = LDAPErr(retval);
-            // TODO: ensure that LDAPErr(retval) always closes the connection, avoiding the explicit call
-            closeConnection();
-            return errorResult;
+            return LDAPErr(retval, errorString);
         }
     }
 
+    mOp.setConnection(*mConn);
     qCDebug(KLDAP_LOG) << "connected!";
     return KIO::WorkerResult::pass();
 }
 
-void LDAPProtocol::closeConnection()
+void LDAPProtocol::releaseConnection(bool reusable)
 {
-    if (mConnected) {
-        mConn.close();
+    if (mConn) {
+        LdapConnectionPool::self()->release(mConn, reusable);
+        mConn = nullptr;
     }
-    mConnected = false;
+    // the next connection may see the directory with other rights
+    mCache.clear();
+}
+
+void LDAPProtocol::closeConnection()
+{
+    // the pool keeps the connection for a while, so switching back to it is cheap
+    releaseConnection(true);
 
     qCDebug(KLDAP_LOG) << "connection closed!";
 }
@@ -390,16 +490,20 @@ KIO::WorkerResult LDAPProtocol::get(const QUrl &_url)
         return LDAPErr();
     }
 
+    // clients which can decode it ask for the binary stream instead of LDIF
+    const bool binary = metaData(QStringLiteral("x-kldap-format")) == QLatin1String("binary");
+
     // tell the mimetype
-    mimeType(QStringLiteral("text/plain"));
+    mimeType(binary ? LdapEntryStream::mimeType() : QStringLiteral("text/plain"));
     // collect the result
-    // QByteArray result;
+    LdifWriter writer;
+    LdapEntryStream stream;
     filesize_t processed_size = 0;
 
     int ret;
     while (true) {
         ret = mOp.waitForResult(id, -1);
-        if (ret == -1 || mConn.ldapErrorCode() != KLDAP_SUCCESS) {
+        if (ret == -1 || mConn->ldapErrorCode() != KLDAP_SUCCESS) {
             return LDAPErr();
         }
         qCDebug(KLDAP_LOG) << " ldap_result: " << ret;
@@ -432,9 +536,17 @@ KIO::WorkerResult LDAPProtocol::get(const QUrl &_url)
             continue;
         }
 
-        QByteArray entry = mOp.object().toString().toUtf8() + '\n';
-        processed_size += entry.size();
-        data(entry);
+        if (binary) {
+            stream.writeObject(mOp.object());
+            processed_size += stream.data().size();
+            data(stream.data());
+            stream.clear();
+        } else {
+            writer.writeObject(mOp.object());
+            processed_size += writer.data().size();
+            data(writer.data());
+            writer.clear();
+        }
         processedSize(processed_size);
     }
 
@@ -454,6 +566,12 @@ KIO::WorkerResult LDAPProtocol::stat(const QUrl &_url)
 
     LdapUrl usrc(_url);
 
+    const QString key = cacheKey(QLatin1String("stat"), _url);
+    if (const CacheEntry *entry = cachedEntry(key)) {
+        statEntry(entry->entries.constFirst());
+        return KIO::WorkerResult::pass();
+    }
+
     const KIO::WorkerResult checkResult = changeCheck(usrc);
     if (!checkResult.success()) {
         return checkResult;
@@ -461,6 +579,13 @@ KIO::WorkerResult LDAPProtocol::stat(const QUrl &_url)
 
     int ret;
     int id;
+    // don't search with controls left over from an earlier operation
+    LdapControls serverctrls;
+    LdapControls clientctrls;
+    controlsFromMetaData(serverctrls, clientctrls);
+    mOp.setServerControls(serverctrls);
+    mOp.setClientControls(clientctrls);
+
     // look how many entries match
     const QStringList saveatt = usrc.attributes();
     QStringList att{QStringLiteral("dn")};
@@ -472,10 +597,11 @@ KIO::WorkerResult LDAPProtocol::stat(const QUrl &_url)
     qCDebug(KLDAP_LOG) << "stat() getting result";
     do {
         ret = mOp.waitForResult(id, -1);
-        if (ret == -1 || mConn.ldapErrorCode() != KLDAP_SUCCESS) {
+        if (ret == -1 || mConn->ldapErrorCode() != KLDAP_SUCCESS) {
             return LDAPErr();
         }
         if (ret == LdapOperation::RES_SEARCH_RESULT) {
+            // not cached, the entry may be created by another worker at any time
             return KIO::WorkerResult::fail(ERR_DOES_NOT_EXIST, _url.toDisplayString());
         }
     } while (ret != LdapOperation::RES_SEARCH_ENTRY);
@@ -488,6 +614,7 @@ KIO::WorkerResult LDAPProtocol::stat(const QUrl &_url)
     bool critical;
     LDAPEntry2UDSEntry(usrc.dn(), uds, usrc, usrc.extension(QStringLiteral("x-dir"), critical) != QLatin1String("base"));
 
+    cacheEntry(key, usrc.dn(), UDSEntryList{uds});
     statEntry(uds);
     // we are done
     return KIO::WorkerResult::pass();
@@ -514,6 +641,7 @@ KIO::WorkerResult LDAPProtocol::del(const QUrl &_url, bool)
     mOp.setClientControls(clientctrls);
 
     qCDebug(KLDAP_LOG) << " del: " << usrc.dn().toString().toUtf8();
+    invalidateCache(usrc.dn());
     int id;
     int ret;
 
@@ -521,13 +649,20 @@ KIO::WorkerResult LDAPProtocol::del(const QUrl &_url, bool)
         return LDAPErr();
     }
     ret = mOp.waitForResult(id, -1);
-    if (ret == -1 || mConn.ldapErrorCode() != KLDAP_SUCCESS) {
+    if (ret == -1 || mConn->ldapErrorCode() != KLDAP_SUCCESS) {
         return LDAPErr();
     }
 
     return KIO::WorkerResult::pass();
 }
 
+KIO::WorkerResult LDAPProtocol::putErr(const LdapBatchWriter &writer)
+{
+    const LdapBatchWriter::Result error = writer.firstError();
+    qCDebug(KLDAP_LOG) << "put ldap error: " << error.error << " in line " << error.line;
+    return LDAPErr(error.error, i18n("%1 (entry %2 in line %3)", error.errorString, error.dn.toString(), error.line));
+}
+
 KIO::WorkerResult LDAPProtocol::put(const QUrl &_url, int, KIO::JobFlags flags)
 {
     qCDebug(KLDAP_LOG) << "put(" << _url << ")";
@@ -552,7 +687,21 @@ KIO::WorkerResult LDAPProtocol::put(const QUrl &_url, int, KIO::JobFlags flags)
     Ldif::ParseValue ret;
     Ldif ldif;
     ret = Ldif::MoreData;
-    int ldaperr;
+    uint entryLine = 0;
+    bool submitted;
+
+    // send the records without waiting for each response
+    LdapBatchWriter writer(*mConn);
+    writer.setReplaceExisting(flags.testFlag(KIO::Overwrite));
+    writer.setServerControls(serverctrls);
+    writer.setClientControls(clientctrls);
+    // the operations in flight are waited for, so the reported error tells what was applied
+    const auto fail = [this, &writer](const KIO::WorkerResult &failure) {
+        if (!writer.finish()) {
+            return putErr(writer);
+        }
+        return failure;
+    };
 
     do {
         if (ret == Ldif::MoreData) {
@@ -562,7 +711,7 @@ KIO::WorkerResult LDAPProtocol::put(const QUrl &_url, int, KIO::JobFlags flags)
         }
         if (result < 0) {
             // error
-            return KIO::WorkerResult::fail();
+            return fail(KIO::WorkerResult::fail());
         }
         if (result == 0) {
             qCDebug(KLDAP_LOG) << "EOF!";
@@ -574,45 +723,45 @@ KIO::WorkerResult LDAPProtocol::put(const QUrl &_url, int, KIO::JobFlags flags)
 
             switch (ret) {
             case Ldif::None:
-            case Ldif::NewEntry:
             case Ldif::MoreData:
                 break;
+            case Ldif::NewEntry:
+                entryLine = ldif.lineNumber();
+                break;
             case Ldif::EndEntry:
-                ldaperr = KLDAP_SUCCESS;
+                submitted = false;
                 switch (ldif.entryType()) {
                 case Ldif::Entry_None:
-                    return KIO::WorkerResult::fail(ERR_INTERNAL, i18n("The Ldif parser failed."));
+                    return fail(KIO::WorkerResult::fail(ERR_INTERNAL, i18n("The Ldif parser failed.")));
                 case Ldif::Entry_Del:
                     qCDebug(KLDAP_LOG) << "kio_ldap_del";
-                    ldaperr = mOp.del_s(ldif.dn());
+                    invalidateCache(ldif.dn());
+                    submitted = writer.del(ldif.dn(), entryLine);
                     break;
                 case Ldif::Entry_Modrdn:
                     qCDebug(KLDAP_LOG) << "kio_ldap_modrdn olddn:" << ldif.dn().toString() << " newRdn: " << ldif.newRdn()
                                        << " newSuperior: " << ldif.newSuperior() << " deloldrdn: " << ldif.delOldRdn();
-                    ldaperr = mOp.rename_s(ldif.dn(), ldif.newRdn(), ldif.newSuperior(), ldif.delOldRdn());
+                    invalidateCache(ldif.dn());
+                    invalidateCache(kldap_renamed_dn(ldif.dn(), ldif.newRdn(), ldif.newSuperior()));
+                    submitted = writer.rename(ldif.dn(), ldif.newRdn(), ldif.newSuperior(), ldif.delOldRdn(), entryLine);
                     break;
                 case Ldif::Entry_Mod:
                     qCDebug(KLDAP_LOG) << "kio_ldap_mod";
-                    ldaperr = mOp.modify_s(ldif.dn(), modops);
+                    invalidateCache(ldif.dn());
+                    submitted = writer.modify(ldif.dn(), modops, entryLine);
                     modops.clear();
                     break;
                 case Ldif::Entry_Add:
                     qCDebug(KLDAP_LOG) << "kio_ldap_add " << ldif.dn().toString();
+                    invalidateCache(ldif.dn());
                     addObject.setDn(ldif.dn());
-                    ldaperr = mOp.add_s(addObject);
-                    if (ldaperr == KLDAP_ALREADY_EXISTS && (flags & KIO::Overwrite)) {
-                        qCDebug(KLDAP_LOG) << ldif.dn().toString() << " already exists, delete first";
-                        ldaperr = mOp.del_s(ldif.dn());
-                        if (ldaperr == KLDAP_SUCCESS) {
-                            ldaperr = mOp.add_s(addObject);
-                        }
-                    }
-                    addObject.clear();
+                    submitted = writer.add(addObject, entryLine);
+                    addObject = LdapObject();
                     break;
                 }
-                if (ldaperr != KLDAP_SUCCESS) {
-                    qCDebug(KLDAP_LOG) << "put ldap error: " << ldaperr;
-                    return LDAPErr(ldaperr);
+                if (!submitted) {
+                    writer.finish();
+                    return putErr(writer);
                 }
                 break;
             case Ldif::Item:
@@ -647,120 +796,228 @@ KIO::WorkerResult LDAPProtocol::put(const QUrl &_url, int, KIO::JobFlags flags)
                     }
                     break;
                 default:
-                    return KIO::WorkerResult::fail(ERR_INTERNAL, i18n("The Ldif parser failed."));
+                    return fail(KIO::WorkerResult::fail(ERR_INTERNAL, i18n("The Ldif parser failed.")));
                 }
                 break;
             case Ldif::Control: {
                 LdapControl control;
                 control.setControl(ldif.oid(), ldif.value(), ldif.isCritical());
                 serverctrls.append(control);
-                mOp.setServerControls(serverctrls);
+                writer.setServerControls(serverctrls);
                 break;
             }
             case Ldif::Err:
-                return KIO::WorkerResult::fail(KIO::ERR_WORKER_DEFINED, i18n("Invalid Ldif file in line %1.", ldif.lineNumber()));
+                return fail(KIO::WorkerResult::fail(KIO::ERR_WORKER_DEFINED, i18n("Invalid Ldif file in line %1.", ldif.lineNumber())));
             }
         } while (ret != Ldif::MoreData);
     } while (result > 0);
 
+    if (!writer.finish()) {
+        return putErr(writer);
+    }
     return KIO::WorkerResult::pass();
 }
 
+/**
+ * Returns 1 if the server says that @p object has subordinates, 0 if it
+ * says that it has none, or -1 if it does not say.
+ */
+static int kldap_has_subordinates(const LdapObject &object)
+{
+    static const LdapAttributeName hasSubordinates(QStringLiteral("hasSubordinates"));
+    static const LdapAttributeName numSubordinates(QStringLiteral("numSubordinates"));
+
+    const QByteArray has = object.value(hasSubordinates);
+    if (!has.isEmpty()) {
+        return has.compare("TRUE", Qt::CaseInsensitive) == 0 ? 1 : 0;
+    }
+    const QByteArray num = object.value(numSubordinates);
+    if (!num.isEmpty()) {
+        return num.toLongLong() > 0 ? 1 : 0;
+    }
+    return -1;
+}
+
+/**
+ * Lists the entries of @p dns which have subordinates as directories. The
+ * one-level searches are pipelined, so they cost about one round trip.
+ * Returns false if a search could not be sent or the connection failed,
+ * the error is left on the connection for LDAPErr().
+ */
+bool LDAPProtocol::probeSubordinates(const QList<LdapDN> &dns, const LdapUrl &usrc, UDSEntryList &entries)
+{
+    const QStringList att{QStringLiteral("1.1")};
+    QHash<int, qsizetype> pending;
+    qsizetype next = 0;
+    while (next < dns.size() || !pending.isEmpty()) {
+        while (next < dns.size() && pending.size() < LISTDIR_MAX_PROBES) {
+            const int id = mOp.search(dns.at(next), LdapUrl::One, QString(), att);
+            if (id == -1) {
+                abandonProbes(pending);
+                return false;
+            }
+            pending.insert(id, next);
+            ++next;
+        }
+        const int ret = mOp.waitForResult(-1, -1);
+        if (ret == -1) {
+            abandonProbes(pending);
+            return false;
+        }
+        const auto it = pending.constFind(mOp.messageId());
+        if (it == pending.cend()) {
+            continue;
+        }
+        if (ret == LdapOperation::RES_SEARCH_ENTRY) {
+            UDSEntry uds;
+            LDAPEntry2UDSEntry(dns.at(it.value()), uds, usrc, true);
+            entries.append(uds);
+            (void)mOp.abandon(it.key());
+            pending.erase(it);
+        } else if (ret == LdapOperation::RES_SEARCH_RESULT) {
+            pending.erase(it);
+        }
+    }
+    return true;
+}
+
+void LDAPProtocol::abandonProbes(const QHash<int, qsizetype> &pending)
+{
+    for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+        (void)mOp.abandon(it.key());
+    }
+}
+
 /**
  * List the contents of a directory.
  */
 KIO::WorkerResult LDAPProtocol::listDir(const QUrl &_url)
 {
-    QStringList att;
     LdapUrl usrc(_url);
 
     qCDebug(KLDAP_LOG) << "listDir(" << _url << ")";
 
+    const QString key = cacheKey(QLatin1String("list"), _url);
+    if (const CacheEntry *entry = cachedEntry(key)) {
+        listEntries(entry->entries);
+        return KIO::WorkerResult::pass();
+    }
+
     const KIO::WorkerResult checkResult = changeCheck(usrc);
     if (!checkResult.success()) {
         return checkResult;
     }
 
-    LdapUrl usrc2 = usrc;
+    const LdapUrl usrc2 = usrc;
 
-    const QStringList saveatt = usrc.attributes();
     bool critical = true;
     bool isSub = (usrc.extension(QStringLiteral("x-dir"), critical) == QLatin1String("sub"));
-    // look up the entries
+    // only the DNs are listed, with x-dir=sub the server tells which entries have children
+    QStringList att;
     if (isSub) {
-        att.append(QStringLiteral("dn"));
-        usrc.setAttributes(att);
+        att << QStringLiteral("hasSubordinates") << QStringLiteral("numSubordinates");
+    } else {
+        att << QStringLiteral("1.1");
     }
     if (_url.query().isEmpty()) {
         usrc.setScope(LdapUrl::One);
     }
-    int id;
 
-    if ((id = mOp.search(usrc.dn(), usrc.scope(), usrc.filter(), usrc.attributes())) == -1) {
-        return LDAPErr();
-    }
+    LdapControls serverctrls;
+    LdapControls clientctrls;
+    controlsFromMetaData(serverctrls, clientctrls);
+    mOp.setClientControls(clientctrls);
+    const int pageSize = mServer.pageSize() > 0 ? mServer.pageSize() : LISTDIR_PAGE_SIZE;
+    const LdapDN dn = usrc.dn();
+    const LdapUrl::Scope scope = usrc.scope();
+    const QString filter = usrc.filter();
 
     usrc.setAttributes(QStringList() << QLatin1String(""));
     usrc.setExtension(QStringLiteral("x-dir"), QStringLiteral("base"));
-    // publish the results
-    UDSEntry uds;
 
-    int ret2;
-    int id2;
+    // publish the results a page at a time
+    UDSEntryList entries;
+    UDSEntryList listed;
+    QList<LdapDN> probes;
+    QByteArray cookie;
     unsigned long total = 0;
+    // the page control must not stay on the operation for the following requests
+    const auto fail = [this, &serverctrls]() {
+        mOp.setServerControls(serverctrls);
+        return LDAPErr();
+    };
 
-    int ret;
     while (true) {
-        ret = mOp.waitForResult(id, -1);
-        if (ret == -1 || mConn.ldapErrorCode() != KLDAP_SUCCESS) {
-            return LDAPErr();
-        }
-        if (ret == LdapOperation::RES_SEARCH_RESULT) {
-            break;
-        }
-        if (ret != LdapOperation::RES_SEARCH_ENTRY) {
-            continue;
+        LdapControls ctrls{serverctrls};
+        ctrls.append(LdapControl::createPageControl(pageSize, cookie));
+        mOp.setServerControls(ctrls);
+        int id;
+        if ((id = mOp.search(dn, scope, filter, att)) == -1) {
+            return fail();
         }
-        qCDebug(KLDAP_LOG) << " ldap_result: " << ret;
-
-        total++;
-        uds.clear();
+        cookie.clear();
 
-        LDAPEntry2UDSEntry(mOp.object().dn(), uds, usrc);
-        listEntry(uds);
-        //      processedSize( total );
-        qCDebug(KLDAP_LOG) << " total: " << total << " " << usrc.toDisplayString();
-
-        // publish the sub-directories (if dirmode==sub)
-        if (isSub) {
-            LdapDN dn = mOp.object().dn();
-            usrc2.setDn(dn);
-            usrc2.setScope(LdapUrl::One);
-            usrc2.setAttributes(saveatt);
-            usrc2.setFilter(usrc.filter());
-            qCDebug(KLDAP_LOG) << "search2 " << dn.toString();
-            if ((id2 = mOp.search(dn, LdapUrl::One, QString(), att)) != -1) {
-                while (true) {
-                    qCDebug(KLDAP_LOG) << " next result ";
-                    ret2 = mOp.waitForResult(id2, -1);
-                    if (ret2 == -1 || ret2 == LdapOperation::RES_SEARCH_RESULT) {
-                        break;
-                    }
-                    if (ret2 == LdapOperation::RES_SEARCH_ENTRY) {
-                        LDAPEntry2UDSEntry(dn, uds, usrc2, true);
-                        listEntry(uds);
-                        total++;
-                        mOp.abandon(id2);
+        int ret;
+        while (true) {
+            ret = mOp.waitForResult(id, -1);
+            if (ret == -1 || mConn->ldapErrorCode() != KLDAP_SUCCESS) {
+                return fail();
+            }
+            if (ret == LdapOperation::RES_SEARCH_RESULT) {
+                for (int i = 0; i < mOp.controls().count(); ++i) {
+                    if (mOp.controls().at(i).parsePageControl(cookie) != -1) {
                         break;
                     }
                 }
+                break;
+            }
+            if (ret != LdapOperation::RES_SEARCH_ENTRY) {
+                continue;
+            }
+
+            const LdapObject object = mOp.object();
+            UDSEntry uds;
+            LDAPEntry2UDSEntry(object.dn(), uds, usrc);
+            entries.append(uds);
+
+            // publish the sub-directories (if dirmode==sub)
+            if (isSub) {
+                switch (kldap_has_subordinates(object)) {
+                case 1:
+                    LDAPEntry2UDSEntry(object.dn(), uds, usrc2, true);
+                    entries.append(uds);
+                    break;
+                case -1:
+                    probes.append(object.dn());
+                    break;
+                default:
+                    break;
+                }
             }
         }
-    }
 
-    //  totalSize( total );
+        // the probes and the next page must not send the cookie of this one
+        mOp.setServerControls(serverctrls);
+        if (!probes.isEmpty()) {
+            // the server does not know the operational attributes
+            if (!probeSubordinates(probes, usrc2, entries)) {
+                return fail();
+            }
+            probes.clear();
+        }
+
+        total += entries.count();
+        qCDebug(KLDAP_LOG) << " total: " << total << " " << usrc.toDisplayString();
+        listEntries(entries);
+        listed += entries;
+        entries.clear();
+
+        if (cookie.isEmpty()) {
+            break;
+        }
+    }
 
-    uds.clear();
+    cacheEntry(key, dn, listed);
     // we are done
     return KIO::WorkerResult::pass();
 }
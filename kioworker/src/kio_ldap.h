@@ -16,6 +16,15 @@
 #include <kldapcore/ldapoperation.h>
 #include <kldapcore/ldapurl.h>
 
+#include <QCache>
+#include <QDeadlineTimer>
+#include <QHash>
+
+namespace KLDAPCore
+{
+class LdapBatchWriter;
+}
+
 class LDAPProtocol : public KIO::WorkerBase
 {
 public:
@@ -34,15 +43,36 @@ public:
     KIO::WorkerResult put(const QUrl &url, int permissions, KIO::JobFlags flags) override;
 
 private:
+    /**
+     * The result of a stat() or listDir(). Only found entries are cached.
+     */
+    struct CacheEntry {
+        KLDAPCore::LdapDN dn;
+        QDeadlineTimer expiry;
+        KIO::UDSEntryList entries;
+    };
+
     QByteArray mProtocol;
-    KLDAPCore::LdapConnection mConn;
+    // borrowed from the connection pool, nullptr if not connected
+    KLDAPCore::LdapConnection *mConn = nullptr;
     KLDAPCore::LdapOperation mOp;
     KLDAPCore::LdapServer mServer;
-    bool mConnected = false;
+    // the transport and credentials of the URL mConn was opened for
+    QByteArray mConnKey;
+    QCache<QString, CacheEntry> mCache;
 
+    void releaseConnection(bool reusable);
     void controlsFromMetaData(KLDAPCore::LdapControls &serverctrls, KLDAPCore::LdapControls &clientctrls);
     void LDAPEntry2UDSEntry(const KLDAPCore::LdapDN &dn, KIO::UDSEntry &entry, const KLDAPCore::LdapUrl &usrc, bool dir = false);
+    bool probeSubordinates(const QList<KLDAPCore::LdapDN> &dns, const KLDAPCore::LdapUrl &usrc, KIO::UDSEntryList &entries);
+    void abandonProbes(const QHash<int, qsizetype> &pending);
+
+    QString cacheKey(QLatin1String operation, const QUrl &url) const;
+    const CacheEntry *cachedEntry(const QString &key);
+    void cacheEntry(const QString &key, const KLDAPCore::LdapDN &dn, const KIO::UDSEntryList &entries);
+    void invalidateCache(const KLDAPCore::LdapDN &dn);
 
-    KIO::WorkerResult LDAPErr(int err = KLDAP_SUCCESS);
+    KIO::WorkerResult LDAPErr(int err = KLDAP_SUCCESS, const QString &info = QString());
+    KIO::WorkerResult putErr(const KLDAPCore::LdapBatchWriter &writer);
     KIO::WorkerResult changeCheck(const KLDAPCore::LdapUrl &url);
 };
@@ -9,19 +9,57 @@
 #include "testkldap.h"
 
 #include "ber.h"
+#include "bercodec.h"
+#include "berformat.h"
+#include "ldapattributename.h"
+#include "ldapbatchschedule_p.h"
+#include "ldapcompletionindex.h"
 #include "ldapconnection.h"
 #include "ldapdn.h"
+#include "ldapentrystream.h"
+#include "ldapfilter.h"
+#include "ldapfilterbuilder.h"
+#include "ldapmodel.h"
 #include "ldapoperation.h"
 #include "ldapsearch.h"
 #include "ldapserver.h"
 #include "ldapurl.h"
 #include "ldif.h"
+#include "ldifwriter.h"
 
 #include <QDebug>
 #include <QFile>
+#include <QTemporaryDir>
 #include <QTest>
 QTEST_MAIN(KLdapTest)
 
+namespace
+{
+// accepts at most a few bytes per write, like a full pipe
+class ShortWriteDevice : public QIODevice
+{
+public:
+    ShortWriteDevice()
+    {
+        open(QIODevice::WriteOnly);
+    }
+
+    QByteArray written;
+
+protected:
+    qint64 readData(char *, qint64) override
+    {
+        return -1;
+    }
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        const qint64 accepted = qMin<qint64>(size, 1000);
+        written.append(data, accepted);
+        return accepted;
+    }
+};
+}
+
 KLdapTest::KLdapTest(QObject *parent)
     : QObject(parent)
 {
@@ -129,6 +167,92 @@ void KLdapTest::testBer()
     QCOMPARE(aoctetString2, boctetString2);
     QCOMPARE(alist2, blist2);
     QCOMPARE(ainteger, binteger);
+
+    // the native codec must agree with liblber
+    const QByteArray longString(300, 'x');
+    BerWriter writer;
+    writer.beginSequence();
+    writer.writeInteger(ainteger);
+    writer.writeInteger(-129);
+    writer.writeOctetString(longString);
+    writer.endSequence();
+    QVERIFY(writer.isComplete());
+    Ber ber8;
+    int negative = -129;
+    QByteArray longCopy = longString;
+    ber8.printf(QStringLiteral("{iiO}"), ainteger, negative, &longCopy);
+    const QByteArray encoded = writer.data();
+    QCOMPARE(encoded, ber8.flatten());
+
+    BerReader reader(encoded);
+    qint64 integer;
+    int smallInteger;
+    QByteArrayView view;
+    QVERIFY(reader.enterSequence());
+    QVERIFY(!reader.readOctetString(view));
+    QVERIFY(reader.readInteger(integer));
+    QCOMPARE(integer, qint64(ainteger));
+    QVERIFY(reader.readInteger(smallInteger));
+    QCOMPARE(smallInteger, -129);
+    QVERIFY(reader.readOctetString(view));
+    QCOMPARE(view.toByteArray(), longString);
+    QVERIFY(reader.leaveSequence());
+    QVERIFY(reader.atEnd());
+    QVERIFY(!reader.hasError());
+
+    // the compile-time formats produce the same encoding
+    using Format = BerFormat::Seq<BerFormat::Int, BerFormat::Int, BerFormat::OctetString>;
+    QCOMPARE(BerFormat::encode<Format>(ainteger, -129, longString), encoded);
+    int first;
+    qint64 second;
+    QByteArray third;
+    QVERIFY(BerFormat::decode<Format>(encoded, first, second, third));
+    QCOMPARE(first, ainteger);
+    QCOMPARE(second, qint64(-129));
+    QCOMPARE(third, longString);
+    qint8 tooSmall;
+    QVERIFY(!BerFormat::decode<BerFormat::Seq<BerFormat::Int, BerFormat::Int, BerFormat::OctetString>>(encoded, tooSmall, second, third));
+
+    // lengths beyond the data are rejected
+    const QByteArray truncatedData = encoded.left(20);
+    BerReader truncated(truncatedData);
+    QVERIFY(!truncated.enterSequence());
+    QVERIFY(truncated.hasError());
+
+    // sort and virtual list view controls
+    LdapControl::SortKey sn;
+    sn.attribute = QStringLiteral("sn");
+    sn.reverse = true;
+    const LdapControl sort = LdapControl::createSortControl({sn});
+    QCOMPARE(sort.value(), QByteArray::fromHex("300930070402736e8101ff"));
+    const LdapControl vlv = LdapControl::createVlvControl(0, 19, 101);
+    QCOMPARE(vlv.value(), QByteArray::fromHex("300e020100020113a006020165020100"));
+    QVERIFY(vlv.critical());
+
+    int position = 0;
+    int count = 0;
+    QByteArray context;
+    const LdapControl vlvResponse(QStringLiteral("2.16.840.1.113730.3.4.10"), QByteArray::fromHex("300f020165020203e80a01000403616263"));
+    QCOMPARE(vlvResponse.parseVlvControl(position, count, context), 0);
+    QCOMPARE(position, 101);
+    QCOMPARE(count, 1000);
+    QCOMPARE(context, QByteArray("abc"));
+    QCOMPARE(vlv.parseVlvControl(position, count, context), -1);
+    QString attribute;
+    const LdapControl sortResponse(QStringLiteral("1.2.840.113556.1.4.474"), QByteArray::fromHex("30070a01108002736e"));
+    QCOMPARE(sortResponse.parseSortControl(attribute), 16);
+    QCOMPARE(attribute, QStringLiteral("sn"));
+
+    // content synchronization controls
+    QCOMPARE(LdapControl::createSyncRequestControl(LdapControl::SyncRefreshOnly, "c").value(), QByteArray::fromHex("30060a0101040163"));
+    const QByteArray uuid(16, '\x11');
+    QByteArray cookie;
+    const LdapControl syncState(QStringLiteral("1.3.6.1.4.1.4203.1.9.1.2"), QByteArray::fromHex("30150a01020410" "11111111111111111111111111111111"));
+    QCOMPARE(syncState.parseSyncStateControl(context, cookie), int(LdapControl::SyncModify));
+    QCOMPARE(context, uuid);
+    QVERIFY(cookie.isEmpty());
+    const LdapControl syncDone(QStringLiteral("1.3.6.1.4.1.4203.1.9.1.3"), QByteArray::fromHex("30030101ff"));
+    QCOMPARE(syncDone.parseSyncDoneControl(cookie), 1);
 }
 
 void KLdapTest::cleanupTestCase()
@@ -252,12 +376,209 @@ void KLdapTest::testLdapDN()
     QCOMPARE(dn.rdnString(), QStringLiteral("uid=Test\\+Person+ou=accounts\\,outgoing"));
 }
 
+void KLdapTest::testLdapObject()
+{
+    const LdapAttributeName mail(QStringLiteral("mail"));
+    QCOMPARE(LdapAttributeName(QStringLiteral("Mail")), mail);
+    QCOMPARE(LdapAttributeName::fromUtf8(QByteArray("MAIL")), mail);
+    QCOMPARE(LdapAttributeName(QStringLiteral("Mail")).name(), QStringLiteral("Mail"));
+    QCOMPARE(LdapAttributeName(QStringLiteral("Mail")).foldedName(), QStringLiteral("mail"));
+    QVERIFY(!LdapAttributeName(QString()).isValid());
+
+    LdapObject object(QStringLiteral("cn=Test,dc=kde,dc=org"));
+    object.addValue(QStringLiteral("cn"), "Test");
+    object.addValue(QStringLiteral("mail"), "test@kde.org");
+    object.addValue(QStringLiteral("objectClass"), "person");
+    object.addValue(QStringLiteral("cn"), "Test Person");
+    object.addValue(QStringLiteral("MAIL"), "person@kde.org");
+    QCOMPARE(object.values(QStringLiteral("cn")), LdapAttrValue({"Test", "Test Person"}));
+    QCOMPARE(object.values(mail), LdapAttrValue({"test@kde.org", "person@kde.org"}));
+    QCOMPARE(object.value(QStringLiteral("ObjectClass")), QByteArray("person"));
+    QVERIFY(!object.hasAttribute(QStringLiteral("sn")));
+
+    object.setValues(QStringLiteral("cn"), {"Other"});
+    QCOMPARE(object.values(QStringLiteral("CN")), LdapAttrValue({"Other"}));
+    QCOMPARE(object.attributes().count(), 3);
+    QCOMPARE(object.attributes().value(QStringLiteral("cn")), LdapAttrValue({"Other"}));
+    QCOMPARE(object.attributeNames().first().name(), QStringLiteral("cn"));
+
+    // the map follows the changes of the object
+    const LdapAttrMap &attrs = object.attributes();
+    object.addValue(QStringLiteral("cn"), "Another");
+    object.setValues(QStringLiteral("Mail"), {"other@kde.org"});
+    QCOMPARE(attrs.value(QStringLiteral("cn")), LdapAttrValue({"Other", "Another"}));
+    QCOMPARE(attrs.value(QStringLiteral("Mail")), LdapAttrValue({"other@kde.org"}));
+    QVERIFY(!attrs.contains(QStringLiteral("mail")));
+    object.setAttributes(attrs);
+    QCOMPARE(object.attributes().count(), 3);
+    QCOMPARE(object.values(QStringLiteral("cn")), LdapAttrValue({"Other", "Another"}));
+
+    const LdapObject copy = object;
+    object.setValues(QStringLiteral("sn"), {"Person"});
+    QVERIFY(object.hasAttribute(QStringLiteral("sn")));
+    QVERIFY(!copy.hasAttribute(QStringLiteral("sn")));
+}
+
+void KLdapTest::testLdif()
+{
+    const QByteArray input(
+        "# comment\r\n"
+        "dn: cn=Test,dc=kde,dc=org\r\n"
+        "cn: Test\r\n"
+        "description: a folded\r\n"
+        "  value\r\n"
+        "# another\r\n"
+        "#  comment\r\n"
+        "jpegPhoto:: AAEC\r\n"
+        "\r\n"
+        "dn: cn=Other,dc=kde,dc=org\n"
+        "changetype: delete\n");
+    const QStringList expected{QStringLiteral("dn cn=Test,dc=kde,dc=org"),
+                               QStringLiteral("item cn Test"),
+                               QStringLiteral("item description a folded value"),
+                               QStringLiteral("item jpegPhoto 000102"),
+                               QStringLiteral("end"),
+                               QStringLiteral("dn cn=Other,dc=kde,dc=org"),
+                               QStringLiteral("end")};
+
+    // feed the whole input, then byte by byte, which must give the same items
+    for (const int chunkSize : {int(input.size()), 1}) {
+        Ldif ldif;
+        QStringList items;
+        for (int pos = 0; pos <= input.size(); pos += chunkSize) {
+            if (pos < input.size()) {
+                ldif.setLdif(input.mid(pos, chunkSize));
+            } else {
+                ldif.endLdif();
+            }
+            Ldif::ParseValue ret;
+            while ((ret = ldif.nextItem()) != Ldif::MoreData) {
+                QVERIFY(ret != Ldif::Err);
+                if (ret == Ldif::NewEntry) {
+                    items.append(QStringLiteral("dn ") + ldif.dn().toString());
+                } else if (ret == Ldif::Item) {
+                    const QByteArray value = ldif.value();
+                    items.append(QStringLiteral("item %1 %2").arg(ldif.attr(), value.startsWith('\0') ? QString::fromLatin1(value.toHex()) : QString::fromUtf8(value)));
+                } else if (ret == Ldif::EndEntry) {
+                    items.append(QStringLiteral("end"));
+                }
+            }
+        }
+        QCOMPARE(items, expected);
+    }
+
+    QCOMPARE(Ldif::assembleLine(QStringLiteral("cn"), QByteArray("aaaaaaaaaa"), 4), QByteArray("cn: \n aaaa\n aaaa\n aa"));
+    QCOMPARE(Ldif::assembleLine(QStringLiteral("jpegPhoto"), QByteArray("\0\1\2", 3)), QByteArray("jpegPhoto:: AAEC"));
+    LdapObject object(QStringLiteral("cn=Test,dc=kde,dc=org"));
+    object.addValue(QStringLiteral("sn"), "Test");
+    object.addValue(QStringLiteral("cn"), ":Test");
+    QCOMPARE(object.toString(), QStringLiteral("dn: cn=Test,dc=kde,dc=org\ncn:: OlRlc3Q=\nsn: Test\n"));
+}
+
+void KLdapTest::testLdapBatchSchedule()
+{
+    QCOMPARE(LdapBatchSchedule::dnKey(QStringLiteral("CN=Test , DC=kde,  dc=org")), QStringLiteral("cn=test,dc=kde,dc=org"));
+    QCOMPARE(LdapBatchSchedule::dnKey(QStringLiteral("cn=a\\,b,dc=org")), QStringLiteral("cn=a\\,b,dc=org"));
+    QCOMPARE(LdapBatchSchedule::parentKey(QStringLiteral("cn=a\\,b,dc=org")), QStringLiteral("dc=org"));
+    QVERIFY(LdapBatchSchedule::related(QStringLiteral("cn=a,dc=org"), QStringLiteral("dc=org")));
+    QVERIFY(LdapBatchSchedule::related(QStringLiteral("dc=org"), QStringLiteral("cn=a,dc=org")));
+    QVERIFY(!LdapBatchSchedule::related(QStringLiteral("cn=a,dc=org"), QStringLiteral("cn=b,dc=org")));
+    // a suffix of the value is not an ancestor
+    QVERIFY(!LdapBatchSchedule::related(QStringLiteral("cn=xdc=org"), QStringLiteral("dc=org")));
+    QCOMPARE(LdapBatchSchedule::renameKeys(QStringLiteral("cn=a,ou=x,dc=org"), QStringLiteral("cn=b"), QString()),
+             QStringList({QStringLiteral("cn=a,ou=x,dc=org"), QStringLiteral("cn=b,ou=x,dc=org")}));
+    QCOMPARE(LdapBatchSchedule::renameKeys(QStringLiteral("cn=a,ou=x,dc=org"), QStringLiteral("cn=b"), QStringLiteral("ou=y,dc=org")),
+             QStringList({QStringLiteral("cn=a,ou=x,dc=org"), QStringLiteral("cn=b,ou=y,dc=org")}));
+
+    const auto keys = [](const char *dn) {
+        return QStringList{LdapBatchSchedule::dnKey(QString::fromLatin1(dn))};
+    };
+    LdapBatchSchedule schedule;
+    QCOMPARE(schedule.windowSize(), 32);
+    QVERIFY(!schedule.mustWait(keys("dc=org")));
+
+    // a child waits for its parent, and a parent for its children
+    schedule.insert(0, keys("ou=people,dc=org"));
+    QVERIFY(schedule.mustWait(keys("ou=people,dc=org")));
+    QVERIFY(schedule.mustWait(keys("cn=a,ou=people,dc=org")));
+    QVERIFY(schedule.mustWait(keys("dc=org")));
+    QVERIFY(!schedule.mustWait(keys("ou=groups,dc=org")));
+    schedule.insert(1, keys("ou=groups,dc=org"));
+    schedule.remove(0);
+    QVERIFY(!schedule.mustWait(keys("cn=a,ou=people,dc=org")));
+
+    // a rename waits for operations on the old and on the new DN
+    QVERIFY(schedule.mustWait(LdapBatchSchedule::renameKeys(QStringLiteral("cn=a,ou=people,dc=org"), QStringLiteral("cn=a"), QStringLiteral("ou=groups,dc=org"))));
+    QVERIFY(!schedule.mustWait(LdapBatchSchedule::renameKeys(QStringLiteral("cn=a,ou=people,dc=org"), QStringLiteral("cn=b"), QString())));
+    schedule.remove(1);
+    QVERIFY(schedule.isEmpty());
+
+    // the window limits the operations in flight, whatever their DNs
+    schedule.setWindowSize(0);
+    QCOMPARE(schedule.windowSize(), 1);
+    schedule.setWindowSize(2);
+    schedule.insert(0, keys("cn=a,dc=org"));
+    QVERIFY(!schedule.mustWait(keys("cn=b,dc=org")));
+    schedule.insert(1, keys("cn=b,dc=org"));
+    QVERIFY(schedule.mustWait(keys("cn=c,dc=org")));
+    QCOMPARE(schedule.count(), 2);
+
+    // only the requests which were sent are abandoned
+    schedule.setId(1, 7);
+    QCOMPARE(schedule.sentIds(), QList<int>({7}));
+    schedule.setId(0, 5);
+    QCOMPARE(schedule.sentIds(), QList<int>({5, 7}));
+    schedule.remove(1);
+    QCOMPARE(schedule.sentIds(), QList<int>({5}));
+    QVERIFY(!schedule.mustWait(keys("cn=c,dc=org")));
+}
+
+void KLdapTest::testLdifWriter()
+{
+    LdapObject object(QStringLiteral("cn=Test,dc=kde,dc=org"));
+    object.addValue(QStringLiteral("cn"), "Test");
+    object.addValue(QStringLiteral("description"), QByteArray(200, 'x'));
+
+    LdifWriter buffered;
+    ShortWriteDevice device;
+    {
+        LdifWriter writer(&device);
+        // enough entries to flush while writing, every write is short
+        for (int i = 0; i < 1000; ++i) {
+            buffered.writeObject(object);
+            writer.writeObject(object);
+        }
+        int attempts = 0;
+        while (!writer.flush()) {
+            QVERIFY(++attempts < 1000);
+        }
+    }
+    QCOMPARE(device.written.size(), buffered.data().size());
+    QCOMPARE(device.written, buffered.data());
+}
+
 void KLdapTest::testLdapModel()
 {
     // Use the user-supplied testing url
     LdapUrl url;
     url.setUrl(m_url);
 
+    // A model without a connected server is empty and only offers to fetch the top level
+    {
+        LdapConnection unconnected;
+        LdapModel model(unconnected);
+        model.setBaseDn(url.dn());
+        QCOMPARE(model.baseDn().toString(), url.dn().toString());
+        model.setPageSize(-5);
+        QCOMPARE(model.pageSize(), 0);
+        QCOMPARE(model.rowCount(), 0);
+        QCOMPARE(model.columnCount(), 1);
+        QCOMPARE(model.entryCount(), 0);
+        QVERIFY(model.hasChildren(QModelIndex()));
+        QVERIFY(model.canFetchMore(QModelIndex()));
+        QVERIFY(!model.index(0, 0).isValid());
+    }
+
     // Create a connection to use and bind with it
     LdapConnection conn;
     conn.setUrl(url);
@@ -277,6 +598,199 @@ void KLdapTest::testLdapModel()
     QCoreApplication::processEvents();
 }
 
+void KLdapTest::testLdapFilter()
+{
+    LdapObject john(QStringLiteral("cn=John Doe,dc=example,dc=com"));
+    john.addValue(QStringLiteral("cn"), QByteArray("John Doe"));
+    john.addValue(QStringLiteral("mail"), QByteArray("John.Doe@example.com"));
+    john.addValue(QStringLiteral("objectClass"), QByteArray("person"));
+    john.addValue(QStringLiteral("sn"), QByteArray("D\xc3\xb6" "e"));
+
+    QVERIFY(LdapFilter(QStringLiteral("(cn=john doe)")).matches(john));
+    QVERIFY(LdapFilter(QStringLiteral("CN=JOHN*")).matches(john));
+    QVERIFY(LdapFilter(QStringLiteral("(mail=*doe@*.com)")).matches(john));
+    QVERIFY(!LdapFilter(QStringLiteral("(mail=*doe@*.org)")).matches(john));
+    QVERIFY(LdapFilter(QStringLiteral("(sn=D\\C3\\96E)")).matches(john));
+    QVERIFY(LdapFilter(QStringLiteral("(&(objectClass=person)(|(givenName=x*)(cn=j*)))")).matches(john));
+    QVERIFY(LdapFilter(QStringLiteral("(!(givenName=*))")).matches(john));
+    QVERIFY(!LdapFilter(QStringLiteral("(cn=john)")).matches(john));
+    QVERIFY(!LdapFilter(QStringLiteral("(!(cn:1.2.3:=john doe))")).matches(john));
+    QVERIFY(LdapFilter(QStringLiteral("(&)")).matches(john));
+    QVERIFY(!LdapFilter(QStringLiteral("(|)")).matches(john));
+    QVERIFY(LdapFilter(QString()).matches(john));
+
+    QVERIFY(!LdapFilter(QStringLiteral("(cn=a")).isValid());
+    QVERIFY(!LdapFilter(QStringLiteral("(cn=a(b))")).isValid());
+    QVERIFY(!LdapFilter(QStringLiteral("(cn=\\4)")).isValid());
+    QVERIFY(!LdapFilter(QStringLiteral("(!(a=b)(c=d))")).isValid());
+    QVERIFY(!LdapFilter(QStringLiteral("(cn>=a*)")).isValid());
+    QVERIFY(LdapFilter(QStringLiteral("(cn>=J)")).matches(john));
+    QVERIFY(!LdapFilter(QStringLiteral("(cn<=J)")).matches(john));
+
+    QCOMPARE(LdapFilter(QStringLiteral("(|(Mail=a\\2A*)(CN=b)(cn=b))")).toString(), QStringLiteral("(|(cn=b)(mail=a\\2a*))"));
+    QCOMPARE(LdapFilter(QStringLiteral("(&(cn=x))")).toString(), QStringLiteral("(cn=x)"));
+    QCOMPARE(LdapFilter(QStringLiteral("(cn:dn:caseIgnoreMatch:=x)")).toString(), QStringLiteral("(cn:dn:caseignorematch:=x)"));
+    QCOMPARE(LdapFilter(QStringLiteral("(&(b=1)(a=2))")), LdapFilter(QStringLiteral("(&(A=2)(b=1))")));
+    QCOMPARE(LdapFilter(QStringLiteral("(&(cn=a)(|(mail=*)(CN=b*)))")).attributes().count(), 2);
+}
+
+void KLdapTest::testLdapFilterBuilder()
+{
+    QCOMPARE(LdapFilterBuilder::escape(u"a*(b)\\c"), QStringLiteral("a\\2a\\28b\\29\\5cc"));
+    QCOMPARE(LdapFilterBuilder::escape(QString(QChar(0) + QStringLiteral("\u00e9"))), QStringLiteral("\\00\u00e9"));
+
+    LdapFilterBuilder builder;
+    builder.beginAnd().present(u"mail").beginOr().startsWith(u"cn", u"jo*").equal(u"sn", u"x)").end().end();
+    QVERIFY(builder.isValid());
+    QCOMPARE(builder.toString(), QStringLiteral("(&(mail=*)(|(cn=jo\\2a*)(sn=x\\29)))"));
+    QCOMPARE(builder.canonicalString(), QStringLiteral("(&(mail=*)(|(cn=jo\\2a*)(sn=x\\29)))"));
+    QVERIFY(builder.toFilter().isValid());
+
+    builder.clear();
+    QVERIFY(builder.isEmpty());
+    builder.expand(u"|(cn=%1*)(mail=%1*)", u"a(b");
+    QCOMPARE(builder.toString(), QStringLiteral("(|(cn=a\\28b*)(mail=a\\28b*))"));
+
+    builder.clear();
+    builder.beginAnd().equal(u"c n", u"x").end();
+    QVERIFY(!builder.isValid());
+    builder.clear();
+    builder.beginOr().present(u"cn");
+    QVERIFY(!builder.isValid());
+}
+
+void KLdapTest::testLdapCompletionIndex()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("completion.idx"));
+
+    LdapCompletionIndex index(fileName);
+    QVERIFY(!index.open());
+
+    LdapObject alice(QStringLiteral("cn=Alice Smith,dc=example,dc=com"));
+    alice.addValue(QStringLiteral("cn"), QByteArray("Alice Smith"));
+    alice.addValue(QStringLiteral("mail"), QByteArray("alice@example.com"));
+    LdapObject bob(QStringLiteral("cn=Bob Allen,dc=example,dc=com"));
+    bob.addValue(QStringLiteral("cn"), QByteArray("Bob Allen"));
+    bob.addValue(QStringLiteral("sn"), QByteArray("Allen"));
+    index.insert(alice);
+    index.insert(bob);
+    QCOMPARE(index.find(QStringLiteral("al")).count(), 2);
+    QVERIFY(index.save());
+    QVERIFY(!index.isModified());
+
+    LdapCompletionIndex reopened(fileName);
+    QVERIFY(reopened.open());
+    QCOMPARE(reopened.find(QStringLiteral("ALI")).count(), 1);
+    QCOMPARE(reopened.find(QStringLiteral("ALI")).constFirst().dn().toString(), alice.dn().toString());
+    QCOMPARE(reopened.find(QStringLiteral("ALI")).constFirst().value(QStringLiteral("mail")), QByteArray("alice@example.com"));
+    QCOMPARE(reopened.find(QStringLiteral("al")).count(), 2);
+    QCOMPARE(reopened.find(QStringLiteral("al"), 1).count(), 1);
+    QVERIFY(reopened.find(QStringLiteral("carol")).isEmpty());
+
+    reopened.remove(alice.dn());
+    QCOMPARE(reopened.find(QStringLiteral("al")).count(), 1);
+    QVERIFY(reopened.save());
+    QVERIFY(reopened.open());
+    QCOMPARE(reopened.find(QStringLiteral("al")).count(), 1);
+    QVERIFY(reopened.find(QStringLiteral("alice")).isEmpty());
+}
+
+void KLdapTest::testLdapEntryStream()
+{
+    QByteArray photo(3000, '\0');
+    for (int i = 0; i < photo.size(); ++i) {
+        photo[i] = char(i * 7);
+    }
+    LdapObject alice(QStringLiteral("cn=Alice \u00c5berg,dc=example,dc=com"));
+    alice.addValue(QStringLiteral("cn"), QByteArray("Alice \xc3\x85" "berg"));
+    alice.addValue(QStringLiteral("mail"), QByteArray("alice@example.com"));
+    alice.addValue(QStringLiteral("mail"), QByteArray("a@example.com"));
+    alice.addValue(QStringLiteral("jpegPhoto"), photo);
+    LdapObject bob(QStringLiteral("cn=Bob,dc=example,dc=com"));
+    bob.addValue(QStringLiteral("cn"), QByteArray("Bob"));
+
+    LdapEntryStream writer;
+    writer.writeObject(alice);
+    writer.writeObject(bob);
+    const QByteArray stream = writer.data();
+    // no BASE64 inflation
+    QVERIFY(stream.size() < photo.size() + 300);
+
+    const auto check = [&](const LdapObjects &objects) {
+        QCOMPARE(objects.count(), 2);
+        QCOMPARE(objects.at(0).dn().toString(), alice.dn().toString());
+        QCOMPARE(objects.at(0).values(QStringLiteral("mail")), alice.values(QStringLiteral("mail")));
+        QCOMPARE(objects.at(0).value(QStringLiteral("jpegPhoto")), photo);
+        QCOMPARE(objects.at(0).value(QStringLiteral("CN")), QByteArray("Alice \xc3\x85" "berg"));
+        QCOMPARE(objects.at(1).dn().toString(), bob.dn().toString());
+        QCOMPARE(objects.at(1).value(QStringLiteral("cn")), QByteArray("Bob"));
+    };
+
+    // in one piece, and split at every byte
+    for (const int chunkSize : {int(stream.size()), 1, 13}) {
+        LdapEntryStream reader;
+        reader.startParsing();
+        LdapObjects objects;
+        for (int pos = 0; pos < stream.size(); pos += chunkSize) {
+            reader.setData(stream.mid(pos, chunkSize));
+            LdapEntryStream::ParseValue ret;
+            while ((ret = reader.nextItem()) == LdapEntryStream::Entry) {
+                objects.append(reader.object());
+            }
+            QCOMPARE(ret, LdapEntryStream::MoreData);
+        }
+        reader.endData();
+        QCOMPARE(reader.nextItem(), LdapEntryStream::MoreData);
+        check(objects);
+    }
+
+    // a truncated stream
+    LdapEntryStream reader;
+    reader.setData(stream.left(stream.size() - 1));
+    QCOMPARE(reader.nextItem(), LdapEntryStream::Entry);
+    QCOMPARE(reader.nextItem(), LdapEntryStream::MoreData);
+    reader.endData();
+    QCOMPARE(reader.nextItem(), LdapEntryStream::Err);
+
+    // a DN which is longer than its frame
+    QByteArray broken = stream;
+    broken[4] = char(0x7f);
+    reader.startParsing();
+    reader.setData(broken);
+    QCOMPARE(reader.nextItem(), LdapEntryStream::Err);
+    QCOMPARE(reader.nextItem(), LdapEntryStream::Err);
+}
+
+void KLdapTest::testLdapAttributeNameLimit()
+{
+    // fill the table, names from a server must not grow it forever
+    for (int i = 0; i < 5000; ++i) {
+        (void)LdapAttributeName(QStringLiteral("x-kldap-test-%1").arg(i));
+    }
+    const LdapAttributeName mail(QStringLiteral("mail"));
+    QVERIFY(mail.key() != -1);
+
+    const LdapAttributeName late(QStringLiteral("x-KLDAP-late"));
+    QVERIFY(late.isValid());
+    QCOMPARE(late.key(), -1);
+    QCOMPARE(late.name(), QStringLiteral("x-KLDAP-late"));
+    QCOMPARE(late.foldedName(), QStringLiteral("x-kldap-late"));
+    QCOMPARE(LdapAttributeName::fromUtf8(QByteArray("X-kldap-LATE")), late);
+    QCOMPARE(qHash(LdapAttributeName::fromUtf8(QByteArray("X-kldap-LATE"))), qHash(late));
+    QVERIFY(late != LdapAttributeName(QStringLiteral("x-kldap-other")));
+    QVERIFY(late != mail);
+    QCOMPARE(LdapAttributeName::find(QStringLiteral("x-kldap-late")), late);
+
+    LdapObject object(QStringLiteral("cn=Test,dc=kde,dc=org"));
+    object.addValue(late, "first");
+    object.addValue(QStringLiteral("mail"), "test@kde.org");
+    object.addValue(QStringLiteral("X-KLDAP-LATE"), "second");
+    QCOMPARE(object.values(QStringLiteral("x-kldap-late")), LdapAttrValue({"first", "second"}));
+    QCOMPARE(object.attributes().count(), 2);
+}
+
 /*
   void KLdapTest::testKLdap()
   {
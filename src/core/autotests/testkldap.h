@@ -30,7 +30,17 @@ private Q_SLOTS:
     void testLdapConnection();
     void testLdapSearch();
     void testLdapDN();
+    void testLdapObject();
+    void testLdif();
+    void testLdifWriter();
+    void testLdapBatchSchedule();
     void testLdapModel();
+    void testLdapFilter();
+    void testLdapFilterBuilder();
+    void testLdapCompletionIndex();
+    void testLdapEntryStream();
+    // last, it fills the table of attribute names
+    void testLdapAttributeNameLimit();
 
 private:
     void searchResult(KLDAPCore::LdapSearch *search);
@@ -0,0 +1,341 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "bercodec.h"
+
+#include "ldap_core_debug.h"
+
+#include <limits>
+
+using namespace KLDAPCore;
+
+BerWriter::BerWriter(qsizetype size)
+{
+    mBuffer.reserve(size);
+}
+
+void BerWriter::reserve(qsizetype size)
+{
+    mBuffer.reserve(size);
+}
+
+void BerWriter::writeHeader(quint8 tag, qsizetype length)
+{
+    mBuffer.append(char(tag));
+    const qsizetype size = lengthSize(length);
+    if (size == 1) {
+        mBuffer.append(char(length));
+        return;
+    }
+    mBuffer.append(char(0x80 | (size - 1)));
+    for (qsizetype shift = 8 * (size - 2); shift >= 0; shift -= 8) {
+        mBuffer.append(char(length >> shift));
+    }
+}
+
+void BerWriter::writeIntegerContent(qint64 value, qsizetype size)
+{
+    for (qsizetype shift = 8 * (size - 1); shift >= 0; shift -= 8) {
+        mBuffer.append(char(value >> shift));
+    }
+}
+
+void BerWriter::writeBoolean(bool value, quint8 tag)
+{
+    writeHeader(tag, 1);
+    // DER requires all bits set for true
+    mBuffer.append(value ? char(0xff) : char(0));
+}
+
+void BerWriter::writeInteger(qint64 value, quint8 tag)
+{
+    const qsizetype size = integerSize(value);
+    writeHeader(tag, size);
+    writeIntegerContent(value, size);
+}
+
+void BerWriter::writeEnumerated(qint64 value, quint8 tag)
+{
+    writeInteger(value, tag);
+}
+
+void BerWriter::writeNull(quint8 tag)
+{
+    writeHeader(tag, 0);
+}
+
+void BerWriter::writeOctetString(QByteArrayView value, quint8 tag)
+{
+    writeHeader(tag, value.size());
+    mBuffer.append(value);
+}
+
+void BerWriter::beginSequence(quint8 tag)
+{
+    mBuffer.append(char(tag));
+    // most sequences are short, so assume a single length byte
+    mOpen.append(mBuffer.size());
+    mBuffer.append(char(0));
+}
+
+void BerWriter::endSequence()
+{
+    if (mOpen.isEmpty()) {
+        qCWarning(LDAP_LOG) << "BerWriter: no open sequence";
+        return;
+    }
+    const qsizetype offset = mOpen.takeLast();
+    const qsizetype length = mBuffer.size() - offset - 1;
+    const qsizetype size = lengthSize(length);
+    if (size == 1) {
+        mBuffer[offset] = char(length);
+        return;
+    }
+    mBuffer.insert(offset + 1, size - 1, char(0));
+    mBuffer[offset] = char(0x80 | (size - 1));
+    for (qsizetype i = 1; i < size; ++i) {
+        mBuffer[offset + i] = char(length >> (8 * (size - 1 - i)));
+    }
+}
+
+void BerWriter::beginSet(quint8 tag)
+{
+    beginSequence(tag);
+}
+
+void BerWriter::endSet()
+{
+    endSequence();
+}
+
+bool BerWriter::isComplete() const
+{
+    return mOpen.isEmpty();
+}
+
+QByteArray BerWriter::data() const
+{
+    return mBuffer;
+}
+
+QByteArray BerWriter::takeData()
+{
+    mOpen.clear();
+    return std::exchange(mBuffer, QByteArray());
+}
+
+void BerWriter::clear()
+{
+    mOpen.clear();
+    mBuffer.resize(0);
+}
+
+BerReader::BerReader(QByteArrayView data)
+    : mData(data)
+    , mEnd(data.size())
+{
+}
+
+bool BerReader::fail()
+{
+    if (!mError) {
+        qCDebug(LDAP_LOG) << "malformed BER data at offset" << mPos;
+    }
+    mError = true;
+    return false;
+}
+
+bool BerReader::hasError() const
+{
+    return mError;
+}
+
+bool BerReader::atEnd() const
+{
+    return mError || mPos >= mEnd;
+}
+
+int BerReader::peekTag() const
+{
+    return atEnd() ? -1 : quint8(mData.at(mPos));
+}
+
+bool BerReader::readHeader(int tag, qsizetype &length)
+{
+    if (atEnd()) {
+        return false;
+    }
+    const quint8 found = mData.at(mPos);
+    if (tag != -1 && found != tag) {
+        return false;
+    }
+    if ((found & 0x1f) == 0x1f) {
+        // high tag numbers are not used by LDAP
+        return fail();
+    }
+    qsizetype pos = mPos + 1;
+    if (pos >= mEnd) {
+        return fail();
+    }
+    const quint8 first = mData.at(pos++);
+    if (first < 0x80) {
+        length = first;
+    } else {
+        // indefinite lengths are not allowed in LDAP, and 4 bytes are plenty
+        const int count = first & 0x7f;
+        if (count == 0 || count > 4 || count > mEnd - pos) {
+            return fail();
+        }
+        length = 0;
+        for (int i = 0; i < count; ++i) {
+            length = (length << 8) | quint8(mData.at(pos++));
+        }
+    }
+    if (length > mEnd - pos) {
+        return fail();
+    }
+    mPos = pos;
+    return true;
+}
+
+bool BerReader::readIntegerContent(quint8 tag, qint64 &value)
+{
+    const qsizetype start = mPos;
+    qsizetype length;
+    if (!readHeader(tag, length)) {
+        return false;
+    }
+    if (length == 0 || length > 8) {
+        mPos = start;
+        return fail();
+    }
+    // sign extend the first byte
+    qint64 result = qint8(mData.at(mPos));
+    for (qsizetype i = 1; i < length; ++i) {
+        result = (result * 256) | quint8(mData.at(mPos + i));
+    }
+    mPos += length;
+    value = result;
+    return true;
+}
+
+bool BerReader::readBoolean(bool &value, quint8 tag)
+{
+    const qsizetype start = mPos;
+    qsizetype length;
+    if (!readHeader(tag, length)) {
+        return false;
+    }
+    if (length != 1) {
+        mPos = start;
+        return fail();
+    }
+    value = mData.at(mPos++) != 0;
+    return true;
+}
+
+bool BerReader::readInteger(qint64 &value, quint8 tag)
+{
+    return readIntegerContent(tag, value);
+}
+
+bool BerReader::readInteger(int &value, quint8 tag)
+{
+    qint64 result;
+    if (!readIntegerContent(tag, result)) {
+        return false;
+    }
+    if (result < std::numeric_limits<int>::min() || result > std::numeric_limits<int>::max()) {
+        return fail();
+    }
+    value = int(result);
+    return true;
+}
+
+bool BerReader::readEnumerated(int &value, quint8 tag)
+{
+    return readInteger(value, tag);
+}
+
+bool BerReader::readNull(quint8 tag)
+{
+    const qsizetype start = mPos;
+    qsizetype length;
+    if (!readHeader(tag, length)) {
+        return false;
+    }
+    if (length != 0) {
+        mPos = start;
+        return fail();
+    }
+    return true;
+}
+
+bool BerReader::readOctetString(QByteArrayView &value, quint8 tag)
+{
+    qsizetype length;
+    if (!readHeader(tag, length)) {
+        return false;
+    }
+    value = mData.sliced(mPos, length);
+    mPos += length;
+    return true;
+}
+
+bool BerReader::readOctetString(QByteArray &value, quint8 tag)
+{
+    QByteArrayView view;
+    if (!readOctetString(view, tag)) {
+        return false;
+    }
+    value = view.toByteArray();
+    return true;
+}
+
+bool BerReader::enterSequence(quint8 tag)
+{
+    qsizetype length;
+    if (!readHeader(tag, length)) {
+        return false;
+    }
+    mEnds.append(mEnd);
+    mEnd = mPos + length;
+    return true;
+}
+
+bool BerReader::leaveSequence()
+{
+    if (mError) {
+        return false;
+    }
+    if (mEnds.isEmpty()) {
+        return fail();
+    }
+    mPos = mEnd;
+    mEnd = mEnds.takeLast();
+    return true;
+}
+
+bool BerReader::enterSet(quint8 tag)
+{
+    return enterSequence(tag);
+}
+
+bool BerReader::leaveSet()
+{
+    return leaveSequence();
+}
+
+bool BerReader::skip()
+{
+    qsizetype length;
+    if (!readHeader(-1, length)) {
+        return false;
+    }
+    mPos += length;
+    return true;
+}
@@ -0,0 +1,195 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QVarLengthArray>
+
+#include "kldap_core_export.h"
+
+namespace KLDAPCore
+{
+/**
+ * The universal tags used by LDAP. Context specific and application tags
+ * are built by the caller, only the low-tag-number form is supported.
+ */
+namespace BerTag
+{
+enum : quint8 {
+    Boolean = 0x01,
+    Integer = 0x02,
+    OctetString = 0x04,
+    Null = 0x05,
+    Enumerated = 0x0a,
+    Sequence = 0x30,
+    Set = 0x31,
+};
+}
+
+/**
+ * @brief
+ * This class encodes values using the Distinguished Encoding Rules.
+ *
+ * The elements are appended to a growable buffer, which can be reserved
+ * up front and reused by clear(). The lengths of sequences and sets are
+ * filled in when they are closed.
+ *
+ * @code
+ * BerWriter ber;
+ * ber.beginSequence();
+ * ber.writeInteger(pageSize);
+ * ber.writeOctetString(cookie);
+ * ber.endSequence();
+ * const QByteArray value = ber.data();
+ * @endcode
+ */
+class KLDAP_CORE_EXPORT BerWriter
+{
+public:
+    BerWriter() = default;
+    /**
+     * Constructs a writer whose buffer has room for @p size bytes.
+     */
+    explicit BerWriter(qsizetype size);
+
+    void reserve(qsizetype size);
+
+    void writeBoolean(bool value, quint8 tag = BerTag::Boolean);
+    void writeInteger(qint64 value, quint8 tag = BerTag::Integer);
+    void writeEnumerated(qint64 value, quint8 tag = BerTag::Enumerated);
+    void writeNull(quint8 tag = BerTag::Null);
+    void writeOctetString(QByteArrayView value, quint8 tag = BerTag::OctetString);
+
+    /**
+     * Starts a constructed element, which is closed by endSequence().
+     */
+    void beginSequence(quint8 tag = BerTag::Sequence);
+    void endSequence();
+    void beginSet(quint8 tag = BerTag::Set);
+    void endSet();
+
+    /**
+     * Returns true if all sequences and sets are closed.
+     */
+    [[nodiscard]] bool isComplete() const;
+
+    [[nodiscard]] QByteArray data() const;
+    /**
+     * Returns the output and leaves the writer empty.
+     */
+    [[nodiscard]] QByteArray takeData();
+    /**
+     * Discards the output, but keeps the memory of the buffer.
+     */
+    void clear();
+
+    /**
+     * Returns the number of bytes of the encoded length @p length.
+     */
+    [[nodiscard]] static constexpr qsizetype lengthSize(qsizetype length)
+    {
+        qsizetype size = 1;
+        if (length >= 0x80) {
+            for (; length > 0; length >>= 8) {
+                ++size;
+            }
+        }
+        return size;
+    }
+
+    /**
+     * Returns the number of content bytes of the encoded integer @p value.
+     */
+    [[nodiscard]] static constexpr qsizetype integerSize(qint64 value)
+    {
+        qsizetype size = 1;
+        while (size < 8 && (value < -(qint64(1) << (8 * size - 1)) || value >= (qint64(1) << (8 * size - 1)))) {
+            ++size;
+        }
+        return size;
+    }
+
+private:
+    void writeHeader(quint8 tag, qsizetype length);
+    void writeIntegerContent(qint64 value, qsizetype size);
+
+    QByteArray mBuffer;
+    // the offsets of the length bytes of the open sequences and sets
+    QVarLengthArray<qsizetype, 8> mOpen;
+};
+
+/**
+ * @brief
+ * This class decodes values encoded with the Basic Encoding Rules.
+ *
+ * The reader does not copy its input, which must outlive it. Octet
+ * strings can be read as views into the input. Every length is checked
+ * against the enclosing element, so malformed input is reported as an
+ * error instead of being read out of bounds. Once an error happened, all
+ * further reads fail.
+ *
+ * Reading an element with an unexpected tag fails without an error and
+ * without consuming anything, so optional elements can be tried.
+ */
+class KLDAP_CORE_EXPORT BerReader
+{
+public:
+    explicit BerReader(QByteArrayView data);
+
+    /**
+     * Returns true if malformed input was found.
+     */
+    [[nodiscard]] bool hasError() const;
+    /**
+     * Returns true if the current sequence, or the input, has no more elements.
+     */
+    [[nodiscard]] bool atEnd() const;
+    /**
+     * Returns the tag of the next element, or -1 if there is none.
+     */
+    [[nodiscard]] int peekTag() const;
+
+    bool readBoolean(bool &value, quint8 tag = BerTag::Boolean);
+    bool readInteger(qint64 &value, quint8 tag = BerTag::Integer);
+    bool readInteger(int &value, quint8 tag = BerTag::Integer);
+    bool readEnumerated(int &value, quint8 tag = BerTag::Enumerated);
+    bool readNull(quint8 tag = BerTag::Null);
+    /**
+     * Reads an octet string as a view into the input.
+     */
+    bool readOctetString(QByteArrayView &value, quint8 tag = BerTag::OctetString);
+    bool readOctetString(QByteArray &value, quint8 tag = BerTag::OctetString);
+
+    /**
+     * Enters a constructed element. Its elements are read until
+     * leaveSequence(), which also skips those which were not read.
+     */
+    bool enterSequence(quint8 tag = BerTag::Sequence);
+    bool leaveSequence();
+    bool enterSet(quint8 tag = BerTag::Set);
+    bool leaveSet();
+
+    /**
+     * Skips the next element.
+     */
+    bool skip();
+
+private:
+    bool readHeader(int tag, qsizetype &length);
+    bool readIntegerContent(quint8 tag, qint64 &value);
+    bool fail();
+
+    QByteArrayView mData;
+    qsizetype mPos = 0;
+    qsizetype mEnd = 0;
+    // the ends of the enclosing sequences and sets
+    QVarLengthArray<qsizetype, 8> mEnds;
+    bool mError = false;
+};
+}
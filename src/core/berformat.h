@@ -0,0 +1,341 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "bercodec.h"
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * Compile-time BER formats.
+ *
+ * A format is a type built from the elements below. encode() and decode()
+ * take one argument per primitive element, in order. The argument types
+ * are checked when the call is compiled, and the code for the format is
+ * generated inline. encode() computes the exact size of the output first
+ * and allocates it once.
+ *
+ * @code
+ * using PageControl = BerFormat::Seq<BerFormat::Int, BerFormat::OctetString>;
+ * const QByteArray value = BerFormat::encode<PageControl>(pageSize, cookie);
+ *
+ * int size;
+ * QByteArrayView cookie;
+ * if (BerFormat::decode<PageControl>(value, size, cookie)) {
+ *     ...
+ * }
+ * @endcode
+ */
+namespace BerFormat
+{
+/** A BOOLEAN, given as bool. */
+struct Bool {
+};
+/** An INTEGER, given as any integer type. */
+struct Int {
+};
+/** An ENUMERATED, given as any integer type. */
+struct Enum {
+};
+/** An OCTET STRING, encoded from anything convertible to QByteArrayView,
+ *  decoded into a QByteArrayView pointing into the input, or a QByteArray. */
+struct OctetString {
+};
+/** The element @p F with the implicit tag @p Tag. */
+template<quint8 Tag, typename F>
+struct Tagged {
+};
+/** A SEQUENCE of the elements @p Fs. */
+template<typename... Fs>
+struct Seq {
+};
+/** A SET of the elements @p Fs, in the given order. */
+template<typename... Fs>
+struct Set {
+};
+
+namespace Detail
+{
+template<typename F>
+struct Node;
+
+template<quint8 Tag>
+struct PrimitiveNode {
+    static constexpr quint8 tag = Tag;
+    static constexpr std::size_t leaves = 1;
+    static constexpr bool constructed = false;
+};
+
+template<typename A>
+constexpr bool isInteger = std::is_integral_v<A> && !std::is_same_v<A, bool>;
+
+template<typename A>
+bool readInteger(BerReader &reader, quint8 tag, A &value)
+{
+    static_assert(isInteger<A>, "BerFormat::Int and BerFormat::Enum decode into an integer");
+    qint64 result;
+    if (!reader.readInteger(result, tag)) {
+        return false;
+    }
+    if constexpr (sizeof(A) < sizeof(qint64) || std::is_signed_v<A>) {
+        if (result < qint64(std::numeric_limits<A>::min()) || result > qint64(std::numeric_limits<A>::max())) {
+            return false;
+        }
+    } else {
+        if (result < 0) {
+            return false;
+        }
+    }
+    value = A(result);
+    return true;
+}
+
+struct IntegerNode {
+    template<typename A>
+    static qsizetype contentSize(const A &value)
+    {
+        static_assert(isInteger<A>, "BerFormat::Int and BerFormat::Enum encode an integer");
+        return BerWriter::integerSize(qint64(value));
+    }
+    template<typename A>
+    static void writeContent(char *&out, const A &value)
+    {
+        const qint64 v = qint64(value);
+        for (qsizetype shift = 8 * (BerWriter::integerSize(v) - 1); shift >= 0; shift -= 8) {
+            *out++ = char(v >> shift);
+        }
+    }
+    template<typename A>
+    static bool read(BerReader &reader, quint8 tag, A &value)
+    {
+        return readInteger(reader, tag, value);
+    }
+};
+
+template<>
+struct Node<Bool> : PrimitiveNode<BerTag::Boolean> {
+    template<typename A>
+    static qsizetype contentSize(const A &)
+    {
+        static_assert(std::is_same_v<A, bool>, "BerFormat::Bool encodes a bool");
+        return 1;
+    }
+    static void writeContent(char *&out, bool value)
+    {
+        *out++ = value ? char(0xff) : char(0);
+    }
+    template<typename A>
+    static bool read(BerReader &reader, quint8 tag, A &value)
+    {
+        static_assert(std::is_same_v<A, bool>, "BerFormat::Bool decodes into a bool");
+        return reader.readBoolean(value, tag);
+    }
+};
+
+template<>
+struct Node<Int> : PrimitiveNode<BerTag::Integer>, IntegerNode {
+};
+
+template<>
+struct Node<Enum> : PrimitiveNode<BerTag::Enumerated>, IntegerNode {
+};
+
+template<>
+struct Node<OctetString> : PrimitiveNode<BerTag::OctetString> {
+    template<typename A>
+    static qsizetype contentSize(const A &value)
+    {
+        static_assert(std::is_convertible_v<const A &, QByteArrayView>, "BerFormat::OctetString encodes bytes");
+        return QByteArrayView(value).size();
+    }
+    template<typename A>
+    static void writeContent(char *&out, const A &value)
+    {
+        const QByteArrayView view(value);
+        if (!view.isEmpty()) {
+            std::memcpy(out, view.data(), view.size());
+            out += view.size();
+        }
+    }
+    template<typename A>
+    static bool read(BerReader &reader, quint8 tag, A &value)
+    {
+        static_assert(std::is_same_v<A, QByteArrayView> || std::is_same_v<A, QByteArray>,
+                      "BerFormat::OctetString decodes into a QByteArrayView or a QByteArray");
+        return reader.readOctetString(value, tag);
+    }
+};
+
+template<quint8 Tag, typename F>
+struct Node<Tagged<Tag, F>> : Node<F> {
+    static constexpr quint8 tag = Tag;
+};
+
+// forward declarations of the generic functions, used by the constructed nodes
+template<typename F, std::size_t I, typename Tuple>
+qsizetype contentSize(const Tuple &args);
+template<typename F, std::size_t I, typename Tuple>
+qsizetype elementSize(const Tuple &args);
+template<typename F, std::size_t I, typename Tuple>
+void write(char *&out, const Tuple &args);
+template<typename F, std::size_t I, typename Tuple>
+bool read(BerReader &reader, quint8 tag, const Tuple &refs);
+
+template<quint8 Tag, typename... Fs>
+struct ConstructedNode {
+    static constexpr quint8 tag = Tag;
+    static constexpr std::size_t leaves = (std::size_t(0) + ... + Node<Fs>::leaves);
+    static constexpr bool constructed = true;
+
+    // the index of the first argument of the child K
+    template<std::size_t K>
+    static constexpr std::size_t offset()
+    {
+        constexpr std::size_t counts[] = {Node<Fs>::leaves..., 0};
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < K; ++i) {
+            result += counts[i];
+        }
+        return result;
+    }
+
+    template<std::size_t I, typename Tuple, std::size_t... K>
+    static qsizetype contentSize(const Tuple &args, std::index_sequence<K...>)
+    {
+        return (qsizetype(0) + ... + elementSize<Fs, I + offset<K>()>(args));
+    }
+    template<std::size_t I, typename Tuple>
+    static qsizetype contentSize(const Tuple &args)
+    {
+        return contentSize<I>(args, std::index_sequence_for<Fs...>());
+    }
+
+    template<std::size_t I, typename Tuple, std::size_t... K>
+    static void writeContent(char *&out, const Tuple &args, std::index_sequence<K...>)
+    {
+        (write<Fs, I + offset<K>()>(out, args), ...);
+    }
+    template<std::size_t I, typename Tuple>
+    static void writeContent(char *&out, const Tuple &args)
+    {
+        writeContent<I>(out, args, std::index_sequence_for<Fs...>());
+    }
+
+    template<std::size_t I, typename Tuple, std::size_t... K>
+    static bool read(BerReader &reader, quint8 tag, const Tuple &refs, std::index_sequence<K...>)
+    {
+        return reader.enterSequence(tag) && (Detail::read<Fs, I + offset<K>()>(reader, Node<Fs>::tag, refs) && ...) && reader.leaveSequence();
+    }
+    template<std::size_t I, typename Tuple>
+    static bool read(BerReader &reader, quint8 tag, const Tuple &refs)
+    {
+        return read<I>(reader, tag, refs, std::index_sequence_for<Fs...>());
+    }
+};
+
+template<typename... Fs>
+struct Node<Seq<Fs...>> : ConstructedNode<BerTag::Sequence, Fs...> {
+};
+
+template<typename... Fs>
+struct Node<Set<Fs...>> : ConstructedNode<BerTag::Set, Fs...> {
+};
+
+template<typename F, std::size_t I, typename Tuple>
+qsizetype contentSize(const Tuple &args)
+{
+    if constexpr (Node<F>::constructed) {
+        return Node<F>::template contentSize<I>(args);
+    } else {
+        return Node<F>::contentSize(std::get<I>(args));
+    }
+}
+
+template<typename F, std::size_t I, typename Tuple>
+qsizetype elementSize(const Tuple &args)
+{
+    const qsizetype size = contentSize<F, I>(args);
+    return 1 + BerWriter::lengthSize(size) + size;
+}
+
+inline void writeHeader(char *&out, quint8 tag, qsizetype length)
+{
+    *out++ = char(tag);
+    const qsizetype size = BerWriter::lengthSize(length);
+    if (size == 1) {
+        *out++ = char(length);
+        return;
+    }
+    *out++ = char(0x80 | (size - 1));
+    for (qsizetype shift = 8 * (size - 2); shift >= 0; shift -= 8) {
+        *out++ = char(length >> shift);
+    }
+}
+
+template<typename F, std::size_t I, typename Tuple>
+void write(char *&out, const Tuple &args)
+{
+    writeHeader(out, Node<F>::tag, contentSize<F, I>(args));
+    if constexpr (Node<F>::constructed) {
+        Node<F>::template writeContent<I>(out, args);
+    } else {
+        Node<F>::writeContent(out, std::get<I>(args));
+    }
+}
+
+template<typename F, std::size_t I, typename Tuple>
+bool read(BerReader &reader, quint8 tag, const Tuple &refs)
+{
+    if constexpr (Node<F>::constructed) {
+        return Node<F>::template read<I>(reader, tag, refs);
+    } else {
+        return Node<F>::read(reader, tag, std::get<I>(refs));
+    }
+}
+}
+
+/**
+ * Encodes @p args with the format @p F.
+ */
+template<typename F, typename... Args>
+[[nodiscard]] QByteArray encode(const Args &...args)
+{
+    static_assert(sizeof...(Args) == Detail::Node<F>::leaves, "the number of arguments does not match the BER format");
+    const auto refs = std::forward_as_tuple(args...);
+    const qsizetype size = Detail::elementSize<F, 0>(refs);
+    QByteArray result(size, Qt::Uninitialized);
+    char *out = result.data();
+    Detail::write<F, 0>(out, refs);
+    Q_ASSERT(out == result.constData() + size);
+    return result;
+}
+
+/**
+ * Decodes @p data with the format @p F into @p args.
+ * Returns false if the data does not match the format.
+ */
+template<typename F, typename... Args>
+[[nodiscard]] bool decode(QByteArrayView data, Args &...args)
+{
+    static_assert(sizeof...(Args) == Detail::Node<F>::leaves, "the number of arguments does not match the BER format");
+    BerReader reader(data);
+    return Detail::read<F, 0>(reader, Detail::Node<F>::tag, std::forward_as_tuple(args...)) && !reader.hasError();
+}
+}
+}
@@ -0,0 +1,197 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapattributename.h"
+
+#include <QHash>
+#include <QList>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QWriteLocker>
+
+using namespace KLDAPCore;
+
+// the table is never pruned, so names read from servers and files must not grow it forever
+#define LDAPATTRIBUTENAME_MAX_INTERNED 4096
+
+namespace
+{
+// Attribute names are a small set which repeats in every entry and every
+// LDIF record, so each spelling is stored once and identified by its index.
+class AttributeNameTable
+{
+public:
+    struct Entry {
+        QString name;
+        int key;
+    };
+
+    // these return the id and set the key, or return -1
+    int find(const QString &name, int &key) const;
+    int find(const char *utf8, qsizetype size, int &key) const;
+    // returns -1 if the table is full, the key is set if the case-folded form is known
+    int intern(const QString &name, const QByteArray &utf8, int &key);
+    Entry entry(int id) const;
+    bool isFull() const;
+
+private:
+    mutable QReadWriteLock mLock;
+    QList<Entry> mEntries;
+    QHash<QString, int> mByName;
+    QHash<QByteArray, int> mByUtf8;
+};
+
+int AttributeNameTable::find(const QString &name, int &key) const
+{
+    QReadLocker locker(&mLock);
+    const int id = mByName.value(name, -1);
+    if (id != -1) {
+        key = mEntries.at(id).key;
+    }
+    return id;
+}
+
+int AttributeNameTable::find(const char *utf8, qsizetype size, int &key) const
+{
+    QReadLocker locker(&mLock);
+    const int id = mByUtf8.value(QByteArray::fromRawData(utf8, size), -1);
+    if (id != -1) {
+        key = mEntries.at(id).key;
+    }
+    return id;
+}
+
+int AttributeNameTable::intern(const QString &name, const QByteArray &utf8, int &key)
+{
+    // attribute descriptions are ASCII (RFC 4512), so folding the case is simple
+    const QString folded = name.toLower();
+
+    QWriteLocker locker(&mLock);
+    int id = mByName.value(name, -1);
+    if (id != -1) {
+        key = mEntries.at(id).key;
+        return id;
+    }
+    key = mByName.value(folded, -1);
+    if (key == -1) {
+        if (mEntries.count() >= LDAPATTRIBUTENAME_MAX_INTERNED) {
+            return -1;
+        }
+        key = mEntries.count();
+        mEntries.append({folded, key});
+        mByName.insert(folded, key);
+        mByUtf8.insert(folded.toUtf8(), key);
+    }
+    if (folded == name) {
+        return key;
+    }
+    if (mEntries.count() >= LDAPATTRIBUTENAME_MAX_INTERNED) {
+        return -1;
+    }
+    id = mEntries.count();
+    mEntries.append({name, key});
+    mByName.insert(name, id);
+    mByUtf8.insert(utf8, id);
+    return id;
+}
+
+AttributeNameTable::Entry AttributeNameTable::entry(int id) const
+{
+    QReadLocker locker(&mLock);
+    return mEntries.at(id);
+}
+
+bool AttributeNameTable::isFull() const
+{
+    QReadLocker locker(&mLock);
+    return mEntries.count() >= LDAPATTRIBUTENAME_MAX_INTERNED;
+}
+
+Q_GLOBAL_STATIC(AttributeNameTable, s_table)
+}
+
+LdapAttributeName::LdapAttributeName(int id, int key, const QString &name)
+    : mId(id)
+    , mKey(key)
+    , mName(name)
+{
+}
+
+LdapAttributeName::LdapAttributeName(const QString &name)
+{
+    if (name.isEmpty()) {
+        return;
+    }
+    mId = s_table->find(name, mKey);
+    if (mId == -1) {
+        mId = s_table->intern(name, name.toUtf8(), mKey);
+        if (mId == -1) {
+            mName = name;
+        }
+    }
+}
+
+LdapAttributeName LdapAttributeName::fromUtf8(const char *name, qsizetype size)
+{
+    if (size == 0) {
+        return {};
+    }
+    int key;
+    int id = s_table->find(name, size, key);
+    if (id == -1) {
+        const QByteArray utf8(name, size);
+        const QString string = QString::fromUtf8(utf8);
+        id = s_table->intern(string, utf8, key);
+        if (id == -1) {
+            return LdapAttributeName(id, key, string);
+        }
+    }
+    return LdapAttributeName(id, key);
+}
+
+LdapAttributeName LdapAttributeName::fromUtf8(const QByteArray &name)
+{
+    return fromUtf8(name.constData(), name.size());
+}
+
+LdapAttributeName LdapAttributeName::find(const QString &name)
+{
+    if (name.isEmpty()) {
+        return {};
+    }
+    int key;
+    int id = s_table->find(name, key);
+    if (id == -1) {
+        // another spelling might be known
+        id = s_table->find(name.toLower(), key);
+        if (id == -1) {
+            // objects only hold unknown names if they could not be interned
+            return s_table->isFull() ? LdapAttributeName(-1, -1, name) : LdapAttributeName();
+        }
+    }
+    return LdapAttributeName(id, key);
+}
+
+bool LdapAttributeName::isValid() const
+{
+    return mKey != -1 || !mName.isEmpty();
+}
+
+QString LdapAttributeName::name() const
+{
+    return mId != -1 ? s_table->entry(mId).name : mName;
+}
+
+QString LdapAttributeName::foldedName() const
+{
+    return mKey != -1 ? s_table->entry(mKey).name : mName.toLower();
+}
+
+int LdapAttributeName::compareNames(const LdapAttributeName &lhs, const LdapAttributeName &rhs)
+{
+    return lhs.foldedName().compare(rhs.foldedName());
+}
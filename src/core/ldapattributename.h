@@ -0,0 +1,137 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHashFunctions>
+#include <QString>
+
+#include "kldap_core_export.h"
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class represents an interned attribute name.
+ *
+ * Every spelling of an attribute name is stored once in a process-wide,
+ * thread-safe table, together with its case-folded form. An
+ * LdapAttributeName only holds the index of the spelling and the index of
+ * the case-folded form, so it is cheap to copy, and comparing two names is
+ * an integer comparison. As required by RFC 4512, names which only differ
+ * in case compare equal.
+ *
+ * The table is never pruned, and the names come from servers and files,
+ * so it holds a few thousand spellings at most. Names seen after that are
+ * not interned: they keep their own string and are compared by it.
+ *
+ * @code
+ * static const LdapAttributeName mail(QStringLiteral("mail"));
+ * if (name == mail) {
+ *     ...
+ * }
+ * @endcode
+ */
+class KLDAP_CORE_EXPORT LdapAttributeName
+{
+public:
+    /**
+     * Constructs an invalid name.
+     */
+    LdapAttributeName() = default;
+    /**
+     * Constructs the interned name @p name. An empty name is invalid.
+     */
+    explicit LdapAttributeName(const QString &name);
+
+    /**
+     * Returns the interned UTF-8 encoded name. Names which are already
+     * known are found without allocating memory.
+     */
+    [[nodiscard]] static LdapAttributeName fromUtf8(const char *name, qsizetype size);
+    [[nodiscard]] static LdapAttributeName fromUtf8(const QByteArray &name);
+
+    /**
+     * Returns the interned name @p name if it is already known, or an
+     * invalid name. Use it for lookups, so that they do not grow the table.
+     * Once the table is full, an unknown name is returned uninterned.
+     */
+    [[nodiscard]] static LdapAttributeName find(const QString &name);
+
+    /**
+     * Returns true if this is a valid name.
+     */
+    [[nodiscard]] bool isValid() const;
+
+    /**
+     * Returns the name in the spelling it was interned with.
+     */
+    [[nodiscard]] QString name() const;
+
+    /**
+     * Returns the case-folded name.
+     */
+    [[nodiscard]] QString foldedName() const;
+
+    /**
+     * Returns the index of this spelling in the table, or -1 if the
+     * spelling is not interned.
+     */
+    [[nodiscard]] int id() const
+    {
+        return mId;
+    }
+
+    /**
+     * Returns the index of the case-folded form in the table, or -1 if it
+     * is not interned. Names with the same key are equal.
+     */
+    [[nodiscard]] int key() const
+    {
+        return mKey;
+    }
+
+    friend bool operator==(const LdapAttributeName &lhs, const LdapAttributeName &rhs)
+    {
+        // a name which is not interned is never equal to an interned one
+        if (lhs.mKey != -1 || rhs.mKey != -1) {
+            return lhs.mKey == rhs.mKey;
+        }
+        return compareNames(lhs, rhs) == 0;
+    }
+    friend bool operator!=(const LdapAttributeName &lhs, const LdapAttributeName &rhs)
+    {
+        return !(lhs == rhs);
+    }
+    /**
+     * Orders by key, which is cheap but unrelated to the alphabetical order.
+     * Names which are not interned come first.
+     */
+    friend bool operator<(const LdapAttributeName &lhs, const LdapAttributeName &rhs)
+    {
+        if (lhs.mKey != -1 || rhs.mKey != -1) {
+            return lhs.mKey < rhs.mKey;
+        }
+        return compareNames(lhs, rhs) < 0;
+    }
+
+private:
+    LdapAttributeName(int id, int key, const QString &name = QString());
+    static int compareNames(const LdapAttributeName &lhs, const LdapAttributeName &rhs);
+
+    int mId = -1;
+    int mKey = -1;
+    // the spelling, if it is not interned
+    QString mName;
+};
+
+inline size_t qHash(const LdapAttributeName &name, size_t seed = 0) noexcept
+{
+    return name.key() != -1 ? qHash(name.key(), seed) : qHash(name.foldedName(), seed);
+}
+}
@@ -0,0 +1,180 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+namespace KLDAPCore
+{
+/**
+ * Decides when LdapBatchWriter may send an operation: at most windowSize()
+ * are in flight, and none of them may touch the DN of the operation, an
+ * ancestor or a descendant of it. Every operation is identified by the
+ * slot of its result, and by its message id once it was sent.
+ */
+class LdapBatchSchedule
+{
+public:
+    /**
+     * Returns a rough normalization of @p dn. It is only used to find
+     * dependencies, so a false match merely delays a request.
+     */
+    static QString dnKey(const QString &dn)
+    {
+        QString key;
+        key.reserve(dn.size());
+        for (int i = 0; i < dn.size(); ++i) {
+            const QChar c = dn.at(i);
+            if (c == QLatin1Char(',') && (i == 0 || dn.at(i - 1) != QLatin1Char('\\'))) {
+                while (!key.isEmpty() && key.back() == QLatin1Char(' ')) {
+                    key.chop(1);
+                }
+                key += c;
+                while (i + 1 < dn.size() && dn.at(i + 1) == QLatin1Char(' ')) {
+                    ++i;
+                }
+            } else {
+                key += c.toLower();
+            }
+        }
+        return key.trimmed();
+    }
+
+    static QString parentKey(const QString &key)
+    {
+        for (int i = 0; i < key.size(); ++i) {
+            if (key.at(i) == QLatin1Char(',') && (i == 0 || key.at(i - 1) != QLatin1Char('\\'))) {
+                return key.mid(i + 1);
+            }
+        }
+        return {};
+    }
+
+    /**
+     * Returns true if the keys are the same, or one is an ancestor of the other.
+     */
+    static bool related(const QString &lhs, const QString &rhs)
+    {
+        if (lhs.isEmpty() || rhs.isEmpty()) {
+            return false;
+        }
+        if (lhs.size() == rhs.size()) {
+            return lhs == rhs;
+        }
+        const QString &longer = lhs.size() > rhs.size() ? lhs : rhs;
+        const QString &shorter = lhs.size() > rhs.size() ? rhs : lhs;
+        return longer.endsWith(shorter) && longer.at(longer.size() - shorter.size() - 1) == QLatin1Char(',');
+    }
+
+    /**
+     * Returns the keys a rename touches: the old DN and the new one.
+     */
+    static QStringList renameKeys(const QString &dn, const QString &newRdn, const QString &newSuperior)
+    {
+        const QString oldKey = dnKey(dn);
+        const QString superiorKey = newSuperior.isEmpty() ? parentKey(oldKey) : dnKey(newSuperior);
+        const QString rdnKey = dnKey(newRdn);
+        return {oldKey, superiorKey.isEmpty() ? rdnKey : rdnKey + QLatin1Char(',') + superiorKey};
+    }
+
+    void setWindowSize(int size)
+    {
+        mWindow = qMax(1, size);
+    }
+
+    [[nodiscard]] int windowSize() const
+    {
+        return mWindow;
+    }
+
+    /**
+     * Returns true if an operation on @p keys has to wait until an
+     * operation in flight finished.
+     */
+    [[nodiscard]] bool mustWait(const QStringList &keys) const
+    {
+        return !mBusy.isEmpty() && (mBusy.count() >= mWindow || conflicts(keys));
+    }
+
+    [[nodiscard]] bool conflicts(const QStringList &keys) const
+    {
+        for (const Busy &busy : mBusy) {
+            for (const QString &key : keys) {
+                for (const QString &busyKey : busy.keys) {
+                    if (related(key, busyKey)) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void insert(int slot, const QStringList &keys)
+    {
+        mBusy.append({slot, 0, keys});
+    }
+
+    void setId(int slot, int id)
+    {
+        for (Busy &busy : mBusy) {
+            if (busy.slot == slot) {
+                busy.id = id;
+                break;
+            }
+        }
+    }
+
+    void remove(int slot)
+    {
+        for (int i = 0; i < mBusy.count(); ++i) {
+            if (mBusy.at(i).slot == slot) {
+                mBusy.remove(i);
+                break;
+            }
+        }
+    }
+
+    [[nodiscard]] bool isEmpty() const
+    {
+        return mBusy.isEmpty();
+    }
+
+    [[nodiscard]] int count() const
+    {
+        return mBusy.count();
+    }
+
+    /**
+     * Returns the message ids of the operations in flight which were sent.
+     */
+    [[nodiscard]] QList<int> sentIds() const
+    {
+        QList<int> ids;
+        for (const Busy &busy : mBusy) {
+            if (busy.id > 0) {
+                ids.append(busy.id);
+            }
+        }
+        return ids;
+    }
+
+private:
+    // an operation in flight, with the DNs it touches
+    struct Busy {
+        int slot;
+        int id;
+        QStringList keys;
+    };
+
+    QList<Busy> mBusy;
+    int mWindow = 32;
+};
+}
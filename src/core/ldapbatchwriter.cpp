@@ -0,0 +1,269 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapbatchwriter.h"
+#include "ldapbatchschedule_p.h"
+#include "ldapdefs.h"
+#include "ldapdispatcher.h"
+
+#include "ldap_core_debug.h"
+
+#include <QElapsedTimer>
+
+using namespace KLDAPCore;
+
+class Q_DECL_HIDDEN LdapBatchWriter::LdapBatchWriterPrivate
+{
+public:
+    explicit LdapBatchWriterPrivate(LdapConnection &conn)
+        : mConn(conn)
+        , mDispatcher(conn)
+    {
+    }
+
+    [[nodiscard]] bool canSubmit() const;
+    void makeRoom(const QStringList &keys);
+    int begin(const LdapDN &dn, int line, const QStringList &keys);
+    bool sent(int slot, int id);
+    void finishSlot(int slot, int error, const QString &errorString);
+    void finishSlot(int slot, const LdapDispatcher::Response &response);
+    LdapDispatcher::Handler finisher(int slot);
+    LdapDispatcher::Handler adder(int slot, const LdapObject &object);
+
+    LdapConnection &mConn;
+    LdapDispatcher mDispatcher;
+    QList<Result> mResults;
+    LdapBatchSchedule mBusy;
+    int mFirstError = -1;
+    bool mReplace = false;
+    bool mStop = true;
+};
+
+bool LdapBatchWriter::LdapBatchWriterPrivate::canSubmit() const
+{
+    return !mStop || mFirstError == -1;
+}
+
+void LdapBatchWriter::LdapBatchWriterPrivate::makeRoom(const QStringList &keys)
+{
+    while (mBusy.mustWait(keys)) {
+        if (mDispatcher.pendingCount() == 0) {
+            qCWarning(LDAP_LOG) << "batch writer lost track of" << mBusy.count() << "operations";
+            break;
+        }
+        // failing reads are reported to the handlers, which free their slots
+        mDispatcher.dispatch(-1);
+    }
+}
+
+int LdapBatchWriter::LdapBatchWriterPrivate::begin(const LdapDN &dn, int line, const QStringList &keys)
+{
+    Result result;
+    result.line = line;
+    result.dn = dn;
+    const int slot = mResults.count();
+    mResults.append(result);
+    mBusy.insert(slot, keys);
+    return slot;
+}
+
+bool LdapBatchWriter::LdapBatchWriterPrivate::sent(int slot, int id)
+{
+    if (id == -1) {
+        const int error = mConn.ldapErrorCode();
+        finishSlot(slot, error == KLDAP_SUCCESS ? KLDAP_OTHER : error, mConn.ldapErrorString());
+        return false;
+    }
+    mBusy.setId(slot, id);
+    return true;
+}
+
+void LdapBatchWriter::LdapBatchWriterPrivate::finishSlot(int slot, int error, const QString &errorString)
+{
+    Result &result = mResults[slot];
+    result.error = error;
+    if (error != KLDAP_SUCCESS) {
+        result.errorString = errorString.isEmpty() ? LdapConnection::errorString(error) : errorString;
+        qCDebug(LDAP_LOG) << "batch operation on" << result.dn.toString() << "in line" << result.line << "failed:" << result.errorString;
+        if (mFirstError == -1 || slot < mFirstError) {
+            mFirstError = slot;
+        }
+    }
+    mBusy.remove(slot);
+}
+
+void LdapBatchWriter::LdapBatchWriterPrivate::finishSlot(int slot, const LdapDispatcher::Response &response)
+{
+    // a response without type means the connection failed
+    const int error = (response.type == -1 && response.error == KLDAP_SUCCESS) ? KLDAP_SERVER_DOWN : response.error;
+    finishSlot(slot, error, response.errorString);
+}
+
+LdapDispatcher::Handler LdapBatchWriter::LdapBatchWriterPrivate::finisher(int slot)
+{
+    return [this, slot](const LdapDispatcher::Response &response) {
+        finishSlot(slot, response);
+    };
+}
+
+LdapDispatcher::Handler LdapBatchWriter::LdapBatchWriterPrivate::adder(int slot, const LdapObject &object)
+{
+    return [this, slot, object](const LdapDispatcher::Response &response) {
+        if (response.error != KLDAP_ALREADY_EXISTS || !mReplace) {
+            finishSlot(slot, response);
+            return;
+        }
+        qCDebug(LDAP_LOG) << object.dn().toString() << "already exists, delete first";
+        // the slot stays busy, so nothing else touches the DN meanwhile
+        sent(slot, mDispatcher.del(object.dn(), [this, slot, object](const LdapDispatcher::Response &delResponse) {
+            if (delResponse.error != KLDAP_SUCCESS) {
+                finishSlot(slot, delResponse);
+                return;
+            }
+            sent(slot, mDispatcher.add(object, finisher(slot)));
+        }));
+    };
+}
+
+LdapBatchWriter::LdapBatchWriter(LdapConnection &conn)
+    : d(new LdapBatchWriterPrivate(conn))
+{
+}
+
+LdapBatchWriter::~LdapBatchWriter()
+{
+    const QList<int> ids = d->mBusy.sentIds();
+    for (const int id : ids) {
+        d->mDispatcher.abandon(id);
+    }
+}
+
+void LdapBatchWriter::setWindowSize(int size)
+{
+    d->mBusy.setWindowSize(size);
+}
+
+int LdapBatchWriter::windowSize() const
+{
+    return d->mBusy.windowSize();
+}
+
+void LdapBatchWriter::setReplaceExisting(bool replace)
+{
+    d->mReplace = replace;
+}
+
+bool LdapBatchWriter::replaceExisting() const
+{
+    return d->mReplace;
+}
+
+void LdapBatchWriter::setStopOnError(bool stop)
+{
+    d->mStop = stop;
+}
+
+bool LdapBatchWriter::stopOnError() const
+{
+    return d->mStop;
+}
+
+void LdapBatchWriter::setServerControls(const LdapControls &ctrls)
+{
+    d->mDispatcher.operation().setServerControls(ctrls);
+}
+
+void LdapBatchWriter::setClientControls(const LdapControls &ctrls)
+{
+    d->mDispatcher.operation().setClientControls(ctrls);
+}
+
+bool LdapBatchWriter::add(const LdapObject &object, int line)
+{
+    const QStringList keys{LdapBatchSchedule::dnKey(object.dn().toString())};
+    d->makeRoom(keys);
+    if (!d->canSubmit()) {
+        return false;
+    }
+    const int slot = d->begin(object.dn(), line, keys);
+    return d->sent(slot, d->mDispatcher.add(object, d->adder(slot, object)));
+}
+
+bool LdapBatchWriter::modify(const LdapDN &dn, const LdapOperation::ModOps &ops, int line)
+{
+    const QStringList keys{LdapBatchSchedule::dnKey(dn.toString())};
+    d->makeRoom(keys);
+    if (!d->canSubmit()) {
+        return false;
+    }
+    const int slot = d->begin(dn, line, keys);
+    return d->sent(slot, d->mDispatcher.modify(dn, ops, d->finisher(slot)));
+}
+
+bool LdapBatchWriter::rename(const LdapDN &dn, const QString &newRdn, const QString &newSuperior, bool deleteold, int line)
+{
+    const QStringList keys = LdapBatchSchedule::renameKeys(dn.toString(), newRdn, newSuperior);
+    d->makeRoom(keys);
+    if (!d->canSubmit()) {
+        return false;
+    }
+    const int slot = d->begin(dn, line, keys);
+    return d->sent(slot, d->mDispatcher.rename(dn, newRdn, newSuperior, deleteold, d->finisher(slot)));
+}
+
+bool LdapBatchWriter::del(const LdapDN &dn, int line)
+{
+    const QStringList keys{LdapBatchSchedule::dnKey(dn.toString())};
+    d->makeRoom(keys);
+    if (!d->canSubmit()) {
+        return false;
+    }
+    const int slot = d->begin(dn, line, keys);
+    return d->sent(slot, d->mDispatcher.del(dn, d->finisher(slot)));
+}
+
+bool LdapBatchWriter::finish(int msecs)
+{
+    QElapsedTimer stopWatch;
+    stopWatch.start();
+    while (!d->mBusy.isEmpty() && d->mDispatcher.pendingCount() > 0) {
+        int timeout = -1;
+        if (msecs != -1) {
+            timeout = msecs - stopWatch.elapsed();
+            if (timeout <= 0) {
+                break;
+            }
+        }
+        d->mDispatcher.dispatch(timeout);
+    }
+    return d->mBusy.isEmpty() && d->mFirstError == -1;
+}
+
+int LdapBatchWriter::pendingCount() const
+{
+    return d->mBusy.count();
+}
+
+bool LdapBatchWriter::hasError() const
+{
+    return d->mFirstError != -1;
+}
+
+LdapBatchWriter::Result LdapBatchWriter::firstError() const
+{
+    if (d->mFirstError == -1) {
+        Result result;
+        result.error = KLDAP_SUCCESS;
+        return result;
+    }
+    return d->mResults.at(d->mFirstError);
+}
+
+QList<LdapBatchWriter::Result> LdapBatchWriter::results() const
+{
+    return d->mResults;
+}
@@ -0,0 +1,159 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapconnection.h"
+#include "ldapcontrol.h"
+#include "ldapdn.h"
+#include "ldapobject.h"
+#include "ldapoperation.h"
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class applies many add, modify, rename and delete operations over
+ * one connection without waiting for each response before sending the
+ * next request.
+ *
+ * Up to windowSize() requests are kept in flight. Submitting more blocks
+ * until enough responses arrived. A request whose DN is the same as, an
+ * ancestor of, or a descendant of the DN of a request in flight is only
+ * sent after that one finished, so that parents are added before and
+ * deleted after their children.
+ *
+ * Every submitted operation gets a Result which carries a caller supplied
+ * line number, typically the LDIF line of the record, for error reporting.
+ *
+ * @code
+ * LdapBatchWriter writer(conn);
+ * while (...) {
+ *     if (!writer.add(object, line)) {
+ *         break;
+ *     }
+ * }
+ * if (!writer.finish()) {
+ *     const LdapBatchWriter::Result error = writer.firstError();
+ *     ...
+ * }
+ * @endcode
+ */
+class KLDAP_CORE_EXPORT LdapBatchWriter
+{
+public:
+    /**
+     * The outcome of one submitted operation.
+     */
+    struct Result {
+        /** The line number passed when the operation was submitted. */
+        int line = 0;
+        /** The DN the operation was applied to. */
+        LdapDN dn;
+        /** The LDAP result code, or -1 while the operation is in flight. */
+        int error = -1;
+        /** The error message if error is not KLDAP_SUCCESS. */
+        QString errorString;
+    };
+
+    /**
+     * Constructs a writer for the given connection, which must be
+     * connected and bound.
+     */
+    explicit LdapBatchWriter(LdapConnection &conn);
+    ~LdapBatchWriter();
+
+    /**
+     * Sets the maximum number of requests in flight. The default is 32,
+     * a value of 1 sends the operations one by one.
+     */
+    void setWindowSize(int size);
+    [[nodiscard]] int windowSize() const;
+
+    /**
+     * If @p replace is true, an entry which already exists when it is
+     * added is deleted and added again. The default is false.
+     */
+    void setReplaceExisting(bool replace);
+    [[nodiscard]] bool replaceExisting() const;
+
+    /**
+     * If @p stop is true, no more operations are sent after the first one
+     * failed, and the submitting methods return false. The operations
+     * already in flight still complete. The default is true.
+     */
+    void setStopOnError(bool stop);
+    [[nodiscard]] bool stopOnError() const;
+
+    /**
+     * Sets the server controls sent with the following requests.
+     */
+    void setServerControls(const LdapControls &ctrls);
+    /**
+     * Sets the client controls used for the following requests.
+     */
+    void setClientControls(const LdapControls &ctrls);
+
+    /**
+     * Submits the addition of @p object.
+     * Returns false if the request could not be sent, or if a previous
+     * operation failed and stopOnError() is set.
+     */
+    bool add(const LdapObject &object, int line = 0);
+    /**
+     * Submits a modify operation. See add() for the return value.
+     */
+    bool modify(const LdapDN &dn, const LdapOperation::ModOps &ops, int line = 0);
+    /**
+     * Submits a modrdn operation. See add() for the return value.
+     */
+    bool rename(const LdapDN &dn, const QString &newRdn, const QString &newSuperior, bool deleteold, int line = 0);
+    /**
+     * Submits a delete operation. See add() for the return value.
+     */
+    bool del(const LdapDN &dn, int line = 0);
+
+    /**
+     * Waits until all submitted operations finished, or @p msecs
+     * milliseconds elapsed (-1 means forever).
+     * Returns true if all of them finished and none of them failed.
+     */
+    bool finish(int msecs = -1);
+
+    /**
+     * Returns the number of operations in flight.
+     */
+    [[nodiscard]] int pendingCount() const;
+
+    /**
+     * Returns true if a finished operation failed.
+     */
+    [[nodiscard]] bool hasError() const;
+
+    /**
+     * Returns the failed operation which was submitted first, or an empty
+     * result with error KLDAP_SUCCESS if none failed.
+     */
+    [[nodiscard]] Result firstError() const;
+
+    /**
+     * Returns the results of all operations in the order they were submitted.
+     */
+    [[nodiscard]] QList<Result> results() const;
+
+private:
+    class LdapBatchWriterPrivate;
+    std::unique_ptr<LdapBatchWriterPrivate> const d;
+    Q_DISABLE_COPY(LdapBatchWriter)
+};
+}
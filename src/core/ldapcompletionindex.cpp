@@ -0,0 +1,575 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapcompletionindex.h"
+#include "ldapattributename.h"
+
+#include "ldap_core_debug.h"
+
+#include <QByteArrayView>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace KLDAPCore;
+
+// the header of the index file, and its version
+#define LDAPINDEX_MAGIC 0x49434c4b
+#define LDAPINDEX_VERSION 1
+// the output is written to the file when it grows beyond this
+#define LDAPINDEX_WRITE_SIZE (1024 * 1024)
+
+namespace
+{
+/*
+ * The file starts with the header, followed by the table of the entry
+ * offsets, the table of the keys sorted by their bytes, the bytes of the
+ * keys, and the entries. All numbers are in the byte order of the host,
+ * a file written on another host is rejected by the magic number.
+ *
+ * An entry is a sequence of 32 bit lengths followed by that many bytes:
+ * the case folded DN, the DN, the number of attributes, and for each
+ * attribute its name, the number of values and the values.
+ */
+struct IndexHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 entryCount;
+    quint32 keyCount;
+    quint64 entriesOffset;
+    quint64 keysOffset;
+    quint64 size;
+};
+
+struct IndexKey {
+    quint64 offset;
+    quint32 length;
+    quint32 entry;
+};
+
+// reads the entries with bounds checks, a damaged file must not crash
+class RecordReader
+{
+public:
+    RecordReader(const uchar *data, qint64 size, quint64 offset)
+        : mPos(data + offset)
+        , mEnd(data + size)
+        , mOk(offset <= quint64(size))
+    {
+    }
+
+    quint32 number()
+    {
+        if (!mOk || mEnd - mPos < 4) {
+            mOk = false;
+            return 0;
+        }
+        const quint32 value = qFromUnaligned<quint32>(mPos);
+        mPos += 4;
+        return value;
+    }
+
+    QByteArrayView bytes()
+    {
+        const quint32 length = number();
+        if (!mOk || quint64(mEnd - mPos) < length) {
+            mOk = false;
+            return {};
+        }
+        const QByteArrayView result(mPos, length);
+        mPos += length;
+        return result;
+    }
+
+    [[nodiscard]] bool isOk() const
+    {
+        return mOk;
+    }
+    [[nodiscard]] const uchar *pos() const
+    {
+        return mPos;
+    }
+
+private:
+    const uchar *mPos;
+    const uchar *mEnd;
+    bool mOk;
+};
+
+struct KeyRef {
+    QByteArrayView key;
+    quint32 entry;
+};
+
+bool keyLess(QByteArrayView a, QByteArrayView b)
+{
+    const int cmp = std::memcmp(a.data(), b.data(), size_t(qMin(a.size(), b.size())));
+    return cmp < 0 || (cmp == 0 && a.size() < b.size());
+}
+
+void appendNumber(QByteArray &out, quint32 value)
+{
+    char buf[4];
+    qToUnaligned(value, buf);
+    out.append(buf, 4);
+}
+
+void appendBytes(QByteArray &out, QByteArrayView value)
+{
+    appendNumber(out, quint32(value.size()));
+    out.append(value);
+}
+}
+
+class Q_DECL_HIDDEN LdapCompletionIndex::LdapCompletionIndexPrivate
+{
+public:
+    void unmap();
+    [[nodiscard]] QByteArrayView mappedKey(quint32 index) const;
+    [[nodiscard]] QByteArrayView mappedRecord(quint32 index) const;
+    [[nodiscard]] QByteArrayView mappedDnKey(quint32 index) const;
+    [[nodiscard]] LdapObject mappedObject(quint32 index) const;
+    [[nodiscard]] QList<QByteArray> keysOf(const LdapObject &object) const;
+
+    [[nodiscard]] static QByteArray fold(const QString &value)
+    {
+        return value.toCaseFolded().toUtf8();
+    }
+    [[nodiscard]] static QByteArray dnKey(const LdapDN &dn)
+    {
+        return fold(dn.toString());
+    }
+    [[nodiscard]] static QByteArray encode(const LdapObject &object);
+
+    QString mFileName;
+    QList<LdapAttributeName> mAttributes{LdapAttributeName(QStringLiteral("cn")),
+                                         LdapAttributeName(QStringLiteral("mail")),
+                                         LdapAttributeName(QStringLiteral("givenName")),
+                                         LdapAttributeName(QStringLiteral("sn"))};
+
+    QFile mFile;
+    const uchar *mData = nullptr;
+    qint64 mSize = 0;
+    IndexHeader mHeader = {};
+
+    // the changes since the file was mapped, keyed by the folded DN
+    QHash<QByteArray, LdapObject> mInserted;
+    QSet<QByteArray> mRemoved;
+    bool mModified = false;
+};
+
+void LdapCompletionIndex::LdapCompletionIndexPrivate::unmap()
+{
+    if (mData) {
+        mFile.unmap(const_cast<uchar *>(mData));
+        mData = nullptr;
+    }
+    mFile.close();
+    mSize = 0;
+    mHeader = {};
+}
+
+QByteArrayView LdapCompletionIndex::LdapCompletionIndexPrivate::mappedKey(quint32 index) const
+{
+    IndexKey key;
+    std::memcpy(&key, mData + mHeader.keysOffset + quint64(index) * sizeof(IndexKey), sizeof(IndexKey));
+    if (key.offset > quint64(mSize) || quint64(mSize) - key.offset < key.length) {
+        return {};
+    }
+    return QByteArrayView(mData + key.offset, key.length);
+}
+
+QByteArrayView LdapCompletionIndex::LdapCompletionIndexPrivate::mappedRecord(quint32 index) const
+{
+    const quint64 offset = qFromUnaligned<quint64>(mData + mHeader.entriesOffset + quint64(index) * sizeof(quint64));
+    RecordReader reader(mData, mSize, offset);
+    reader.bytes(); // dn key
+    reader.bytes(); // dn
+    const quint32 attrCount = reader.number();
+    for (quint32 i = 0; i < attrCount && reader.isOk(); ++i) {
+        reader.bytes(); // name
+        const quint32 valueCount = reader.number();
+        for (quint32 j = 0; j < valueCount && reader.isOk(); ++j) {
+            reader.bytes();
+        }
+    }
+    if (!reader.isOk()) {
+        return {};
+    }
+    return QByteArrayView(mData + offset, reader.pos() - (mData + offset));
+}
+
+QByteArrayView LdapCompletionIndex::LdapCompletionIndexPrivate::mappedDnKey(quint32 index) const
+{
+    const quint64 offset = qFromUnaligned<quint64>(mData + mHeader.entriesOffset + quint64(index) * sizeof(quint64));
+    RecordReader reader(mData, mSize, offset);
+    return reader.bytes();
+}
+
+LdapObject LdapCompletionIndex::LdapCompletionIndexPrivate::mappedObject(quint32 index) const
+{
+    const quint64 offset = qFromUnaligned<quint64>(mData + mHeader.entriesOffset + quint64(index) * sizeof(quint64));
+    RecordReader reader(mData, mSize, offset);
+    reader.bytes(); // dn key
+    LdapObject object(QString::fromUtf8(reader.bytes()));
+    const quint32 attrCount = reader.number();
+    for (quint32 i = 0; i < attrCount && reader.isOk(); ++i) {
+        const LdapAttributeName name = LdapAttributeName::fromUtf8(reader.bytes().toByteArray());
+        const quint32 valueCount = reader.number();
+        for (quint32 j = 0; j < valueCount && reader.isOk(); ++j) {
+            object.addValue(name, reader.bytes().toByteArray());
+        }
+    }
+    if (!reader.isOk()) {
+        return {};
+    }
+    return object;
+}
+
+QList<QByteArray> LdapCompletionIndex::LdapCompletionIndexPrivate::keysOf(const LdapObject &object) const
+{
+    QList<QByteArray> keys;
+    for (const LdapAttributeName &name : mAttributes) {
+        const LdapAttrValue values = object.values(name);
+        for (const QByteArray &value : values) {
+            if (!value.isEmpty()) {
+                keys.append(fold(QString::fromUtf8(value)));
+            }
+        }
+    }
+    return keys;
+}
+
+QByteArray LdapCompletionIndex::LdapCompletionIndexPrivate::encode(const LdapObject &object)
+{
+    QByteArray out;
+    const QString dn = object.dn().toString();
+    appendBytes(out, fold(dn));
+    appendBytes(out, dn.toUtf8());
+    const QList<LdapAttributeName> names = object.attributeNames();
+    appendNumber(out, quint32(names.count()));
+    for (const LdapAttributeName &name : names) {
+        appendBytes(out, name.name().toUtf8());
+        const LdapAttrValue values = object.values(name);
+        appendNumber(out, quint32(values.count()));
+        for (const QByteArray &value : values) {
+            appendBytes(out, value);
+        }
+    }
+    return out;
+}
+
+LdapCompletionIndex::LdapCompletionIndex()
+    : d(new LdapCompletionIndexPrivate)
+{
+}
+
+LdapCompletionIndex::LdapCompletionIndex(const QString &fileName)
+    : d(new LdapCompletionIndexPrivate)
+{
+    d->mFileName = fileName;
+}
+
+LdapCompletionIndex::~LdapCompletionIndex()
+{
+    d->unmap();
+}
+
+void LdapCompletionIndex::setFileName(const QString &fileName)
+{
+    d->mFileName = fileName;
+}
+
+QString LdapCompletionIndex::fileName() const
+{
+    return d->mFileName;
+}
+
+void LdapCompletionIndex::setIndexedAttributes(const QStringList &attributes)
+{
+    d->mAttributes.clear();
+    for (const QString &attribute : attributes) {
+        d->mAttributes.append(LdapAttributeName(attribute));
+    }
+}
+
+QStringList LdapCompletionIndex::indexedAttributes() const
+{
+    QStringList result;
+    for (const LdapAttributeName &name : std::as_const(d->mAttributes)) {
+        result.append(name.name());
+    }
+    return result;
+}
+
+bool LdapCompletionIndex::open()
+{
+    d->unmap();
+    d->mInserted.clear();
+    d->mRemoved.clear();
+    d->mModified = false;
+
+    d->mFile.setFileName(d->mFileName);
+    if (!d->mFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 size = d->mFile.size();
+    if (size < qint64(sizeof(IndexHeader))) {
+        d->unmap();
+        return false;
+    }
+    const uchar *data = d->mFile.map(0, size);
+    if (!data) {
+        qCDebug(LDAP_LOG) << "cannot map" << d->mFileName << d->mFile.errorString();
+        d->unmap();
+        return false;
+    }
+    d->mData = data;
+    d->mSize = size;
+
+    IndexHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const auto fits = [size](quint64 offset, quint64 count, quint64 itemSize) {
+        return offset <= quint64(size) && count <= (quint64(size) - offset) / itemSize;
+    };
+    if (header.magic != LDAPINDEX_MAGIC || header.version != LDAPINDEX_VERSION || header.size != quint64(size)
+        || !fits(header.entriesOffset, header.entryCount, sizeof(quint64)) || !fits(header.keysOffset, header.keyCount, sizeof(IndexKey))) {
+        qCDebug(LDAP_LOG) << d->mFileName << "is not a valid completion index";
+        d->unmap();
+        return false;
+    }
+    d->mHeader = header;
+    return true;
+}
+
+bool LdapCompletionIndex::save()
+{
+    // the entries of the new file, the kept ones point into the mapped file
+    std::vector<QByteArrayView> records;
+    QList<QByteArray> encoded;
+    std::vector<KeyRef> keys;
+    QList<QByteArray> insertedKeys;
+
+    if (d->mData) {
+        std::vector<qint64> newIndex(d->mHeader.entryCount, -1);
+        records.reserve(d->mHeader.entryCount + d->mInserted.count());
+        for (quint32 i = 0; i < d->mHeader.entryCount; ++i) {
+            const QByteArrayView dnKey = d->mappedDnKey(i);
+            const QByteArray key = QByteArray::fromRawData(dnKey.data(), dnKey.size());
+            if (d->mInserted.contains(key) || d->mRemoved.contains(key)) {
+                continue;
+            }
+            const QByteArrayView record = d->mappedRecord(i);
+            if (record.isEmpty()) {
+                continue;
+            }
+            newIndex[i] = qint64(records.size());
+            records.push_back(record);
+        }
+        keys.reserve(d->mHeader.keyCount);
+        for (quint32 i = 0; i < d->mHeader.keyCount; ++i) {
+            IndexKey key;
+            std::memcpy(&key, d->mData + d->mHeader.keysOffset + quint64(i) * sizeof(IndexKey), sizeof(IndexKey));
+            if (key.entry < d->mHeader.entryCount && newIndex[key.entry] >= 0) {
+                keys.push_back({d->mappedKey(i), quint32(newIndex[key.entry])});
+            }
+        }
+    }
+    for (const LdapObject &object : std::as_const(d->mInserted)) {
+        const quint32 index = quint32(records.size());
+        encoded.append(d->encode(object));
+        records.push_back(encoded.constLast());
+        const QList<QByteArray> objectKeys = d->keysOf(object);
+        for (const QByteArray &key : objectKeys) {
+            insertedKeys.append(key);
+            keys.push_back({insertedKeys.constLast(), index});
+        }
+    }
+
+    std::sort(keys.begin(), keys.end(), [](const KeyRef &a, const KeyRef &b) {
+        return keyLess(a.key, b.key) || (!keyLess(b.key, a.key) && a.entry < b.entry);
+    });
+    keys.erase(std::unique(keys.begin(),
+                           keys.end(),
+                           [](const KeyRef &a, const KeyRef &b) {
+                               return a.entry == b.entry && a.key == b.key;
+                           }),
+               keys.end());
+
+    IndexHeader header = {};
+    header.magic = LDAPINDEX_MAGIC;
+    header.version = LDAPINDEX_VERSION;
+    header.entryCount = quint32(records.size());
+    header.keyCount = quint32(keys.size());
+    header.entriesOffset = sizeof(IndexHeader);
+    header.keysOffset = header.entriesOffset + records.size() * sizeof(quint64);
+    const quint64 poolOffset = header.keysOffset + keys.size() * sizeof(IndexKey);
+    quint64 poolSize = 0;
+    for (const KeyRef &key : keys) {
+        poolSize += key.key.size();
+    }
+    const quint64 recordsOffset = poolOffset + poolSize;
+    header.size = recordsOffset;
+    for (const QByteArrayView &record : records) {
+        header.size += record.size();
+    }
+
+    QSaveFile file(d->mFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(LDAP_LOG) << "cannot write" << d->mFileName << file.errorString();
+        return false;
+    }
+    QByteArray buffer;
+    buffer.reserve(LDAPINDEX_WRITE_SIZE + 4096);
+    bool ok = true;
+    const auto write = [&](const void *data, qsizetype size) {
+        buffer.append(static_cast<const char *>(data), size);
+        if (buffer.size() >= LDAPINDEX_WRITE_SIZE) {
+            ok = ok && file.write(buffer) == buffer.size();
+            buffer.resize(0);
+        }
+    };
+
+    write(&header, sizeof(header));
+    quint64 offset = recordsOffset;
+    for (const QByteArrayView &record : records) {
+        write(&offset, sizeof(offset));
+        offset += record.size();
+    }
+    offset = poolOffset;
+    for (const KeyRef &ref : keys) {
+        const IndexKey key = {offset, quint32(ref.key.size()), ref.entry};
+        write(&key, sizeof(key));
+        offset += ref.key.size();
+    }
+    for (const KeyRef &ref : keys) {
+        write(ref.key.data(), ref.key.size());
+    }
+    for (const QByteArrayView &record : records) {
+        write(record.data(), record.size());
+    }
+    ok = ok && file.write(buffer) == buffer.size();
+
+    // the old file can't be replaced while it is mapped on some systems
+    keys.clear();
+    records.clear();
+    d->unmap();
+    if (!ok || !file.commit()) {
+        qCDebug(LDAP_LOG) << "writing" << d->mFileName << "failed:" << file.errorString();
+        // keep the changes, the old file is still there
+        const QHash<QByteArray, LdapObject> inserted = d->mInserted;
+        const QSet<QByteArray> removed = d->mRemoved;
+        open();
+        d->mInserted = inserted;
+        d->mRemoved = removed;
+        d->mModified = true;
+        return false;
+    }
+    return open();
+}
+
+bool LdapCompletionIndex::isModified() const
+{
+    return d->mModified;
+}
+
+void LdapCompletionIndex::insert(const LdapObject &object)
+{
+    const QByteArray key = d->dnKey(object.dn());
+    d->mRemoved.remove(key);
+    d->mInserted.insert(key, object);
+    d->mModified = true;
+}
+
+void LdapCompletionIndex::remove(const LdapDN &dn)
+{
+    const QByteArray key = d->dnKey(dn);
+    d->mInserted.remove(key);
+    if (d->mData) {
+        d->mRemoved.insert(key);
+    }
+    d->mModified = true;
+}
+
+void LdapCompletionIndex::clear()
+{
+    d->unmap();
+    d->mInserted.clear();
+    d->mRemoved.clear();
+    d->mModified = true;
+}
+
+QList<LdapObject> LdapCompletionIndex::find(const QString &prefix, int maxCount) const
+{
+    QList<LdapObject> result;
+    const QByteArray folded = d->fold(prefix);
+    if (folded.isEmpty() || maxCount == 0) {
+        return result;
+    }
+
+    if (d->mData) {
+        // the first key which is not less than the prefix
+        quint32 first = 0;
+        quint32 count = d->mHeader.keyCount;
+        while (count > 0) {
+            const quint32 step = count / 2;
+            if (keyLess(d->mappedKey(first + step), folded)) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        QSet<quint32> seen;
+        for (quint32 i = first; i < d->mHeader.keyCount; ++i) {
+            if (!d->mappedKey(i).startsWith(folded)) {
+                break;
+            }
+            IndexKey key;
+            std::memcpy(&key, d->mData + d->mHeader.keysOffset + quint64(i) * sizeof(IndexKey), sizeof(IndexKey));
+            if (key.entry >= d->mHeader.entryCount || seen.contains(key.entry)) {
+                continue;
+            }
+            seen.insert(key.entry);
+            const QByteArrayView dnKey = d->mappedDnKey(key.entry);
+            const QByteArray dnKeyData = QByteArray::fromRawData(dnKey.data(), dnKey.size());
+            if (d->mInserted.contains(dnKeyData) || d->mRemoved.contains(dnKeyData)) {
+                continue;
+            }
+            const LdapObject object = d->mappedObject(key.entry);
+            if (object.dn().isEmpty()) {
+                continue;
+            }
+            result.append(object);
+            if (maxCount > 0 && result.count() >= maxCount) {
+                return result;
+            }
+        }
+    }
+
+    // the changed entries are few, so they are simply scanned
+    for (const LdapObject &object : std::as_const(d->mInserted)) {
+        const QList<QByteArray> keys = d->keysOf(object);
+        const bool match = std::any_of(keys.cbegin(), keys.cend(), [&folded](const QByteArray &key) {
+            return key.startsWith(folded);
+        });
+        if (match) {
+            result.append(object);
+            if (maxCount > 0 && result.count() >= maxCount) {
+                break;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,98 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapdn.h"
+#include "ldapobject.h"
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class is a persistent prefix index of LDAP entries, used to answer
+ * completion queries without asking the server.
+ *
+ * The index is a file holding the entries and a sorted table of the case
+ * folded values of the indexed attributes. open() maps the file into memory,
+ * so opening even a large index does not read or rebuild anything, and
+ * find() looks up a prefix with a binary search in the mapped table.
+ *
+ * Entries inserted or removed after opening are kept in memory and take
+ * precedence over the mapped ones, until save() writes a new file.
+ * The index can be filled from the results of earlier searches, or in bulk
+ * from a replica kept by LdapSyncClient.
+ */
+class KLDAP_CORE_EXPORT LdapCompletionIndex
+{
+public:
+    LdapCompletionIndex();
+    explicit LdapCompletionIndex(const QString &fileName);
+    ~LdapCompletionIndex();
+
+    /**
+     * Sets the file of the index. Call open() to use it.
+     */
+    void setFileName(const QString &fileName);
+    [[nodiscard]] QString fileName() const;
+
+    /**
+     * Sets the attributes whose values are indexed. The default is cn,
+     * mail, givenName and sn. Changing them only affects the entries
+     * inserted afterwards.
+     */
+    void setIndexedAttributes(const QStringList &attributes);
+    [[nodiscard]] QStringList indexedAttributes() const;
+
+    /**
+     * Maps the index file. Returns false if it does not exist or is not
+     * a valid index, in which case the index is empty.
+     */
+    bool open();
+    /**
+     * Writes the mapped and the changed entries to a new index file, and
+     * maps it. Returns false if writing failed.
+     */
+    bool save();
+    /**
+     * Returns true if entries were inserted or removed since the last save().
+     */
+    [[nodiscard]] bool isModified() const;
+
+    /**
+     * Inserts @p object, replacing the entry with the same DN.
+     */
+    void insert(const LdapObject &object);
+    /**
+     * Removes the entry with the DN @p dn.
+     */
+    void remove(const LdapDN &dn);
+    /**
+     * Removes all entries.
+     */
+    void clear();
+
+    /**
+     * Returns the entries which have an indexed value starting with
+     * @p prefix, ignoring the case. Returns at most @p maxCount entries,
+     * unless it is negative.
+     */
+    [[nodiscard]] QList<LdapObject> find(const QString &prefix, int maxCount = -1) const;
+
+private:
+    class LdapCompletionIndexPrivate;
+    std::unique_ptr<LdapCompletionIndexPrivate> const d;
+    Q_DISABLE_COPY(LdapCompletionIndex)
+};
+}
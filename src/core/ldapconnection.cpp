@@ -150,6 +150,22 @@ int LdapConnection::setOption(int option, void *value)
     return ldap_set_option(d->mLDAP, option, value);
 }
 
+int LdapConnection::socketDescriptor() const
+{
+#if defined(LDAP_OPT_DESC) && !HAVE_WINLDAP_H
+    if (!d->mLDAP) {
+        return -1;
+    }
+    int fd = -1;
+    if (ldap_get_option(d->mLDAP, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS) {
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
 int LdapConnection::ldapErrorCode() const
 {
     Q_ASSERT(d->mLDAP);
@@ -168,6 +184,14 @@ QString LdapConnection::ldapErrorString() const
     return msg;
 }
 
+void LdapConnection::clearLdapError()
+{
+    Q_ASSERT(d->mLDAP);
+    int err = LDAP_SUCCESS;
+    ldap_set_option(d->mLDAP, LDAP_OPT_ERROR_NUMBER, &err);
+    ldap_set_option(d->mLDAP, LDAP_OPT_ERROR_STRING, nullptr);
+}
+
 bool LdapConnection::setSizeLimit(int sizelimit)
 {
     Q_ASSERT(d->mLDAP);
@@ -388,6 +412,11 @@ int LdapConnection::setOption(int option, void *value)
     return -1;
 }
 
+int LdapConnection::socketDescriptor() const
+{
+    return -1;
+}
+
 int LdapConnection::ldapErrorCode() const
 {
     qCritical() << "No LDAP support...";
@@ -400,6 +429,11 @@ QString LdapConnection::ldapErrorString() const
     return QString();
 }
 
+void LdapConnection::clearLdapError()
+{
+    qCritical() << "No LDAP support...";
+}
+
 bool LdapConnection::setSizeLimit(int sizelimit)
 {
     qCritical() << "No LDAP support...";
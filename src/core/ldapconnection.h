@@ -96,6 +96,9 @@ public:
     [[nodiscard]] int ldapErrorCode() const;
     /** Returns the LDAP error string from the last operation */
     [[nodiscard]] QString ldapErrorString() const;
+    /** Resets the LDAP error of the last operation, so that the connection
+     *  can be used for further operations after one failed. */
+    void clearLdapError();
     /** Returns a translated error message from the specified LDAP error code */
     [[nodiscard]] static QString errorString(int code);
 
@@ -114,6 +117,14 @@ public:
      */
     void *saslHandle() const;
 
+    /**
+     * Returns the file descriptor of the socket used by the connection,
+     * or -1 if it is not (yet) available. The descriptor is only valid after
+     * the first request has been sent to the server.
+     * Use it to wait for incoming data with a QSocketNotifier.
+     */
+    [[nodiscard]] int socketDescriptor() const;
+
 private:
     class LdapConnectionPrivate;
     std::unique_ptr<LdapConnectionPrivate> const d;
@@ -0,0 +1,354 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapconnectionpool.h"
+#include "ldapconnection.h"
+#include "ldapdefs.h"
+#include "ldapoperation.h"
+
+#include "ldap_core_debug.h"
+
+#include <KLocalizedString>
+
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QTimer>
+
+#include <algorithm>
+
+using namespace KLDAPCore;
+
+// default number of connections kept open to one server
+#define LDAPCONNECTIONPOOL_MAX_PER_SERVER 4
+// default time in milliseconds after which idle connections are closed
+#define LDAPCONNECTIONPOOL_IDLE_TIMEOUT 60000
+
+Q_GLOBAL_STATIC(LdapConnectionPool, s_pool)
+
+class Q_DECL_HIDDEN LdapConnectionPool::LdapConnectionPoolPrivate
+{
+public:
+    struct Entry {
+        LdapConnection *conn = nullptr;
+        QByteArray key;
+        bool busy = true;
+        bool bound = false;
+        QElapsedTimer idle;
+    };
+
+    explicit LdapConnectionPoolPrivate(LdapConnectionPool *qq)
+        : q(qq)
+    {
+    }
+
+    LdapConnection *take(const LdapServer &server, bool &created, int &error, QString &errorString);
+    void reap();
+    void scheduleReaper();
+
+    LdapConnectionPool *const q;
+    mutable QMutex mMutex;
+    QList<Entry> mEntries;
+    QTimer *mReaper = nullptr;
+    int mMaxPerServer = LDAPCONNECTIONPOOL_MAX_PER_SERVER;
+    int mIdleTimeout = LDAPCONNECTIONPOOL_IDLE_TIMEOUT;
+};
+
+QByteArray LdapConnectionPool::connectionKey(const LdapServer &server)
+{
+    // the password is only kept as a hash, it just has to tell credentials apart
+    const QByteArray password = QCryptographicHash::hash(server.password().toUtf8(), QCryptographicHash::Sha256);
+    const QStringList fields = {server.host(),
+                                QString::number(server.port()),
+                                QString::number(server.version()),
+                                QString::number(server.security()),
+                                QString::number(server.auth()),
+                                QString::number(server.tlsRequireCertificate()),
+                                server.tlsCACertFile(),
+                                server.bindDn(),
+                                server.user(),
+                                server.realm(),
+                                server.mech(),
+                                QString::fromLatin1(password.toHex())};
+    return fields.join(QLatin1Char('\n')).toUtf8();
+}
+
+void LdapConnectionPool::LdapConnectionPoolPrivate::reap()
+{
+    QList<LdapConnection *> expired;
+    {
+        QMutexLocker locker(&mMutex);
+        for (auto it = mEntries.begin(); it != mEntries.end();) {
+            if (!it->busy && it->idle.hasExpired(mIdleTimeout)) {
+                expired.append(it->conn);
+                it = mEntries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (!expired.isEmpty()) {
+        qCDebug(LDAP_LOG) << "closing" << expired.count() << "idle connections";
+        qDeleteAll(expired);
+    }
+    scheduleReaper();
+}
+
+void LdapConnectionPool::LdapConnectionPoolPrivate::scheduleReaper()
+{
+    // release() may be called from any thread, the timer lives in the thread of the pool
+    QMetaObject::invokeMethod(q, [this]() {
+        bool idle = false;
+        int timeout;
+        {
+            QMutexLocker locker(&mMutex);
+            timeout = mIdleTimeout;
+            for (const Entry &entry : std::as_const(mEntries)) {
+                if (!entry.busy) {
+                    idle = true;
+                    break;
+                }
+            }
+        }
+        if (idle && !mReaper->isActive()) {
+            mReaper->start(timeout);
+        } else if (!idle) {
+            mReaper->stop();
+        }
+    });
+}
+
+LdapConnectionPool::LdapConnectionPool(QObject *parent)
+    : QObject(parent)
+    , d(new LdapConnectionPoolPrivate(this))
+{
+    d->mReaper = new QTimer(this);
+    d->mReaper->setSingleShot(true);
+    connect(d->mReaper, &QTimer::timeout, this, [this]() {
+        d->reap();
+    });
+}
+
+LdapConnectionPool::~LdapConnectionPool()
+{
+    QMutexLocker locker(&d->mMutex);
+    for (const auto &entry : std::as_const(d->mEntries)) {
+        if (entry.busy) {
+            qCWarning(LDAP_LOG) << "connection still in use when destroying the pool";
+        }
+        delete entry.conn;
+    }
+    d->mEntries.clear();
+}
+
+LdapConnectionPool *LdapConnectionPool::self()
+{
+    return s_pool();
+}
+
+LdapConnection *LdapConnectionPool::LdapConnectionPoolPrivate::take(const LdapServer &server, bool &created, int &error, QString &errorString)
+{
+    const QByteArray key = connectionKey(server);
+    LdapConnection *conn = nullptr;
+    created = false;
+    {
+        QMutexLocker locker(&mMutex);
+        int count = 0;
+        for (auto &entry : mEntries) {
+            if (entry.key != key) {
+                continue;
+            }
+            if (!entry.busy) {
+                entry.busy = true;
+                conn = entry.conn;
+                break;
+            }
+            ++count;
+        }
+        if (!conn) {
+            if (count >= mMaxPerServer) {
+                error = KLDAP_BUSY;
+                errorString = i18n("Too many connections to the LDAP server %1.", server.host());
+                return nullptr;
+            }
+            // reserve the slot, connecting happens without holding the lock
+            Entry entry;
+            entry.conn = new LdapConnection(server);
+            entry.key = key;
+            mEntries.append(entry);
+            created = true;
+            error = KLDAP_SUCCESS;
+            errorString.clear();
+            return entry.conn;
+        }
+    }
+
+    // the identity matches, but the limits are per request
+    conn->setServer(server);
+    conn->clearLdapError();
+    if (!conn->setSizeLimit(server.sizeLimit()) || !conn->setTimeLimit(server.timeLimit())) {
+        error = conn->ldapErrorCode();
+        errorString = conn->ldapErrorString();
+        q->release(conn, false);
+        return nullptr;
+    }
+    error = KLDAP_SUCCESS;
+    errorString.clear();
+    return conn;
+}
+
+LdapConnection *LdapConnectionPool::acquire(const LdapServer &server, int &error, QString &errorString)
+{
+    bool created;
+    LdapConnection *conn = d->take(server, created, error, errorString);
+    if (!conn || !created) {
+        return conn;
+    }
+
+    error = conn->connect();
+    if (error != 0) {
+        errorString = conn->connectionError();
+    } else {
+        LdapOperation op(*conn);
+        error = op.bind_s();
+        if (error != KLDAP_SUCCESS) {
+            errorString = error == KLDAP_SASL_ERROR ? conn->saslErrorString() : conn->ldapErrorString();
+        }
+    }
+    if (error != 0) {
+        qCDebug(LDAP_LOG) << "cannot open pooled connection:" << errorString;
+        release(conn, false);
+        return nullptr;
+    }
+    qCDebug(LDAP_LOG) << "new pooled connection to" << server.host();
+    markBound(conn);
+    error = KLDAP_SUCCESS;
+    errorString.clear();
+    return conn;
+}
+
+LdapConnection *LdapConnectionPool::acquireNonBlocking(const LdapServer &server, bool &bound, int &error, QString &errorString)
+{
+    bool created;
+    LdapConnection *conn = d->take(server, created, error, errorString);
+    bound = conn && !created;
+    return conn;
+}
+
+void LdapConnectionPool::markBound(LdapConnection *conn)
+{
+    QMutexLocker locker(&d->mMutex);
+    for (auto &entry : d->mEntries) {
+        if (entry.conn == conn) {
+            entry.bound = true;
+            return;
+        }
+    }
+}
+
+void LdapConnectionPool::release(LdapConnection *conn, bool reusable)
+{
+    if (!conn) {
+        return;
+    }
+    {
+        QMutexLocker locker(&d->mMutex);
+        auto it = std::find_if(d->mEntries.begin(), d->mEntries.end(), [conn](const LdapConnectionPoolPrivate::Entry &entry) {
+            return entry.conn == conn;
+        });
+        if (it == d->mEntries.end()) {
+            qCWarning(LDAP_LOG) << "connection does not belong to the pool";
+            return;
+        }
+        if (reusable && it->bound) {
+            it->busy = false;
+            it->idle.start();
+            conn = nullptr;
+        } else {
+            d->mEntries.erase(it);
+        }
+    }
+    // not reusable, close it
+    delete conn;
+    d->scheduleReaper();
+}
+
+void LdapConnectionPool::clear()
+{
+    QList<LdapConnection *> idle;
+    {
+        QMutexLocker locker(&d->mMutex);
+        for (auto it = d->mEntries.begin(); it != d->mEntries.end();) {
+            if (!it->busy) {
+                idle.append(it->conn);
+                it = d->mEntries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    qDeleteAll(idle);
+    d->scheduleReaper();
+}
+
+void LdapConnectionPool::setMaxConnectionsPerServer(int count)
+{
+    QMutexLocker locker(&d->mMutex);
+    d->mMaxPerServer = qMax(1, count);
+}
+
+int LdapConnectionPool::maxConnectionsPerServer() const
+{
+    QMutexLocker locker(&d->mMutex);
+    return d->mMaxPerServer;
+}
+
+void LdapConnectionPool::setIdleTimeout(int msecs)
+{
+    {
+        QMutexLocker locker(&d->mMutex);
+        d->mIdleTimeout = qMax(0, msecs);
+    }
+    QMetaObject::invokeMethod(this, [this]() {
+        d->mReaper->stop();
+    });
+    d->scheduleReaper();
+}
+
+int LdapConnectionPool::idleTimeout() const
+{
+    QMutexLocker locker(&d->mMutex);
+    return d->mIdleTimeout;
+}
+
+int LdapConnectionPool::count() const
+{
+    QMutexLocker locker(&d->mMutex);
+    return d->mEntries.count();
+}
+
+bool LdapConnectionPool::isConnectionError(int error)
+{
+    switch (error) {
+    case KLDAP_SERVER_DOWN:
+    case KLDAP_LOCAL_ERROR:
+    case KLDAP_ENCODING_ERROR:
+    case KLDAP_DECODING_ERROR:
+    case KLDAP_TIMEOUT:
+    case KLDAP_CONNECT_ERROR:
+    case KLDAP_UNAVAILABLE:
+    case KLDAP_SASL_ERROR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+#include "moc_ldapconnectionpool.cpp"
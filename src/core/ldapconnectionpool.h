@@ -0,0 +1,125 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapserver.h"
+
+// clazy:excludeall=ctor-missing-parent-argument
+
+namespace KLDAPCore
+{
+class LdapConnection;
+
+/**
+ * @brief
+ * This class keeps connected and bound LdapConnection objects around, so
+ * that subsequent operations on the same server don't have to pay for
+ * connecting, StartTLS and binding again.
+ *
+ * Connections are shared between requests with the same transport and
+ * credentials: host, port, security, authentication method, bind DN,
+ * user, realm, mechanism and password. Idle connections are closed after
+ * idleTimeout() milliseconds.
+ */
+class KLDAP_CORE_EXPORT LdapConnectionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LdapConnectionPool(QObject *parent = nullptr);
+    ~LdapConnectionPool() override;
+
+    /**
+     * Returns the process-wide connection pool.
+     */
+    static LdapConnectionPool *self();
+
+    /**
+     * Returns a connected and bound connection to @p server, either an idle
+     * one from the pool, or a new one. The size and time limits of @p server
+     * are applied to the connection.
+     * Returns nullptr if connecting or binding failed, or if the maximum number
+     * of connections to the server is reached. In this case @p error and
+     * @p errorString describe the problem.
+     * Connecting and binding a new connection blocks, use acquireNonBlocking()
+     * in the GUI thread.
+     * The connection must be given back with release().
+     */
+    [[nodiscard]] LdapConnection *acquire(const LdapServer &server, int &error, QString &errorString);
+
+    /**
+     * Returns an idle connection to @p server like acquire(), but never
+     * blocks. If there is no idle connection, a new one is returned which is
+     * neither connected nor bound, and @p bound is set to false. The caller
+     * connects and binds it, usually asynchronously, and the pool only keeps
+     * it for later requests once markBound() was called.
+     * Returns nullptr if the maximum number of connections to the server is
+     * reached.
+     */
+    [[nodiscard]] LdapConnection *acquireNonBlocking(const LdapServer &server, bool &bound, int &error, QString &errorString);
+
+    /**
+     * Tells the pool that the connection @p conn returned by
+     * acquireNonBlocking() was bound successfully.
+     */
+    void markBound(LdapConnection *conn);
+
+    /**
+     * Gives back a connection returned by acquire(). If @p reusable is false,
+     * for example after a connection error, or if the connection was never
+     * bound, the connection is closed instead of being kept for the next request.
+     */
+    void release(LdapConnection *conn, bool reusable = true);
+
+    /**
+     * Closes all idle connections.
+     */
+    void clear();
+
+    /**
+     * Sets the maximum number of connections kept open to one server.
+     */
+    void setMaxConnectionsPerServer(int count);
+    [[nodiscard]] int maxConnectionsPerServer() const;
+
+    /**
+     * Sets the time in milliseconds after which idle connections are closed.
+     */
+    void setIdleTimeout(int msecs);
+    [[nodiscard]] int idleTimeout() const;
+
+    /**
+     * Returns the number of connections in the pool, busy or idle.
+     */
+    [[nodiscard]] int count() const;
+
+    /**
+     * Returns the key which tells the connections of @p server apart: its
+     * transport and credentials. Servers with the same key share connections.
+     */
+    [[nodiscard]] static QByteArray connectionKey(const LdapServer &server);
+
+    /**
+     * Returns true if @p error means that the connection cannot be used anymore,
+     * as opposed to errors which only concern one operation.
+     */
+    [[nodiscard]] static bool isConnectionError(int error);
+
+private:
+    class LdapConnectionPoolPrivate;
+    std::unique_ptr<LdapConnectionPoolPrivate> const d;
+    Q_DISABLE_COPY(LdapConnectionPool)
+};
+}
@@ -6,12 +6,23 @@
 */
 
 #include "ldapcontrol.h"
-#include "ber.h"
+#include "berformat.h"
 
 #include <QSharedData>
 
 using namespace KLDAPCore;
 
+// realSearchControlValue ::= SEQUENCE { size INTEGER, cookie OCTET STRING }
+using PageControlFormat = BerFormat::Seq<BerFormat::Int, BerFormat::OctetString>;
+
+#define KLDAP_SORT_REQUEST_OID "1.2.840.113556.1.4.473"
+#define KLDAP_SORT_RESPONSE_OID "1.2.840.113556.1.4.474"
+#define KLDAP_VLV_REQUEST_OID "2.16.840.1.113730.3.4.9"
+#define KLDAP_VLV_RESPONSE_OID "2.16.840.1.113730.3.4.10"
+#define KLDAP_SYNC_REQUEST_OID "1.3.6.1.4.1.4203.1.9.1.1"
+#define KLDAP_SYNC_STATE_OID "1.3.6.1.4.1.4203.1.9.1.2"
+#define KLDAP_SYNC_DONE_OID "1.3.6.1.4.1.4203.1.9.1.3"
+
 class LdapControlPrivate : public QSharedData
 {
 public:
@@ -98,26 +109,222 @@ int LdapControl::parsePageControl(QByteArray &cookie) const
         return -1;
     }
 
-    Ber ber(d->mValue);
     int size;
-    if (ber.scanf(QStringLiteral("{iO}"), &size, &cookie) == -1) {
+    QByteArrayView value;
+    if (!BerFormat::decode<PageControlFormat>(d->mValue, size, value)) {
         return -1;
-    } else {
-        return size;
     }
+    cookie = value.toByteArray();
+    return size;
 }
 
 LdapControl LdapControl::createPageControl(int pagesize, const QByteArray &cookie)
 {
     LdapControl control;
-    Ber ber;
-
-    ber.printf(QStringLiteral("{iO}"), pagesize, &cookie);
     control.setOid(QStringLiteral("1.2.840.113556.1.4.319"));
-    control.setValue(ber.flatten());
+    control.setValue(BerFormat::encode<PageControlFormat>(pagesize, cookie));
     return control;
 }
 
+LdapControl LdapControl::createSortControl(const SortKeys &keys, bool critical)
+{
+    // SortKeyList ::= SEQUENCE OF SEQUENCE {
+    //     attributeType   AttributeDescription,
+    //     orderingRule    [0] MatchingRuleId OPTIONAL,
+    //     reverseOrder    [1] BOOLEAN DEFAULT FALSE }
+    BerWriter ber;
+    ber.beginSequence();
+    for (const SortKey &key : keys) {
+        ber.beginSequence();
+        ber.writeOctetString(key.attribute.toUtf8());
+        if (!key.orderingRule.isEmpty()) {
+            ber.writeOctetString(key.orderingRule.toUtf8(), 0x80);
+        }
+        // DER leaves out the default value
+        if (key.reverse) {
+            ber.writeBoolean(true, 0x81);
+        }
+        ber.endSequence();
+    }
+    ber.endSequence();
+    return LdapControl(QStringLiteral(KLDAP_SORT_REQUEST_OID), ber.takeData(), critical);
+}
+
+int LdapControl::parseSortControl(QString &attribute) const
+{
+    if (d->mOid != QLatin1String(KLDAP_SORT_RESPONSE_OID)) {
+        return -1;
+    }
+
+    // SortResult ::= SEQUENCE {
+    //     sortResult      ENUMERATED,
+    //     attributeType   [0] AttributeDescription OPTIONAL }
+    BerReader ber(d->mValue);
+    int result;
+    QByteArrayView attr;
+    if (!ber.enterSequence() || !ber.readEnumerated(result)) {
+        return -1;
+    }
+    if (!ber.readOctetString(attr, 0x80) && ber.hasError()) {
+        return -1;
+    }
+    if (!ber.leaveSequence()) {
+        return -1;
+    }
+    attribute = QString::fromUtf8(attr);
+    return result;
+}
+
+LdapControl LdapControl::createVlvControl(int before, int after, int offset, int contentCount, const QByteArray &contextId, bool critical)
+{
+    // VirtualListViewRequest ::= SEQUENCE {
+    //     beforeCount     INTEGER (0..maxInt),
+    //     afterCount      INTEGER (0..maxInt),
+    //     target CHOICE {
+    //         byOffset        [0] SEQUENCE {
+    //             offset          INTEGER (1 .. maxInt),
+    //             contentCount    INTEGER (0 .. maxInt) },
+    //         greaterThanOrEqual [1] AssertionValue },
+    //     contextID       OCTET STRING OPTIONAL }
+    BerWriter ber;
+    ber.beginSequence();
+    ber.writeInteger(before);
+    ber.writeInteger(after);
+    ber.beginSequence(0xa0);
+    ber.writeInteger(offset);
+    ber.writeInteger(contentCount);
+    ber.endSequence();
+    if (!contextId.isEmpty()) {
+        ber.writeOctetString(contextId);
+    }
+    ber.endSequence();
+    return LdapControl(QStringLiteral(KLDAP_VLV_REQUEST_OID), ber.takeData(), critical);
+}
+
+LdapControl LdapControl::createVlvControl(int before, int after, const QByteArray &value, const QByteArray &contextId, bool critical)
+{
+    BerWriter ber;
+    ber.beginSequence();
+    ber.writeInteger(before);
+    ber.writeInteger(after);
+    ber.writeOctetString(value, 0x81);
+    if (!contextId.isEmpty()) {
+        ber.writeOctetString(contextId);
+    }
+    ber.endSequence();
+    return LdapControl(QStringLiteral(KLDAP_VLV_REQUEST_OID), ber.takeData(), critical);
+}
+
+int LdapControl::parseVlvControl(int &targetPosition, int &contentCount, QByteArray &contextId) const
+{
+    if (d->mOid != QLatin1String(KLDAP_VLV_RESPONSE_OID)) {
+        return -1;
+    }
+
+    // VirtualListViewResponse ::= SEQUENCE {
+    //     targetPosition    INTEGER (0 .. maxInt),
+    //     contentCount      INTEGER (0 .. maxInt),
+    //     virtualListViewResult ENUMERATED,
+    //     contextID         OCTET STRING OPTIONAL }
+    BerReader ber(d->mValue);
+    int position;
+    int count;
+    int result;
+    QByteArray context;
+    if (!ber.enterSequence() || !ber.readInteger(position) || !ber.readInteger(count) || !ber.readEnumerated(result)) {
+        return -1;
+    }
+    if (!ber.readOctetString(context) && ber.hasError()) {
+        return -1;
+    }
+    if (!ber.leaveSequence()) {
+        return -1;
+    }
+    targetPosition = position;
+    contentCount = count;
+    contextId = context;
+    return result;
+}
+
+LdapControl LdapControl::createSyncRequestControl(SyncMode mode, const QByteArray &cookie, bool reloadHint, bool critical)
+{
+    // syncRequestValue ::= SEQUENCE {
+    //     mode ENUMERATED { refreshOnly (1), refreshAndPersist (3) },
+    //     cookie     syncCookie OPTIONAL,
+    //     reloadHint BOOLEAN DEFAULT FALSE }
+    BerWriter ber;
+    ber.beginSequence();
+    ber.writeEnumerated(mode);
+    if (!cookie.isEmpty()) {
+        ber.writeOctetString(cookie);
+    }
+    if (reloadHint) {
+        ber.writeBoolean(true);
+    }
+    ber.endSequence();
+    return LdapControl(QStringLiteral(KLDAP_SYNC_REQUEST_OID), ber.takeData(), critical);
+}
+
+int LdapControl::parseSyncStateControl(QByteArray &entryUuid, QByteArray &cookie) const
+{
+    if (d->mOid != QLatin1String(KLDAP_SYNC_STATE_OID)) {
+        return -1;
+    }
+
+    // syncStateValue ::= SEQUENCE {
+    //     state ENUMERATED { present (0), add (1), modify (2), delete (3) },
+    //     entryUUID syncUUID,
+    //     cookie    syncCookie OPTIONAL }
+    BerReader ber(d->mValue);
+    int state;
+    QByteArray uuid;
+    QByteArray newCookie;
+    if (!ber.enterSequence() || !ber.readEnumerated(state) || !ber.readOctetString(uuid)) {
+        return -1;
+    }
+    if (!ber.readOctetString(newCookie) && ber.hasError()) {
+        return -1;
+    }
+    if (!ber.leaveSequence()) {
+        return -1;
+    }
+    entryUuid = uuid;
+    if (!newCookie.isEmpty()) {
+        cookie = newCookie;
+    }
+    return state;
+}
+
+int LdapControl::parseSyncDoneControl(QByteArray &cookie) const
+{
+    if (d->mOid != QLatin1String(KLDAP_SYNC_DONE_OID)) {
+        return -1;
+    }
+
+    // syncDoneValue ::= SEQUENCE {
+    //     cookie          syncCookie OPTIONAL,
+    //     refreshDeletes  BOOLEAN DEFAULT FALSE }
+    BerReader ber(d->mValue);
+    QByteArray newCookie;
+    bool refreshDeletes = false;
+    if (!ber.enterSequence()) {
+        return -1;
+    }
+    if (!ber.readOctetString(newCookie) && ber.hasError()) {
+        return -1;
+    }
+    if (!ber.readBoolean(refreshDeletes) && ber.hasError()) {
+        return -1;
+    }
+    if (!ber.leaveSequence()) {
+        return -1;
+    }
+    if (!newCookie.isEmpty()) {
+        cookie = newCookie;
+    }
+    return refreshDeletes ? 1 : 0;
+}
+
 void LdapControl::insert(LdapControls &list, const LdapControl &ctrl)
 {
     LdapControls::iterator it;
@@ -28,6 +28,19 @@ using LdapControls = QList<LdapControl>;
 class KLDAP_CORE_EXPORT LdapControl
 {
 public:
+    /**
+     * A key of the server side sort control.
+     */
+    struct SortKey {
+        /** The attribute to sort by. */
+        QString attribute;
+        /** The OID or name of the ordering rule, the default rule of the attribute if empty. */
+        QString orderingRule;
+        /** Sorts in descending order if true. */
+        bool reverse = false;
+    };
+    using SortKeys = QList<SortKey>;
+
     /**
      * Creates an empty control.
      */
@@ -85,6 +98,92 @@ public:
      */
     [[nodiscard]] static LdapControl createPageControl(int pagesize, const QByteArray &cookie = QByteArray());
 
+    /**
+     * Creates a server side sort control (RFC 2891), which sorts the
+     * results by @p keys, the first key being the most significant.
+     */
+    [[nodiscard]] static LdapControl createSortControl(const SortKeys &keys, bool critical = false);
+    /**
+     * Parses a sort response control, which the server returned.
+     * Returns the sort result code, and puts the attribute which caused
+     * an error into @p attribute, if the server named one. If the OID is
+     * not the sort response control's OID, or the value cannot be decoded,
+     * returns -1.
+     */
+    [[nodiscard]] int parseSortControl(QString &attribute) const;
+
+    /**
+     * Creates a virtual list view control, which requests @p before entries
+     * before and @p after entries after the target entry of a sorted search.
+     * The target is at the position @p offset, counted from 1. If
+     * @p contentCount is not 0, it is the client's estimate of the size of
+     * the list, and @p offset is scaled by the server to its actual size.
+     * @p contextId is the context ID returned by the server with the
+     * previous response of the same list, if any.
+     * The search also needs a sort control.
+     */
+    [[nodiscard]] static LdapControl
+    createVlvControl(int before, int after, int offset, int contentCount = 0, const QByteArray &contextId = QByteArray(), bool critical = true);
+    /**
+     * Creates a virtual list view control like above, whose target is the
+     * first entry which is greater than or equal to @p value in the sort
+     * order.
+     */
+    [[nodiscard]] static LdapControl
+    createVlvControl(int before, int after, const QByteArray &value, const QByteArray &contextId = QByteArray(), bool critical = true);
+    /**
+     * Parses a virtual list view response control, which the server returned.
+     * Puts the position of the target entry, counted from 1, into
+     * @p targetPosition, the server's estimate of the size of the list into
+     * @p contentCount, and the context ID to send with the next request into
+     * @p contextId. Returns the result code of the virtual list view. If
+     * the OID is not the virtual list view response control's OID, or the
+     * value cannot be decoded, returns -1.
+     */
+    [[nodiscard]] int parseVlvControl(int &targetPosition, int &contentCount, QByteArray &contextId) const;
+
+    /**
+     * The modes of the sync request control.
+     */
+    enum SyncMode {
+        SyncRefreshOnly = 1,
+        SyncRefreshAndPersist = 3,
+    };
+    /**
+     * The states of the sync state control.
+     */
+    enum SyncState {
+        SyncPresent = 0,
+        SyncAdd = 1,
+        SyncModify = 2,
+        SyncDelete = 3,
+    };
+
+    /**
+     * Creates a sync request control of content synchronization (RFC 4533),
+     * which continues the synchronization after @p cookie. If
+     * @p reloadHint is true, the server may send all entries instead of
+     * the deleted ones if that is cheaper.
+     */
+    [[nodiscard]] static LdapControl
+    createSyncRequestControl(SyncMode mode, const QByteArray &cookie = QByteArray(), bool reloadHint = false, bool critical = true);
+    /**
+     * Parses a sync state control, which the server attached to an entry.
+     * Puts the entryUUID of the entry into @p entryUuid, and the new cookie,
+     * if there is one, into @p cookie. Returns the SyncState of the entry.
+     * If the OID is not the sync state control's OID, or the value cannot be
+     * decoded, returns -1.
+     */
+    [[nodiscard]] int parseSyncStateControl(QByteArray &entryUuid, QByteArray &cookie) const;
+    /**
+     * Parses a sync done control, which the server attached to the end of
+     * a synchronization. Puts the new cookie, if there is one, into
+     * @p cookie. Returns 1 if the deleted entries were sent, 0 if the
+     * entries which were not sent as present were deleted. If the OID is not
+     * the sync done control's OID, or the value cannot be decoded, returns -1.
+     */
+    [[nodiscard]] int parseSyncDoneControl(QByteArray &cookie) const;
+
     /**
      * Inserts a unique control against a list of controls.
      * If the control already exists in the list is is updated, otherwise
@@ -0,0 +1,285 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapdispatcher.h"
+#include "ldapdefs.h"
+
+#include "ldap_core_debug.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <utility>
+
+using namespace KLDAPCore;
+
+// blocking the GUI for xxx milliseconds if we have to poll
+#define LDAPDISPATCHER_BLOCKING_TIMEOUT 10
+
+class Q_DECL_HIDDEN LdapDispatcher::LdapDispatcherPrivate
+{
+public:
+    LdapDispatcherPrivate(LdapDispatcher *qq, LdapConnection &conn)
+        : q(qq)
+        , mConn(conn)
+        , mOp(conn)
+    {
+    }
+
+    int watchNew(int id, const Handler &handler);
+    void deliver(int id, int type);
+    void failAll();
+    void updateWatcher();
+
+    LdapDispatcher *const q;
+    LdapConnection &mConn;
+    LdapOperation mOp;
+    QHash<int, Handler> mHandlers;
+    QSocketNotifier *mNotifier = nullptr;
+    QTimer *mPollTimer = nullptr;
+};
+
+int LdapDispatcher::LdapDispatcherPrivate::watchNew(int id, const Handler &handler)
+{
+    if (id < 0) {
+        return id;
+    }
+    q->watch(id, handler);
+    return id;
+}
+
+void LdapDispatcher::LdapDispatcherPrivate::deliver(int id, int type)
+{
+    if (!mHandlers.contains(id)) {
+        // abandoned, or sent without being watched
+        qCDebug(LDAP_LOG) << "no handler for message" << id << "type" << type;
+        return;
+    }
+
+    Response response;
+    response.id = id;
+    response.type = type;
+    if (type == LdapOperation::RES_SEARCH_ENTRY) {
+        response.object = mOp.object();
+        response.controls = mOp.controls();
+    } else {
+        if (type != LdapOperation::RES_EXTENDED_PARTIAL) {
+            response.error = mConn.ldapErrorCode();
+            if (response.error != KLDAP_SUCCESS) {
+                response.errorString = mConn.ldapErrorString();
+            }
+        }
+        response.controls = mOp.controls();
+        response.matchedDn = mOp.matchedDn();
+        response.referrals = mOp.referrals();
+        response.extendedOid = mOp.extendedOid();
+        response.extendedData = mOp.extendedData();
+        response.serverCred = mOp.serverCred();
+    }
+
+    // the handler may start or abandon requests, so don't keep iterators around
+    const Handler handler = isFinal(response) ? mHandlers.take(id) : mHandlers.value(id);
+    handler(response);
+}
+
+void LdapDispatcher::LdapDispatcherPrivate::failAll()
+{
+    const int error = mConn.ldapErrorCode();
+    const QString errorString = mConn.ldapErrorString();
+    const QHash<int, Handler> handlers = std::exchange(mHandlers, {});
+    for (auto it = handlers.cbegin(), end = handlers.cend(); it != end; ++it) {
+        Response response;
+        response.id = it.key();
+        response.type = -1;
+        response.error = error;
+        response.errorString = errorString;
+        it.value()(response);
+    }
+}
+
+void LdapDispatcher::LdapDispatcherPrivate::updateWatcher()
+{
+    const bool active = !mHandlers.isEmpty();
+    if (!mNotifier && !mPollTimer && active) {
+        const int fd = mConn.socketDescriptor();
+        if (fd >= 0) {
+            mNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, q);
+            q->connect(mNotifier, &QSocketNotifier::activated, q, [this]() {
+                q->dispatch(0);
+            });
+        } else {
+            qCDebug(LDAP_LOG) << "no socket descriptor available, polling for results";
+            mPollTimer = new QTimer(q);
+            mPollTimer->setInterval(0);
+            q->connect(mPollTimer, &QTimer::timeout, q, [this]() {
+                q->dispatch(LDAPDISPATCHER_BLOCKING_TIMEOUT);
+            });
+        }
+    }
+    if (mNotifier) {
+        mNotifier->setEnabled(active);
+    }
+    if (mPollTimer) {
+        if (active && !mPollTimer->isActive()) {
+            mPollTimer->start();
+        } else if (!active) {
+            mPollTimer->stop();
+        }
+    }
+}
+
+LdapDispatcher::LdapDispatcher(LdapConnection &conn, QObject *parent)
+    : QObject(parent)
+    , d(new LdapDispatcherPrivate(this, conn))
+{
+}
+
+LdapDispatcher::~LdapDispatcher() = default;
+
+LdapOperation &LdapDispatcher::operation()
+{
+    return d->mOp;
+}
+
+bool LdapDispatcher::watch(int id, const Handler &handler)
+{
+    if (id <= 0) {
+        return false;
+    }
+    d->mHandlers.insert(id, handler);
+    d->updateWatcher();
+    return true;
+}
+
+int LdapDispatcher::search(const LdapDN &base, LdapUrl::Scope scope, const QString &filter, const QStringList &attrs, const Handler &handler)
+{
+    return d->watchNew(d->mOp.search(base, scope, filter, attrs), handler);
+}
+
+int LdapDispatcher::search(const LdapPreparedSearch &search, const Handler &handler)
+{
+    return d->watchNew(d->mOp.search(search), handler);
+}
+
+int LdapDispatcher::add(const LdapObject &object, const Handler &handler)
+{
+    return d->watchNew(d->mOp.add(object), handler);
+}
+
+int LdapDispatcher::modify(const LdapDN &dn, const LdapOperation::ModOps &ops, const Handler &handler)
+{
+    return d->watchNew(d->mOp.modify(dn, ops), handler);
+}
+
+int LdapDispatcher::rename(const LdapDN &dn, const QString &newRdn, const QString &newSuperior, bool deleteold, const Handler &handler)
+{
+    return d->watchNew(d->mOp.rename(dn, newRdn, newSuperior, deleteold), handler);
+}
+
+int LdapDispatcher::del(const LdapDN &dn, const Handler &handler)
+{
+    return d->watchNew(d->mOp.del(dn), handler);
+}
+
+int LdapDispatcher::compare(const LdapDN &dn, const QString &attr, const QByteArray &value, const Handler &handler)
+{
+    return d->watchNew(d->mOp.compare(dn, attr, value), handler);
+}
+
+int LdapDispatcher::exop(const QString &oid, const QByteArray &data, const Handler &handler)
+{
+    return d->watchNew(d->mOp.exop(oid, data), handler);
+}
+
+void LdapDispatcher::abandon(int id)
+{
+    if (d->mHandlers.remove(id)) {
+        d->mOp.abandon(id);
+        d->updateWatcher();
+    }
+}
+
+bool LdapDispatcher::isPending(int id) const
+{
+    return d->mHandlers.contains(id);
+}
+
+int LdapDispatcher::pendingCount() const
+{
+    return d->mHandlers.count();
+}
+
+int LdapDispatcher::dispatch(int msecs)
+{
+    int count = 0;
+    int timeout = msecs;
+    while (!d->mHandlers.isEmpty()) {
+        const int res = d->mOp.waitForResult(-1, timeout);
+        // only wait for the first message, then take what is already there
+        timeout = 0;
+        const int id = d->mOp.messageId();
+        if (res == -1) {
+            if (id == 0) {
+                // reading from the connection failed
+                qCWarning(LDAP_LOG) << "LDAP connection error:" << d->mConn.ldapErrorString();
+                d->failAll();
+                d->updateWatcher();
+                return -1;
+            }
+            // the message could not be parsed
+            if (d->mHandlers.contains(id)) {
+                Response response;
+                response.id = id;
+                response.error = KLDAP_DECODING_ERROR;
+                response.errorString = LdapConnection::errorString(KLDAP_DECODING_ERROR);
+                d->mHandlers.take(id)(response);
+            }
+            ++count;
+            continue;
+        }
+        if (res == 0) {
+            if (id == 0) {
+                // nothing more to read
+                break;
+            }
+            // ignored search reference
+            continue;
+        }
+        d->deliver(id, res);
+        ++count;
+    }
+    d->updateWatcher();
+    return count;
+}
+
+bool LdapDispatcher::waitForFinished(int id, int msecs)
+{
+    QElapsedTimer stopWatch;
+    stopWatch.start();
+    while (d->mHandlers.contains(id)) {
+        int timeout = -1;
+        if (msecs != -1) {
+            timeout = msecs - stopWatch.elapsed();
+            if (timeout <= 0) {
+                break;
+            }
+        }
+        if (dispatch(timeout) == -1) {
+            break;
+        }
+    }
+    return !d->mHandlers.contains(id);
+}
+
+bool LdapDispatcher::isFinal(const Response &response)
+{
+    return response.type != LdapOperation::RES_SEARCH_ENTRY && response.type != LdapOperation::RES_EXTENDED_PARTIAL;
+}
+
+#include "moc_ldapdispatcher.cpp"
@@ -0,0 +1,181 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapconnection.h"
+#include "ldapcontrol.h"
+#include "ldapdn.h"
+#include "ldapobject.h"
+#include "ldapoperation.h"
+#include "ldappreparedsearch.h"
+#include "ldapurl.h"
+
+// clazy:excludeall=ctor-missing-parent-argument
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class allows running many LDAP operations concurrently over one
+ * connection.
+ *
+ * Every request is identified by its message id. The responses arriving
+ * from the server are routed to the handler registered for that id, each
+ * with its own copy of the result state, so searches, modifications and
+ * compares can be pipelined over a single bound connection.
+ *
+ * Responses are read when the socket of the connection becomes readable,
+ * or by calling dispatch() or waitForFinished() for synchronous use.
+ */
+class KLDAP_CORE_EXPORT LdapDispatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * A response message from the server.
+     */
+    struct Response {
+        /** The message id of the request. */
+        int id = 0;
+        /** The type of the message (LdapOperation::RES_XXX), or -1 if reading it failed. */
+        int type = -1;
+        /** The LDAP result code of final messages. */
+        int error = 0;
+        /** The error message of final messages. */
+        QString errorString;
+        /** The entry if type is RES_SEARCH_ENTRY. */
+        LdapObject object;
+        /** The server controls of the message. */
+        LdapControls controls;
+        QString matchedDn;
+        QList<QByteArray> referrals;
+        QByteArray extendedOid;
+        QByteArray extendedData;
+        QByteArray serverCred;
+    };
+
+    /**
+     * Called for every message of a request. Search entries and partial
+     * extended results are followed by more calls, the last message of
+     * a request is reported by isFinal().
+     */
+    using Handler = std::function<void(const Response &)>;
+
+    /**
+     * Constructs a dispatcher for the given connection. The connection
+     * must be connected and bound before requests are sent.
+     */
+    explicit LdapDispatcher(LdapConnection &conn, QObject *parent = nullptr);
+    ~LdapDispatcher() override;
+
+    /**
+     * Returns the operation which is used to send the requests. Use it to set
+     * the controls of the next requests, or to send requests which are then
+     * registered with watch().
+     */
+    LdapOperation &operation();
+
+    /**
+     * Registers @p handler for the responses of the request with the
+     * message id @p id. Returns false if @p id is not a valid message id.
+     */
+    bool watch(int id, const Handler &handler);
+
+    /**
+     * Starts a search and registers @p handler for its responses.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int search(const LdapDN &base, LdapUrl::Scope scope, const QString &filter, const QStringList &attrs, const Handler &handler);
+    /**
+     * Starts the prepared search @p search and registers @p handler for its responses.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int search(const LdapPreparedSearch &search, const Handler &handler);
+    /**
+     * Starts an addition and registers @p handler for its response.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int add(const LdapObject &object, const Handler &handler);
+    /**
+     * Starts a modify operation and registers @p handler for its response.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int modify(const LdapDN &dn, const LdapOperation::ModOps &ops, const Handler &handler);
+    /**
+     * Starts a modrdn operation and registers @p handler for its response.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int rename(const LdapDN &dn, const QString &newRdn, const QString &newSuperior, bool deleteold, const Handler &handler);
+    /**
+     * Starts a delete operation and registers @p handler for its response.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int del(const LdapDN &dn, const Handler &handler);
+    /**
+     * Starts a compare operation and registers @p handler for its response.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int compare(const LdapDN &dn, const QString &attr, const QByteArray &value, const Handler &handler);
+    /**
+     * Starts an extended operation and registers @p handler for its responses.
+     * Returns the message id, or -1 on error.
+     */
+    [[nodiscard]] int exop(const QString &oid, const QByteArray &data, const Handler &handler);
+
+    /**
+     * Abandons the request with message id @p id. Its handler is not called anymore.
+     */
+    void abandon(int id);
+
+    /**
+     * Returns true if the request @p id did not receive its final response yet.
+     */
+    [[nodiscard]] bool isPending(int id) const;
+
+    /**
+     * Returns the number of requests waiting for their final response.
+     */
+    [[nodiscard]] int pendingCount() const;
+
+    /**
+     * Reads the available responses and calls their handlers. Waits up to
+     * @p msecs milliseconds for the first one (-1 means forever).
+     * Returns the number of responses dispatched, or -1 if reading from
+     * the connection failed. In that case every pending request receives
+     * a response with type -1.
+     */
+    int dispatch(int msecs = 0);
+
+    /**
+     * Dispatches responses until the request @p id is finished or
+     * @p msecs milliseconds elapsed (-1 means forever).
+     * Returns true if the request is finished.
+     */
+    bool waitForFinished(int id, int msecs = -1);
+
+    /**
+     * Returns true if @p response is the last message of its request.
+     */
+    [[nodiscard]] static bool isFinal(const Response &response);
+
+private:
+    class LdapDispatcherPrivate;
+    std::unique_ptr<LdapDispatcherPrivate> const d;
+    Q_DISABLE_COPY(LdapDispatcher)
+};
+}
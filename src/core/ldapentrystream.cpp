@@ -0,0 +1,242 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapentrystream.h"
+#include "ldapobject_p.h"
+
+#include "ldap_core_debug.h"
+
+#include <QHash>
+#include <QtEndian>
+
+using namespace KLDAPCore;
+
+// frames larger than this are rejected instead of buffered
+#define LDAPENTRYSTREAM_MAX_FRAME (256 * 1024 * 1024)
+
+class Q_DECL_HIDDEN LdapEntryStream::LdapEntryStreamPrivate
+{
+public:
+    void appendLength(qsizetype length);
+    const QByteArray &encodedName(const LdapAttributeName &name);
+    bool decode(const QByteArray &arena, qsizetype begin, qsizetype end);
+
+    QByteArray mOutput;
+    QHash<int, QByteArray> mNames;
+    QByteArray mUninternedName;
+
+    QByteArray mInput;
+    qsizetype mPos = 0;
+    bool mEnded = false;
+    bool mError = false;
+    LdapObject mObject;
+    // reused between frames
+    QList<LdapObjectPrivate::Attribute> mAttributes;
+    QList<LdapObjectPrivate::Span> mValues;
+};
+
+void LdapEntryStream::LdapEntryStreamPrivate::appendLength(qsizetype length)
+{
+    const quint32 value = qToBigEndian(quint32(length));
+    mOutput.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+const QByteArray &LdapEntryStream::LdapEntryStreamPrivate::encodedName(const LdapAttributeName &name)
+{
+    if (name.id() == -1) {
+        // not interned, see LdapAttributeName
+        mUninternedName = name.name().toUtf8();
+        return mUninternedName;
+    }
+    auto it = mNames.find(name.id());
+    if (it == mNames.end()) {
+        it = mNames.insert(name.id(), name.name().toUtf8());
+    }
+    return it.value();
+}
+
+bool LdapEntryStream::LdapEntryStreamPrivate::decode(const QByteArray &arena, qsizetype begin, qsizetype end)
+{
+    const char *data = arena.constData();
+    qsizetype pos = begin;
+    // every count and length is followed by at least as many bytes
+    const auto read = [&](qsizetype &number) {
+        if (end - pos < 4) {
+            return false;
+        }
+        number = qFromBigEndian<quint32>(data + pos);
+        pos += 4;
+        return number <= end - pos;
+    };
+
+    qsizetype dnLength;
+    if (!read(dnLength)) {
+        return false;
+    }
+    const LdapDN dn(QString::fromUtf8(data + pos, dnLength));
+    pos += dnLength;
+
+    qsizetype attributeCount;
+    if (!read(attributeCount)) {
+        return false;
+    }
+    mAttributes.clear();
+    mValues.clear();
+    for (qsizetype i = 0; i < attributeCount; ++i) {
+        qsizetype nameLength;
+        if (!read(nameLength) || nameLength == 0) {
+            return false;
+        }
+        LdapObjectPrivate::Attribute attr;
+        attr.name = LdapAttributeName::fromUtf8(data + pos, nameLength);
+        attr.firstValue = mValues.size();
+        pos += nameLength;
+
+        qsizetype valueCount;
+        if (!read(valueCount)) {
+            return false;
+        }
+        for (qsizetype j = 0; j < valueCount; ++j) {
+            qsizetype valueLength;
+            if (!read(valueLength)) {
+                return false;
+            }
+            // the values stay where they are in the arena
+            LdapObjectPrivate::Span span;
+            span.offset = int(pos);
+            span.size = int(valueLength);
+            mValues.append(span);
+            pos += valueLength;
+        }
+        attr.valueCount = mValues.size() - attr.firstValue;
+        mAttributes.append(attr);
+    }
+    if (pos != end) {
+        return false;
+    }
+
+    mObject = LdapObjectPrivate::fromEntry(dn, arena, mAttributes, mValues);
+    return true;
+}
+
+LdapEntryStream::LdapEntryStream()
+    : d(new LdapEntryStreamPrivate)
+{
+}
+
+LdapEntryStream::~LdapEntryStream() = default;
+
+QString LdapEntryStream::mimeType()
+{
+    return QStringLiteral("application/x-kldap-entries");
+}
+
+void LdapEntryStream::writeObject(const LdapObject &object)
+{
+    const LdapObjectPrivate *o = LdapObjectPrivate::get(object);
+    const qsizetype start = d->mOutput.size();
+    // the frame length is filled in below
+    d->appendLength(0);
+
+    const QByteArray dn = o->mDn.toString().toUtf8();
+    d->appendLength(dn.size());
+    d->mOutput.append(dn);
+
+    d->appendLength(o->mAttributes.size());
+    for (const LdapObjectPrivate::Attribute &attr : o->mAttributes) {
+        const QByteArray &name = d->encodedName(attr.name);
+        d->appendLength(name.size());
+        d->mOutput.append(name);
+        d->appendLength(attr.valueCount);
+        for (int i = attr.firstValue; i < attr.firstValue + attr.valueCount; ++i) {
+            const QByteArrayView value = o->valueView(i);
+            d->appendLength(value.size());
+            d->mOutput.append(value);
+        }
+    }
+
+    qToBigEndian(quint32(d->mOutput.size() - start - 4), d->mOutput.data() + start);
+}
+
+QByteArray LdapEntryStream::data() const
+{
+    return d->mOutput;
+}
+
+void LdapEntryStream::clear()
+{
+    d->mOutput.resize(0);
+}
+
+void LdapEntryStream::startParsing()
+{
+    d->mInput.clear();
+    d->mPos = 0;
+    d->mEnded = false;
+    d->mError = false;
+    d->mObject.clear();
+}
+
+void LdapEntryStream::setData(const QByteArray &data)
+{
+    if (d->mPos == d->mInput.size()) {
+        // nothing is pending, share the data instead of copying it
+        d->mInput = data;
+    } else {
+        d->mInput.remove(0, d->mPos);
+        d->mInput.append(data);
+    }
+    d->mPos = 0;
+}
+
+void LdapEntryStream::endData()
+{
+    d->mEnded = true;
+}
+
+LdapEntryStream::ParseValue LdapEntryStream::nextItem()
+{
+    if (d->mError) {
+        return Err;
+    }
+
+    const qsizetype available = d->mInput.size() - d->mPos;
+    if (available == 0) {
+        return MoreData;
+    }
+    if (available >= 4) {
+        const qsizetype length = qFromBigEndian<quint32>(d->mInput.constData() + d->mPos);
+        if (length > LDAPENTRYSTREAM_MAX_FRAME) {
+            qCDebug(LDAP_LOG) << "entry frame too large:" << length;
+            d->mError = true;
+            return Err;
+        }
+        if (length <= available - 4) {
+            const qsizetype begin = d->mPos + 4;
+            const qsizetype end = begin + length;
+            d->mPos = end;
+            // the object references the input, and keeps it alive
+            if (!d->decode(d->mInput, begin, end)) {
+                qCDebug(LDAP_LOG) << "malformed entry frame";
+                d->mError = true;
+                return Err;
+            }
+            return Entry;
+        }
+    }
+    if (d->mEnded) {
+        qCDebug(LDAP_LOG) << "entry stream ends within a frame";
+        d->mError = true;
+        return Err;
+    }
+    return MoreData;
+}
+
+LdapObject LdapEntryStream::object() const
+{
+    return d->mObject;
+}
@@ -0,0 +1,102 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapobject.h"
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class writes and reads a compact binary stream of LDAP entries.
+ *
+ * It is the alternative of LDIF which kio_ldap sends when the metadata
+ * "x-kldap-format" of the job is "binary". The stream has the MIME type
+ * returned by mimeType(). Every entry is a frame of big-endian 32 bit
+ * lengths followed by raw bytes:
+ *
+ * @code
+ * frame length, DN length, DN, attribute count,
+ *   { name length, name, value count, { value length, value } }
+ * @endcode
+ *
+ * Values are neither BASE64 encoded nor folded, so binary attributes like
+ * jpegPhoto cost their size only. A frame which arrives in one piece is
+ * decoded without copying it, the values of the object reference the data
+ * passed to setData(). An object keeps all of that data alive as long
+ * as it exists.
+ *
+ * @code
+ * stream.setData(data);
+ * while (stream.nextItem() == LdapEntryStream::Entry) {
+ *     use(stream.object());
+ * }
+ * @endcode
+ */
+class KLDAP_CORE_EXPORT LdapEntryStream
+{
+public:
+    using ParseValue = enum { Entry, Err, MoreData };
+
+    LdapEntryStream();
+    ~LdapEntryStream();
+
+    /**
+     * Returns the MIME type of the stream.
+     */
+    [[nodiscard]] static QString mimeType();
+
+    /**
+     * Appends @p object as a frame to the output.
+     */
+    void writeObject(const LdapObject &object);
+    /**
+     * Returns the output.
+     */
+    [[nodiscard]] QByteArray data() const;
+    /**
+     * Discards the output, but keeps the memory for reuse.
+     */
+    void clear();
+
+    /**
+     * Discards the input and starts reading a new stream.
+     */
+    void startParsing();
+    /**
+     * Appends @p data to the input.
+     */
+    void setData(const QByteArray &data);
+    /**
+     * Marks the end of the input. An incomplete frame is an error then.
+     */
+    void endData();
+    /**
+     * Decodes the next frame. Returns Entry if object() holds a new entry,
+     * MoreData if the input does not hold a complete frame, or Err if the
+     * stream is malformed. Once Err was returned, the rest of the stream
+     * is ignored.
+     */
+    [[nodiscard]] ParseValue nextItem();
+    /**
+     * Returns the entry decoded by the last call of nextItem().
+     */
+    [[nodiscard]] LdapObject object() const;
+
+private:
+    class LdapEntryStreamPrivate;
+    std::unique_ptr<LdapEntryStreamPrivate> const d;
+    Q_DISABLE_COPY(LdapEntryStream)
+};
+}
@@ -0,0 +1,566 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapfilter.h"
+#include "ldapobject_p.h"
+
+#include <QByteArrayView>
+#include <QSharedData>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <iterator>
+
+using namespace KLDAPCore;
+
+// nesting deeper than this is rejected, so evaluating a filter can't exhaust the stack
+#define LDAPFILTER_MAX_DEPTH 128
+
+namespace
+{
+enum Result {
+    False,
+    True,
+    Undefined,
+};
+
+using FoldBuffer = QVarLengthArray<char, 256>;
+
+bool isAscii(QByteArrayView value)
+{
+    return std::none_of(value.cbegin(), value.cend(), [](char c) {
+        return uchar(c) >= 0x80;
+    });
+}
+
+char asciiLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+QByteArray fold(QByteArrayView value)
+{
+    return QString::fromUtf8(value).toCaseFolded().toUtf8();
+}
+
+// returns the case folded value, ASCII values are folded into buffer without allocating
+QByteArrayView foldValue(QByteArrayView value, FoldBuffer &buffer, QByteArray &folded)
+{
+    if (isAscii(value)) {
+        buffer.resize(value.size());
+        std::transform(value.cbegin(), value.cend(), buffer.begin(), asciiLower);
+        return QByteArrayView(buffer.constData(), buffer.size());
+    }
+    folded = fold(value);
+    return folded;
+}
+
+bool foldedEquals(QByteArrayView value, QByteArrayView folded)
+{
+    if (isAscii(value)) {
+        return value.size() == folded.size() && std::equal(value.cbegin(), value.cend(), folded.cbegin(), [](char c, char f) {
+                   return asciiLower(c) == f;
+               });
+    }
+    return fold(value) == folded;
+}
+
+bool isHexDigit(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool isNameChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+void appendEscaped(QByteArray &out, QByteArrayView value)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (const char c : value) {
+        if (c == '*' || c == '(' || c == ')' || c == '\\' || uchar(c) < 0x20 || c == 0x7f) {
+            out.append('\\');
+            out.append(hex[uchar(c) >> 4]);
+            out.append(hex[uchar(c) & 0xf]);
+        } else {
+            out.append(c);
+        }
+    }
+}
+}
+
+/**
+ * @internal
+ * The nodes are stored in prefix order: the operands of AND, OR and NOT
+ * follow their operator, and every node knows where its subtree ends.
+ */
+class LdapFilterPrivate : public QSharedData
+{
+public:
+    enum Op : quint8 {
+        And,
+        Or,
+        Not,
+        Equal,
+        Approx,
+        GreaterOrEqual,
+        LessOrEqual,
+        Present,
+        Substring,
+        Extensible,
+    };
+
+    struct Node {
+        Op op = And;
+        bool dnAttributes = false;
+        /** The index after the last node of the subtree. */
+        int end = 0;
+        KLDAPCore::LdapAttributeName attribute;
+        /** The values, for substrings the initial, any and final parts. */
+        int firstValue = 0;
+        int valueCount = 0;
+        /** The case folded matching rule of an extensible match. */
+        QByteArray rule;
+    };
+
+    void compile(const QByteArray &filter);
+    bool parse(const QByteArray &filter);
+    bool parseFilter(int depth);
+    bool parseItem(Node &node);
+    bool parseValue(Node &node, bool wildcards);
+
+    Result evaluate(int index, const LdapObjectPrivate *object) const;
+    Result evaluateItem(const Node &node, const LdapObjectPrivate *object) const;
+    [[nodiscard]] QByteArray serialize(int index) const;
+
+    QList<Node> mNodes;
+    QList<QByteArray> mValues;
+    QList<QByteArray> mFolded;
+    bool mValid = false;
+
+    // the parser state
+    const char *mPos = nullptr;
+    const char *mEnd = nullptr;
+};
+
+void LdapFilterPrivate::compile(const QByteArray &filter)
+{
+    mValid = parse(filter);
+    if (!mValid) {
+        mNodes.clear();
+        mValues.clear();
+        mFolded.clear();
+    }
+}
+
+bool LdapFilterPrivate::parse(const QByteArray &filter)
+{
+    const QByteArray trimmed = filter.trimmed();
+    if (trimmed.isEmpty()) {
+        // like the absolute true filter
+        mNodes.append(Node{And, false, 1});
+        return true;
+    }
+    const QByteArray wrapped = trimmed.startsWith('(') ? trimmed : QByteArray('(' + trimmed + ')');
+    mPos = wrapped.constData();
+    mEnd = mPos + wrapped.size();
+    const bool ok = parseFilter(0) && mPos == mEnd;
+    mPos = mEnd = nullptr;
+    return ok;
+}
+
+bool LdapFilterPrivate::parseFilter(int depth)
+{
+    if (depth > LDAPFILTER_MAX_DEPTH || mPos == mEnd || *mPos != '(') {
+        return false;
+    }
+    ++mPos;
+    if (mPos == mEnd) {
+        return false;
+    }
+
+    const int index = mNodes.count();
+    mNodes.append(Node());
+    if (*mPos == '&' || *mPos == '|' || *mPos == '!') {
+        const Op op = *mPos == '&' ? And : (*mPos == '|' ? Or : Not);
+        ++mPos;
+        int operands = 0;
+        while (mPos != mEnd && *mPos == '(') {
+            if (!parseFilter(depth + 1)) {
+                return false;
+            }
+            ++operands;
+        }
+        if (op == Not && operands != 1) {
+            return false;
+        }
+        mNodes[index].op = op;
+    } else {
+        Node node;
+        if (!parseItem(node)) {
+            return false;
+        }
+        mNodes[index] = node;
+    }
+    if (mPos == mEnd || *mPos != ')') {
+        return false;
+    }
+    ++mPos;
+    mNodes[index].end = mNodes.count();
+    return true;
+}
+
+bool LdapFilterPrivate::parseItem(Node &node)
+{
+    const char *start = mPos;
+    while (mPos != mEnd && (isNameChar(*mPos) || *mPos == ';')) {
+        ++mPos;
+    }
+    if (mPos != start) {
+        node.attribute = LdapAttributeName::fromUtf8(start, mPos - start);
+    }
+    if (mPos == mEnd) {
+        return false;
+    }
+
+    if (*mPos == ':') {
+        // attr [":dn"] [":" rule] ":=" value, or [":dn"] ":" rule ":=" value
+        node.op = Extensible;
+        while (mPos != mEnd && *mPos == ':' && !(mEnd - mPos > 1 && mPos[1] == '=')) {
+            ++mPos;
+            start = mPos;
+            while (mPos != mEnd && isNameChar(*mPos)) {
+                ++mPos;
+            }
+            const QByteArray part = QByteArray(start, mPos - start).toLower();
+            if (part.isEmpty()) {
+                return false;
+            } else if (part == "dn" && !node.dnAttributes && node.rule.isEmpty()) {
+                node.dnAttributes = true;
+            } else if (node.rule.isEmpty()) {
+                node.rule = part;
+            } else {
+                return false;
+            }
+        }
+        if (mEnd - mPos < 2 || mPos[0] != ':' || mPos[1] != '=' || (!node.attribute.isValid() && node.rule.isEmpty())) {
+            return false;
+        }
+        mPos += 2;
+        return parseValue(node, false);
+    }
+
+    if (!node.attribute.isValid()) {
+        return false;
+    }
+    if (*mPos == '=') {
+        node.op = Equal;
+        ++mPos;
+        return parseValue(node, true);
+    }
+    if (mEnd - mPos < 2 || mPos[1] != '=') {
+        return false;
+    }
+    switch (*mPos) {
+    case '~':
+        node.op = Approx;
+        break;
+    case '>':
+        node.op = GreaterOrEqual;
+        break;
+    case '<':
+        node.op = LessOrEqual;
+        break;
+    default:
+        return false;
+    }
+    mPos += 2;
+    return parseValue(node, false);
+}
+
+bool LdapFilterPrivate::parseValue(Node &node, bool wildcards)
+{
+    node.firstValue = mValues.count();
+    QByteArray value;
+    while (mPos != mEnd && *mPos != ')') {
+        const char c = *mPos++;
+        if (c == '(' || c == '\0') {
+            return false;
+        } else if (c == '*') {
+            if (!wildcards) {
+                return false;
+            }
+            mValues.append(value);
+            value.clear();
+        } else if (c == '\\') {
+            if (mEnd - mPos < 2 || !isHexDigit(mPos[0]) || !isHexDigit(mPos[1])) {
+                return false;
+            }
+            value.append(char(QByteArray(mPos, 2).toInt(nullptr, 16)));
+            mPos += 2;
+        } else {
+            value.append(c);
+        }
+    }
+    mValues.append(value);
+    node.valueCount = mValues.count() - node.firstValue;
+
+    if (node.valueCount > 1) {
+        if (node.valueCount == 2 && mValues.at(node.firstValue).isEmpty() && mValues.at(node.firstValue + 1).isEmpty()) {
+            node.op = Present;
+            mValues.resize(node.firstValue);
+            node.valueCount = 0;
+        } else {
+            node.op = Substring;
+        }
+    }
+    for (int i = node.firstValue; i < mValues.count(); ++i) {
+        mFolded.append(fold(mValues.at(i)));
+    }
+    return true;
+}
+
+Result LdapFilterPrivate::evaluate(int index, const LdapObjectPrivate *object) const
+{
+    const Node &node = mNodes.at(index);
+    switch (node.op) {
+    case And: {
+        Result result = True;
+        for (int child = index + 1; child < node.end; child = mNodes.at(child).end) {
+            const Result r = evaluate(child, object);
+            if (r == False) {
+                return False;
+            } else if (r == Undefined) {
+                result = Undefined;
+            }
+        }
+        return result;
+    }
+    case Or: {
+        Result result = False;
+        for (int child = index + 1; child < node.end; child = mNodes.at(child).end) {
+            const Result r = evaluate(child, object);
+            if (r == True) {
+                return True;
+            } else if (r == Undefined) {
+                result = Undefined;
+            }
+        }
+        return result;
+    }
+    case Not: {
+        const Result r = evaluate(index + 1, object);
+        return r == Undefined ? Undefined : (r == True ? False : True);
+    }
+    default:
+        return evaluateItem(node, object);
+    }
+}
+
+Result LdapFilterPrivate::evaluateItem(const Node &node, const LdapObjectPrivate *object) const
+{
+    Op op = node.op;
+    if (op == Extensible) {
+        // without a schema only the case ignoring rules are known
+        static const QByteArrayView caseIgnoreRules[] = {"caseignorematch", "2.5.13.2", "caseignoreia5match", "1.3.6.1.4.1.1466.109.114.2"};
+        const bool known = node.rule.isEmpty() || std::find(std::cbegin(caseIgnoreRules), std::cend(caseIgnoreRules), QByteArrayView(node.rule)) != std::cend(caseIgnoreRules);
+        if (!known || node.dnAttributes || !node.attribute.isValid()) {
+            return Undefined;
+        }
+        op = Equal;
+    }
+
+    const LdapObjectPrivate::Attribute *attribute = object->find(node.attribute);
+    if (!attribute || attribute->valueCount == 0) {
+        return False;
+    }
+    if (op == Present) {
+        return True;
+    }
+
+    const QByteArrayView assertion = mFolded.at(node.firstValue);
+    FoldBuffer buffer;
+    QByteArray folded;
+    for (int i = 0; i < attribute->valueCount; ++i) {
+        const QByteArrayView value = object->valueView(attribute->firstValue + i);
+        switch (op) {
+        case Equal:
+        case Approx:
+            if (foldedEquals(value, assertion)) {
+                return True;
+            }
+            break;
+        case GreaterOrEqual:
+        case LessOrEqual: {
+            const int cmp = foldValue(value, buffer, folded).compare(assertion);
+            if (op == GreaterOrEqual ? cmp >= 0 : cmp <= 0) {
+                return True;
+            }
+            break;
+        }
+        case Substring: {
+            const QByteArrayView v = foldValue(value, buffer, folded);
+            const QByteArrayView initial = mFolded.at(node.firstValue);
+            const QByteArrayView final = mFolded.at(node.firstValue + node.valueCount - 1);
+            if (v.size() < initial.size() + final.size() || !v.startsWith(initial) || !v.endsWith(final)) {
+                break;
+            }
+            qsizetype pos = initial.size();
+            const qsizetype end = v.size() - final.size();
+            bool match = true;
+            for (int j = node.firstValue + 1; match && j < node.firstValue + node.valueCount - 1; ++j) {
+                const QByteArrayView any = mFolded.at(j);
+                pos = v.first(end).indexOf(any, pos);
+                match = pos >= 0;
+                pos += any.size();
+            }
+            if (match) {
+                return True;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return False;
+}
+
+QByteArray LdapFilterPrivate::serialize(int index) const
+{
+    const Node &node = mNodes.at(index);
+    QByteArray out;
+    switch (node.op) {
+    case And:
+    case Or: {
+        QList<QByteArray> operands;
+        for (int child = index + 1; child < node.end; child = mNodes.at(child).end) {
+            operands.append(serialize(child));
+        }
+        std::sort(operands.begin(), operands.end());
+        operands.erase(std::unique(operands.begin(), operands.end()), operands.end());
+        if (operands.count() == 1) {
+            return operands.constFirst();
+        }
+        out = node.op == And ? "(&" : "(|";
+        for (const QByteArray &operand : std::as_const(operands)) {
+            out += operand;
+        }
+        out += ')';
+        return out;
+    }
+    case Not:
+        return "(!" + serialize(index + 1) + ')';
+    default:
+        break;
+    }
+
+    out += '(';
+    if (node.attribute.isValid()) {
+        out += node.attribute.foldedName().toUtf8();
+    }
+    switch (node.op) {
+    case Equal:
+        out += '=';
+        break;
+    case Approx:
+        out += "~=";
+        break;
+    case GreaterOrEqual:
+        out += ">=";
+        break;
+    case LessOrEqual:
+        out += "<=";
+        break;
+    case Present:
+        out += "=*";
+        break;
+    case Substring:
+        out += '=';
+        break;
+    case Extensible:
+        if (node.dnAttributes) {
+            out += ":dn";
+        }
+        if (!node.rule.isEmpty()) {
+            out += ':' + node.rule;
+        }
+        out += ":=";
+        break;
+    default:
+        break;
+    }
+    for (int i = 0; i < node.valueCount; ++i) {
+        if (i > 0) {
+            out += '*';
+        }
+        appendEscaped(out, mValues.at(node.firstValue + i));
+    }
+    out += ')';
+    return out;
+}
+
+LdapFilter::LdapFilter()
+    : d(new LdapFilterPrivate)
+{
+}
+
+LdapFilter::LdapFilter(const QString &filter)
+    : d(new LdapFilterPrivate)
+{
+    d->compile(filter.toUtf8());
+}
+
+LdapFilter LdapFilter::fromUtf8(QByteArrayView filter)
+{
+    LdapFilter result;
+    result.d->compile(filter.toByteArray());
+    return result;
+}
+
+LdapFilter::~LdapFilter() = default;
+
+LdapFilter::LdapFilter(const LdapFilter &that) = default;
+
+LdapFilter &LdapFilter::operator=(const LdapFilter &that) = default;
+
+bool LdapFilter::isValid() const
+{
+    return d->mValid;
+}
+
+bool LdapFilter::matches(const LdapObject &object) const
+{
+    return d->mValid && d->evaluate(0, LdapObjectPrivate::get(object)) == True;
+}
+
+QList<LdapAttributeName> LdapFilter::attributes() const
+{
+    QList<LdapAttributeName> result;
+    for (const LdapFilterPrivate::Node &node : std::as_const(d->mNodes)) {
+        if (node.attribute.isValid() && !result.contains(node.attribute)) {
+            result.append(node.attribute);
+        }
+    }
+    return result;
+}
+
+QString LdapFilter::toString() const
+{
+    return d->mValid ? QString::fromUtf8(d->serialize(0)) : QString();
+}
+
+bool LdapFilter::operator==(const LdapFilter &rhs) const
+{
+    return d == rhs.d || toString() == rhs.toString();
+}
+
+bool LdapFilter::operator!=(const LdapFilter &rhs) const
+{
+    return !operator==(rhs);
+}
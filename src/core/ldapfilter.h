@@ -0,0 +1,96 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArrayView>
+#include <QList>
+#include <QSharedDataPointer>
+#include <QString>
+
+#include "kldap_core_export.h"
+#include "ldapattributename.h"
+#include "ldapobject.h"
+
+class LdapFilterPrivate;
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class represents a compiled LDAP search filter (RFC 4515).
+ *
+ * The filter string is parsed once into a flat array of nodes, with the
+ * attribute names interned and the assertion values case folded, so that
+ * matches() can test many objects quickly without allocating memory.
+ * Values are compared ignoring their case, which is what the common
+ * matching rules of names and mail addresses do.
+ *
+ * Equality, substring, presence, AND, OR and NOT, as well as the absolute
+ * true "(&)" and false "(|)" filters are evaluated exactly. Approximate
+ * matches are evaluated as equality and ordering matches by comparing the
+ * case folded values, extensible matches are undefined unless they use
+ * no or a case ignoring matching rule. As in LDAP, an undefined
+ * assertion does not match, and neither does its negation.
+ *
+ * toString() returns the canonical form of the filter: attribute names
+ * in lower case, the operands of AND and OR sorted without duplicates,
+ * and the values escaped in one way. Filters which only differ in these
+ * respects have the same canonical form, so it can be used as a cache key.
+ *
+ * Copies share the compiled filter.
+ */
+class KLDAP_CORE_EXPORT LdapFilter
+{
+public:
+    /**
+     * Constructs an invalid filter.
+     */
+    LdapFilter();
+    /**
+     * Parses @p filter. The outer parentheses are optional. An empty
+     * filter matches every object.
+     */
+    explicit LdapFilter(const QString &filter);
+    /**
+     * Parses the UTF-8 encoded @p filter.
+     */
+    [[nodiscard]] static LdapFilter fromUtf8(QByteArrayView filter);
+    ~LdapFilter();
+
+    LdapFilter(const LdapFilter &that);
+    LdapFilter &operator=(const LdapFilter &that);
+
+    /**
+     * Returns true if the filter was parsed successfully.
+     */
+    [[nodiscard]] bool isValid() const;
+
+    /**
+     * Returns true if @p object matches the filter. An invalid filter
+     * does not match any object.
+     */
+    [[nodiscard]] bool matches(const LdapObject &object) const;
+
+    /**
+     * Returns the attributes the filter tests, each once.
+     */
+    [[nodiscard]] QList<LdapAttributeName> attributes() const;
+
+    /**
+     * Returns the canonical form of the filter, or an empty string if it
+     * is invalid.
+     */
+    [[nodiscard]] QString toString() const;
+
+    [[nodiscard]] bool operator==(const LdapFilter &rhs) const;
+    [[nodiscard]] bool operator!=(const LdapFilter &rhs) const;
+
+private:
+    QSharedDataPointer<LdapFilterPrivate> d;
+};
+}
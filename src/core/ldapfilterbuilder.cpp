@@ -0,0 +1,236 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapfilterbuilder.h"
+
+#include <QStringEncoder>
+
+using namespace KLDAPCore;
+
+class Q_DECL_HIDDEN LdapFilterBuilder::LdapFilterBuilderPrivate
+{
+public:
+    // appends trusted text
+    void append(QStringView text);
+    void appendAttribute(QStringView attribute);
+    LdapFilterBuilder &item(LdapFilterBuilder *q, QStringView attribute, const char *op, QStringView value, const char *suffix = "");
+
+    QByteArray mBuffer;
+    QStringEncoder mEncoder{QStringEncoder::Utf8};
+    int mDepth = 0;
+    bool mValid = true;
+};
+
+void LdapFilterBuilder::LdapFilterBuilderPrivate::append(QStringView text)
+{
+    const qsizetype size = mBuffer.size();
+    mBuffer.resize(size + mEncoder.requiredSpace(text.size()));
+    char *end = mEncoder.appendToBuffer(mBuffer.data() + size, text);
+    mBuffer.truncate(end - mBuffer.constData());
+}
+
+void LdapFilterBuilder::LdapFilterBuilderPrivate::appendAttribute(QStringView attribute)
+{
+    // a descriptor or an OID, with options
+    bool ok = !attribute.isEmpty();
+    for (const QChar c : attribute) {
+        ok = ok && c.unicode() < 0x80 && (c.isLetterOrNumber() || c == QLatin1Char('-') || c == QLatin1Char('.') || c == QLatin1Char(';'));
+    }
+    if (!ok) {
+        mValid = false;
+    }
+    append(attribute);
+}
+
+LdapFilterBuilder &
+LdapFilterBuilder::LdapFilterBuilderPrivate::item(LdapFilterBuilder *q, QStringView attribute, const char *op, QStringView value, const char *suffix)
+{
+    mBuffer.append('(');
+    appendAttribute(attribute);
+    mBuffer.append(op);
+    escape(value, mBuffer);
+    mBuffer.append(suffix);
+    mBuffer.append(')');
+    return *q;
+}
+
+LdapFilterBuilder::LdapFilterBuilder()
+    : d(new LdapFilterBuilderPrivate)
+{
+}
+
+LdapFilterBuilder::~LdapFilterBuilder() = default;
+
+void LdapFilterBuilder::clear()
+{
+    d->mBuffer.resize(0);
+    d->mDepth = 0;
+    d->mValid = true;
+}
+
+LdapFilterBuilder &LdapFilterBuilder::beginAnd()
+{
+    d->mBuffer.append("(&");
+    ++d->mDepth;
+    return *this;
+}
+
+LdapFilterBuilder &LdapFilterBuilder::beginOr()
+{
+    d->mBuffer.append("(|");
+    ++d->mDepth;
+    return *this;
+}
+
+LdapFilterBuilder &LdapFilterBuilder::beginNot()
+{
+    d->mBuffer.append("(!");
+    ++d->mDepth;
+    return *this;
+}
+
+LdapFilterBuilder &LdapFilterBuilder::end()
+{
+    if (d->mDepth == 0) {
+        d->mValid = false;
+        return *this;
+    }
+    d->mBuffer.append(')');
+    --d->mDepth;
+    return *this;
+}
+
+LdapFilterBuilder &LdapFilterBuilder::equal(QStringView attribute, QStringView value)
+{
+    return d->item(this, attribute, "=", value);
+}
+
+LdapFilterBuilder &LdapFilterBuilder::approx(QStringView attribute, QStringView value)
+{
+    return d->item(this, attribute, "~=", value);
+}
+
+LdapFilterBuilder &LdapFilterBuilder::greaterOrEqual(QStringView attribute, QStringView value)
+{
+    return d->item(this, attribute, ">=", value);
+}
+
+LdapFilterBuilder &LdapFilterBuilder::lessOrEqual(QStringView attribute, QStringView value)
+{
+    return d->item(this, attribute, "<=", value);
+}
+
+LdapFilterBuilder &LdapFilterBuilder::present(QStringView attribute)
+{
+    return d->item(this, attribute, "=*", {});
+}
+
+LdapFilterBuilder &LdapFilterBuilder::startsWith(QStringView attribute, QStringView value)
+{
+    return d->item(this, attribute, "=", value, "*");
+}
+
+LdapFilterBuilder &LdapFilterBuilder::contains(QStringView attribute, QStringView value)
+{
+    return d->item(this, attribute, "=*", value, "*");
+}
+
+LdapFilterBuilder &LdapFilterBuilder::endsWith(QStringView attribute, QStringView value)
+{
+    return d->item(this, attribute, "=*", value);
+}
+
+LdapFilterBuilder &LdapFilterBuilder::filter(QStringView filter)
+{
+    return expand(filter, {});
+}
+
+LdapFilterBuilder &LdapFilterBuilder::expand(QStringView filterTemplate, QStringView value)
+{
+    filterTemplate = filterTemplate.trimmed();
+    const bool wrap = !filterTemplate.startsWith(QLatin1Char('('));
+    if (wrap) {
+        d->mBuffer.append('(');
+    }
+    qsizetype pos = 0;
+    qsizetype next;
+    while ((next = filterTemplate.indexOf(QLatin1String("%1"), pos)) >= 0) {
+        d->append(filterTemplate.sliced(pos, next - pos));
+        escape(value, d->mBuffer);
+        pos = next + 2;
+    }
+    d->append(filterTemplate.sliced(pos));
+    if (wrap) {
+        d->mBuffer.append(')');
+    }
+    return *this;
+}
+
+bool LdapFilterBuilder::isValid() const
+{
+    return d->mValid && d->mDepth == 0 && !d->mBuffer.isEmpty();
+}
+
+bool LdapFilterBuilder::isEmpty() const
+{
+    return d->mBuffer.isEmpty();
+}
+
+QByteArrayView LdapFilterBuilder::data() const
+{
+    return d->mBuffer;
+}
+
+QString LdapFilterBuilder::toString() const
+{
+    return QString::fromUtf8(d->mBuffer);
+}
+
+LdapFilter LdapFilterBuilder::toFilter() const
+{
+    return isValid() ? LdapFilter::fromUtf8(d->mBuffer) : LdapFilter();
+}
+
+QString LdapFilterBuilder::canonicalString() const
+{
+    return toFilter().toString();
+}
+
+void LdapFilterBuilder::escape(QStringView value, QByteArray &out)
+{
+    static const char hex[] = "0123456789abcdef";
+    qsizetype run = 0;
+    const auto flush = [&](qsizetype pos) {
+        // the characters which need no escaping are encoded in one go
+        if (pos > run) {
+            const QStringView text = value.sliced(run, pos - run);
+            const qsizetype size = out.size();
+            QStringEncoder encoder(QStringEncoder::Utf8);
+            out.resize(size + encoder.requiredSpace(text.size()));
+            char *end = encoder.appendToBuffer(out.data() + size, text);
+            out.truncate(end - out.constData());
+        }
+    };
+    for (qsizetype i = 0; i < value.size(); ++i) {
+        const char16_t c = value.at(i).unicode();
+        if (c == u'*' || c == u'(' || c == u')' || c == u'\\' || c < 0x20 || c == 0x7f) {
+            flush(i);
+            out.append('\\');
+            out.append(hex[c >> 4]);
+            out.append(hex[c & 0xf]);
+            run = i + 1;
+        }
+    }
+    flush(value.size());
+}
+
+QString LdapFilterBuilder::escape(QStringView value)
+{
+    QByteArray out;
+    escape(value, out);
+    return QString::fromUtf8(out);
+}
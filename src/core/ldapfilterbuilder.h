@@ -0,0 +1,138 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapfilter.h"
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class builds LDAP search filters (RFC 4515) from untrusted values.
+ *
+ * Every value is escaped, so user input can't change the structure of the
+ * filter or add wildcards. The filter is written as UTF-8 into a buffer
+ * which clear() keeps, so building a filter per keystroke does not
+ * allocate once the buffer is large enough.
+ *
+ * @code
+ * builder.clear();
+ * builder.beginAnd().present(u"mail").beginOr().startsWith(u"cn", text).startsWith(u"mail", text).end().end();
+ * @endcode
+ *
+ * Attribute names and the filters passed to filter() and expand() are
+ * trusted, only the values are escaped. A builder which was given an
+ * invalid attribute name or whose groups are not balanced is invalid.
+ */
+class KLDAP_CORE_EXPORT LdapFilterBuilder
+{
+public:
+    LdapFilterBuilder();
+    ~LdapFilterBuilder();
+
+    /**
+     * Discards the filter, but keeps the buffer.
+     */
+    void clear();
+
+    /**
+     * Starts an AND, OR or NOT group. The group contains the filters added
+     * until the matching end().
+     */
+    LdapFilterBuilder &beginAnd();
+    LdapFilterBuilder &beginOr();
+    LdapFilterBuilder &beginNot();
+    /**
+     * Ends the innermost group.
+     */
+    LdapFilterBuilder &end();
+
+    /**
+     * Adds the assertion that @p attribute has a value equal to @p value.
+     */
+    LdapFilterBuilder &equal(QStringView attribute, QStringView value);
+    LdapFilterBuilder &approx(QStringView attribute, QStringView value);
+    LdapFilterBuilder &greaterOrEqual(QStringView attribute, QStringView value);
+    LdapFilterBuilder &lessOrEqual(QStringView attribute, QStringView value);
+    /**
+     * Adds the assertion that @p attribute has a value.
+     */
+    LdapFilterBuilder &present(QStringView attribute);
+    /**
+     * Adds the assertion that @p attribute has a value starting with,
+     * containing or ending with @p value.
+     */
+    LdapFilterBuilder &startsWith(QStringView attribute, QStringView value);
+    LdapFilterBuilder &contains(QStringView attribute, QStringView value);
+    LdapFilterBuilder &endsWith(QStringView attribute, QStringView value);
+
+    /**
+     * Adds the trusted filter @p filter as it is. The outer parentheses
+     * are added if they are missing.
+     */
+    LdapFilterBuilder &filter(QStringView filter);
+    /**
+     * Adds the trusted filter template @p filterTemplate, with every "%1"
+     * replaced by the escaped @p value. The outer parentheses are added if
+     * they are missing. This is the safe replacement of
+     * QString::arg() for the templates of LdapClientSearch::setFilter().
+     */
+    LdapFilterBuilder &expand(QStringView filterTemplate, QStringView value);
+
+    /**
+     * Returns true if the filter is complete.
+     */
+    [[nodiscard]] bool isValid() const;
+    /**
+     * Returns true if nothing was added since the last clear().
+     */
+    [[nodiscard]] bool isEmpty() const;
+
+    /**
+     * Returns the UTF-8 encoded filter. The view is valid until the
+     * builder is changed.
+     */
+    [[nodiscard]] QByteArrayView data() const;
+    /**
+     * Returns the filter.
+     */
+    [[nodiscard]] QString toString() const;
+    /**
+     * Returns the compiled filter.
+     */
+    [[nodiscard]] LdapFilter toFilter() const;
+    /**
+     * Returns the canonical form of the filter (see LdapFilter::toString()),
+     * which is the same for equivalent filters and can be used as a cache key.
+     */
+    [[nodiscard]] QString canonicalString() const;
+
+    /**
+     * Appends @p value to @p out as UTF-8, escaping the characters which
+     * have a meaning in filters.
+     */
+    static void escape(QStringView value, QByteArray &out);
+    /**
+     * Returns @p value with the characters which have a meaning in filters escaped.
+     */
+    [[nodiscard]] static QString escape(QStringView value);
+
+private:
+    class LdapFilterBuilderPrivate;
+    std::unique_ptr<LdapFilterBuilderPrivate> const d;
+    Q_DISABLE_COPY(LdapFilterBuilder)
+};
+}
@@ -0,0 +1,473 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapmodel.h"
+#include "ldapcontrol.h"
+#include "ldapdefs.h"
+#include "ldapdispatcher.h"
+#include "ldappreparedsearch.h"
+
+#include "ldap_core_debug.h"
+
+#include <QList>
+#include <QSet>
+
+#include <utility>
+#include <vector>
+
+using namespace KLDAPCore;
+
+namespace
+{
+struct LdapModelNode {
+    enum State {
+        NotFetched, ///< the children were not searched yet, or were discarded
+        More, ///< some pages of the children are loaded
+        Done, ///< all children are loaded
+    };
+
+    LdapModelNode *parent = nullptr;
+    int row = 0;
+    LdapObject object;
+    std::vector<std::unique_ptr<LdapModelNode>> children;
+    // entries received, but not inserted yet
+    QList<LdapObject> pending;
+    // the page cookie to continue with
+    QByteArray cookie;
+    // the message id of the running search, 0 if there is none
+    int id = 0;
+    State state = NotFetched;
+    bool mayHaveChildren = true;
+    // set while the search is repeated because the server forgot the cookie,
+    // the DNs of the children which are loaded already are skipped
+    bool restarted = false;
+    QSet<QString> known;
+};
+}
+
+class Q_DECL_HIDDEN LdapModel::LdapModelPrivate
+{
+public:
+    LdapModelPrivate(LdapModel *qq, LdapConnection &connection)
+        : q(qq)
+        , mConn(connection)
+        , mDispatcher(connection)
+    {
+    }
+
+    [[nodiscard]] LdapModelNode *node(const QModelIndex &index) const;
+    [[nodiscard]] QModelIndex indexOf(const LdapModelNode *node) const;
+    void updateAttributes();
+    void fetch(LdapModelNode *node);
+    void received(LdapModelNode *node, const LdapDispatcher::Response &response);
+    void flush(LdapModelNode *node);
+    void evict();
+    void discardChildren(LdapModelNode *node);
+    int forget(LdapModelNode *node);
+
+    LdapModel *const q;
+    LdapConnection &mConn;
+    LdapDispatcher mDispatcher;
+    // the base, scope, filter and attributes are converted once, only the base
+    // and the page cookie change between the requests
+    LdapPreparedSearch mSearch;
+    // the invisible root item, which is the base DN
+    mutable LdapModelNode mRoot;
+    QString mFilter;
+    QStringList mAttributes;
+    int mPageSize = 100;
+    int mMaximumEntries = 10000;
+    int mLoaded = 0;
+    // the collapsed branches, the one collapsed first comes first
+    QList<LdapModelNode *> mCollapsed;
+};
+
+static QString kldap_dn_key(const LdapDN &dn)
+{
+    return dn.toString().toLower();
+}
+
+LdapModelNode *LdapModel::LdapModelPrivate::node(const QModelIndex &index) const
+{
+    return index.isValid() ? static_cast<LdapModelNode *>(index.internalPointer()) : &mRoot;
+}
+
+QModelIndex LdapModel::LdapModelPrivate::indexOf(const LdapModelNode *node) const
+{
+    if (node == &mRoot) {
+        return {};
+    }
+    return q->createIndex(node->row, 0, const_cast<LdapModelNode *>(node));
+}
+
+void LdapModel::LdapModelPrivate::updateAttributes()
+{
+    // hasSubordinates is operational, so it is only returned if asked for
+    QStringList attributes = mAttributes;
+    if (attributes.isEmpty()) {
+        attributes.append(QStringLiteral("*"));
+    }
+    attributes.append(QStringLiteral("hasSubordinates"));
+    mSearch.setAttributes(attributes);
+}
+
+void LdapModel::LdapModelPrivate::fetch(LdapModelNode *node)
+{
+    if (mPageSize > 0) {
+        mConn.setOption(0x0008, nullptr); // Disable referals or paging won't work
+    }
+    mSearch.setBase(node->object.dn());
+    mSearch.setPageControl(mPageSize, node->cookie);
+    node->id = mDispatcher.search(mSearch, [this, node](const LdapDispatcher::Response &response) {
+        received(node, response);
+    });
+    if (node->id < 0) {
+        node->id = 0;
+        node->state = LdapModelNode::Done;
+        Q_EMIT q->fetchFailed(indexOf(node), mConn.ldapErrorCode(), mConn.ldapErrorString());
+    }
+}
+
+void LdapModel::LdapModelPrivate::received(LdapModelNode *node, const LdapDispatcher::Response &response)
+{
+    if (response.type == LdapOperation::RES_SEARCH_ENTRY) {
+        if (node->restarted && node->known.contains(kldap_dn_key(response.object.dn()))) {
+            return;
+        }
+        node->pending.append(response.object);
+        // insert large pages in parts, if the server does not page
+        if (node->pending.count() >= qMax(mPageSize, 100)) {
+            flush(node);
+        }
+        return;
+    }
+
+    node->id = 0;
+    if (response.type == -1 || response.error != KLDAP_SUCCESS) {
+        flush(node);
+        if (!node->cookie.isEmpty() && !node->restarted) {
+            // Servers keep only one paged search per connection, so the cookie
+            // is gone if another branch was paged meanwhile. Search again, and
+            // skip the children which are loaded already.
+            qCDebug(LDAP_LOG) << "continuing the paged search failed, restarting it:" << response.errorString;
+            node->restarted = true;
+            node->cookie.clear();
+            node->known.clear();
+            for (const auto &child : node->children) {
+                node->known.insert(kldap_dn_key(child->object.dn()));
+            }
+            fetch(node);
+            return;
+        }
+        node->cookie.clear();
+        node->state = LdapModelNode::Done;
+        node->restarted = false;
+        node->known.clear();
+        Q_EMIT q->fetchFailed(indexOf(node), response.error, response.errorString);
+        return;
+    }
+
+    QByteArray cookie;
+    if (mPageSize > 0) {
+        for (const LdapControl &ctrl : response.controls) {
+            if (ctrl.parsePageControl(cookie) != -1) {
+                break;
+            }
+        }
+    }
+    node->cookie = cookie;
+    node->restarted = false;
+    if (cookie.isEmpty()) {
+        node->state = LdapModelNode::Done;
+        node->known.clear();
+    } else {
+        node->state = LdapModelNode::More;
+    }
+    flush(node);
+    if (node->state == LdapModelNode::Done && node->children.empty() && node != &mRoot) {
+        // let the view remove the expander
+        node->mayHaveChildren = false;
+        const QModelIndex index = indexOf(node);
+        Q_EMIT q->dataChanged(index, index);
+    }
+    evict();
+}
+
+void LdapModel::LdapModelPrivate::flush(LdapModelNode *node)
+{
+    if (node->pending.isEmpty()) {
+        return;
+    }
+    const int first = int(node->children.size());
+    q->beginInsertRows(indexOf(node), first, first + int(node->pending.count()) - 1);
+    node->children.reserve(node->children.size() + node->pending.count());
+    for (const LdapObject &object : std::as_const(node->pending)) {
+        auto child = std::make_unique<LdapModelNode>();
+        child->parent = node;
+        child->row = int(node->children.size());
+        child->object = object;
+        child->mayHaveChildren = object.value(QStringLiteral("hasSubordinates")).compare("FALSE", Qt::CaseInsensitive) != 0;
+        node->children.push_back(std::move(child));
+    }
+    mLoaded += int(node->pending.count());
+    node->pending.clear();
+    q->endInsertRows();
+}
+
+void LdapModel::LdapModelPrivate::evict()
+{
+    if (mMaximumEntries <= 0) {
+        return;
+    }
+    while (mLoaded > mMaximumEntries && !mCollapsed.isEmpty()) {
+        LdapModelNode *node = mCollapsed.takeFirst();
+        qCDebug(LDAP_LOG) << "discarding the children of" << node->object.dn().toString();
+        discardChildren(node);
+    }
+}
+
+void LdapModel::LdapModelPrivate::discardChildren(LdapModelNode *node)
+{
+    if (node->id) {
+        mDispatcher.abandon(node->id);
+        node->id = 0;
+    }
+    if (!node->children.empty()) {
+        q->beginRemoveRows(indexOf(node), 0, int(node->children.size()) - 1);
+        for (const auto &child : node->children) {
+            mLoaded -= forget(child.get());
+        }
+        node->children.clear();
+        q->endRemoveRows();
+    }
+    node->pending.clear();
+    node->cookie.clear();
+    node->state = LdapModelNode::NotFetched;
+    node->restarted = false;
+    node->known.clear();
+}
+
+int LdapModel::LdapModelPrivate::forget(LdapModelNode *node)
+{
+    // the node is about to be deleted, drop every reference to it
+    mCollapsed.removeOne(node);
+    if (node->id) {
+        mDispatcher.abandon(node->id);
+    }
+    int count = 1;
+    for (const auto &child : node->children) {
+        count += forget(child.get());
+    }
+    return count;
+}
+
+LdapModel::LdapModel(LdapConnection &connection, QObject *parent)
+    : QAbstractItemModel(parent)
+    , d(new LdapModelPrivate(this, connection))
+{
+    d->mSearch.setScope(LdapUrl::One);
+    d->updateAttributes();
+}
+
+LdapModel::~LdapModel()
+{
+    for (const auto &child : d->mRoot.children) {
+        d->forget(child.get());
+    }
+    if (d->mRoot.id) {
+        d->mDispatcher.abandon(d->mRoot.id);
+    }
+}
+
+void LdapModel::setBaseDn(const LdapDN &dn)
+{
+    d->mRoot.object.setDn(dn);
+    clear();
+}
+
+LdapDN LdapModel::baseDn() const
+{
+    return d->mRoot.object.dn();
+}
+
+void LdapModel::setFilter(const QString &filter)
+{
+    d->mFilter = filter;
+    d->mSearch.setFilter(filter);
+    clear();
+}
+
+QString LdapModel::filter() const
+{
+    return d->mFilter;
+}
+
+void LdapModel::setAttributes(const QStringList &attributes)
+{
+    d->mAttributes = attributes;
+    d->updateAttributes();
+    clear();
+}
+
+QStringList LdapModel::attributes() const
+{
+    return d->mAttributes;
+}
+
+void LdapModel::setPageSize(int size)
+{
+    d->mPageSize = qMax(0, size);
+}
+
+int LdapModel::pageSize() const
+{
+    return d->mPageSize;
+}
+
+void LdapModel::setMaximumEntries(int count)
+{
+    d->mMaximumEntries = qMax(0, count);
+    d->evict();
+}
+
+int LdapModel::maximumEntries() const
+{
+    return d->mMaximumEntries;
+}
+
+int LdapModel::entryCount() const
+{
+    return d->mLoaded;
+}
+
+LdapObject LdapModel::object(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return {};
+    }
+    return d->node(index)->object;
+}
+
+LdapDN LdapModel::dn(const QModelIndex &index) const
+{
+    return d->node(index)->object.dn();
+}
+
+void LdapModel::collapse(const QModelIndex &index)
+{
+    if (!index.isValid()) {
+        return;
+    }
+    LdapModelNode *node = d->node(index);
+    d->mCollapsed.removeOne(node);
+    d->mCollapsed.append(node);
+    d->evict();
+}
+
+void LdapModel::expand(const QModelIndex &index)
+{
+    d->mCollapsed.removeOne(d->node(index));
+}
+
+void LdapModel::clear()
+{
+    beginResetModel();
+    for (const auto &child : d->mRoot.children) {
+        d->forget(child.get());
+    }
+    d->mRoot.children.clear();
+    if (d->mRoot.id) {
+        d->mDispatcher.abandon(d->mRoot.id);
+        d->mRoot.id = 0;
+    }
+    d->mRoot.pending.clear();
+    d->mRoot.cookie.clear();
+    d->mRoot.state = LdapModelNode::NotFetched;
+    d->mRoot.restarted = false;
+    d->mRoot.known.clear();
+    d->mCollapsed.clear();
+    d->mLoaded = 0;
+    endResetModel();
+}
+
+QModelIndex LdapModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (column != 0 || row < 0) {
+        return {};
+    }
+    const LdapModelNode *node = d->node(parent);
+    if (row >= int(node->children.size())) {
+        return {};
+    }
+    return createIndex(row, column, node->children[row].get());
+}
+
+QModelIndex LdapModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return {};
+    }
+    return d->indexOf(d->node(index)->parent);
+}
+
+int LdapModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return int(d->node(parent)->children.size());
+}
+
+int LdapModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return 1;
+}
+
+bool LdapModel::hasChildren(const QModelIndex &parent) const
+{
+    const LdapModelNode *node = d->node(parent);
+    if (!node->children.empty()) {
+        return true;
+    }
+    return node->state != LdapModelNode::Done && node->mayHaveChildren;
+}
+
+QVariant LdapModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return {};
+    }
+    const LdapModelNode *node = d->node(index);
+    switch (role) {
+    case Qt::DisplayRole:
+        return node->object.dn().rdnString();
+    case Qt::ToolTipRole:
+    case DnRole:
+        return node->object.dn().toString();
+    default:
+        return {};
+    }
+}
+
+bool LdapModel::canFetchMore(const QModelIndex &parent) const
+{
+    const LdapModelNode *node = d->node(parent);
+    return node->id == 0 && node->mayHaveChildren && node->state != LdapModelNode::Done;
+}
+
+void LdapModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    LdapModelNode *node = d->node(parent);
+    d->mCollapsed.removeOne(node);
+    d->fetch(node);
+}
+
+#include "moc_ldapmodel.cpp"
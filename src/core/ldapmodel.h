@@ -0,0 +1,142 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QAbstractItemModel>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapconnection.h"
+#include "ldapdn.h"
+#include "ldapobject.h"
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class is a tree model of a subtree of an LDAP directory, which is
+ * loaded lazily.
+ *
+ * The top level items are the entries directly below the base DN. The
+ * children of an entry are only searched when a view asks for them with
+ * fetchMore(), one level at a time, and in pages of pageSize() entries
+ * using the paged results control. Every fetchMore() call loads the next
+ * page, so a view only loads the entries the user scrolls to.
+ *
+ * To keep the memory bounded, the children of collapsed branches are
+ * discarded when more than maximumEntries() entries are loaded, starting
+ * with the branch which was collapsed first. They are searched again when
+ * the branch is expanded. Connect the collapsed() and expanded() signals
+ * of the view to collapse() and expand() to let the model know about them.
+ *
+ * The connection must be connected and bound, and must outlive the model.
+ */
+class KLDAP_CORE_EXPORT LdapModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * The additional roles of the items.
+     */
+    enum Roles {
+        DnRole = Qt::UserRole + 1, ///< The DN of the entry, as a string.
+    };
+
+    explicit LdapModel(LdapConnection &connection, QObject *parent = nullptr);
+    ~LdapModel() override;
+
+    /**
+     * Sets the base DN, whose children are the top level items, and clears the model.
+     */
+    void setBaseDn(const LdapDN &dn);
+    [[nodiscard]] LdapDN baseDn() const;
+
+    /**
+     * Sets the filter which the children of every entry must match, and
+     * clears the model. An empty filter matches every entry.
+     */
+    void setFilter(const QString &filter);
+    [[nodiscard]] QString filter() const;
+
+    /**
+     * Sets the attributes to load for every entry, and clears the model.
+     * An empty list loads all user attributes.
+     */
+    void setAttributes(const QStringList &attributes);
+    [[nodiscard]] QStringList attributes() const;
+
+    /**
+     * Sets the number of children to load at once. 0 loads all children
+     * of an entry at once. The default is 100.
+     */
+    void setPageSize(int size);
+    [[nodiscard]] int pageSize() const;
+
+    /**
+     * Sets the number of loaded entries above which the children of
+     * collapsed branches are discarded. 0 means no limit. The default
+     * is 10000.
+     */
+    void setMaximumEntries(int count);
+    [[nodiscard]] int maximumEntries() const;
+
+    /**
+     * Returns the number of loaded entries.
+     */
+    [[nodiscard]] int entryCount() const;
+
+    /**
+     * Returns the entry of @p index.
+     */
+    [[nodiscard]] LdapObject object(const QModelIndex &index) const;
+    /**
+     * Returns the DN of the entry of @p index, or the base DN for an invalid index.
+     */
+    [[nodiscard]] LdapDN dn(const QModelIndex &index) const;
+
+    /**
+     * Tells that the branch @p index was collapsed in the view, so its
+     * children can be discarded.
+     */
+    void collapse(const QModelIndex &index);
+    /**
+     * Tells that the branch @p index was expanded in the view.
+     */
+    void expand(const QModelIndex &index);
+
+    /**
+     * Discards all entries. The top level items are searched again when a
+     * view asks for them.
+     */
+    void clear();
+
+    [[nodiscard]] QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    [[nodiscard]] QModelIndex parent(const QModelIndex &index) const override;
+    [[nodiscard]] int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    [[nodiscard]] int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    [[nodiscard]] bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    [[nodiscard]] QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    [[nodiscard]] bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+Q_SIGNALS:
+    /**
+     * Emitted when searching the children of @p parent failed.
+     */
+    void fetchFailed(const QModelIndex &parent, int error, const QString &errorString);
+
+private:
+    class LdapModelPrivate;
+    std::unique_ptr<LdapModelPrivate> const d;
+    Q_DISABLE_COPY(LdapModel)
+};
+}
@@ -6,27 +6,222 @@
 */
 
 #include "ldapobject.h"
-#include "ldif.h"
+#include "ldapobject_p.h"
+#include "ldifwriter.h"
 
-#include <QSharedData>
+#include <QMutexLocker>
+
+#include <algorithm>
 
 using namespace KLDAPCore;
 
-class LdapObjectPrivate : public QSharedData
+LdapObjectPrivate::LdapObjectPrivate(const LdapObjectPrivate &other)
+    : QSharedData(other)
+    , mDn(other.mDn)
+    , mAttributes(other.mAttributes)
+    , mValues(other.mValues)
+    , mArena(other.mArena)
+    , mGarbage(other.mGarbage)
+{
+}
+
+LdapObject LdapObjectPrivate::fromEntry(const LdapDN &dn, const QByteArray &arena, QList<Attribute> &attrs, const QList<Span> &values)
+{
+    auto d = new LdapObjectPrivate;
+    d->mDn = dn;
+    d->mArena = arena;
+    d->mValues = values;
+    std::stable_sort(attrs.begin(), attrs.end(), [](const Attribute &lhs, const Attribute &rhs) {
+        return lhs.name < rhs.name;
+    });
+    d->mAttributes = attrs;
+    return LdapObject(d);
+}
+
+qsizetype LdapObjectPrivate::lowerBound(const LdapAttributeName &name) const
+{
+    const auto it = std::lower_bound(mAttributes.cbegin(), mAttributes.cend(), name, [](const Attribute &attr, const LdapAttributeName &name) {
+        return attr.name < name;
+    });
+    return it - mAttributes.cbegin();
+}
+
+const LdapObjectPrivate::Attribute *LdapObjectPrivate::find(const LdapAttributeName &name) const
+{
+    if (!name.isValid()) {
+        return nullptr;
+    }
+    const qsizetype index = lowerBound(name);
+    if (index < mAttributes.count() && mAttributes.at(index).name == name) {
+        return &mAttributes.at(index);
+    }
+    return nullptr;
+}
+
+QByteArray LdapObjectPrivate::valueAt(int index) const
+{
+    // the value outlives the object, so it is copied out of the arena unless it is all of it
+    const Span &span = mValues.at(index);
+    if (span.offset == 0 && span.size == mArena.size()) {
+        return mArena;
+    }
+    return mArena.mid(span.offset, span.size);
+}
+
+QByteArrayView LdapObjectPrivate::valueView(int index) const
+{
+    const Span &span = mValues.at(index);
+    return QByteArrayView(mArena.constData() + span.offset, span.size);
+}
+
+LdapAttrValue LdapObjectPrivate::valuesOf(const Attribute &attr) const
+{
+    LdapAttrValue values;
+    values.reserve(attr.valueCount);
+    for (int i = attr.firstValue; i < attr.firstValue + attr.valueCount; ++i) {
+        values.append(valueAt(i));
+    }
+    return values;
+}
+
+void LdapObjectPrivate::removeValues(Attribute &attr)
+{
+    if (attr.valueCount == 0) {
+        return;
+    }
+    for (int i = attr.firstValue; i < attr.firstValue + attr.valueCount; ++i) {
+        mGarbage += mValues.at(i).size;
+    }
+    mValues.remove(attr.firstValue, attr.valueCount);
+    for (Attribute &other : mAttributes) {
+        if (other.firstValue > attr.firstValue) {
+            other.firstValue -= attr.valueCount;
+        }
+    }
+    attr.firstValue = mValues.count();
+    attr.valueCount = 0;
+}
+
+int LdapObjectPrivate::appendValue(const QByteArray &value)
+{
+    const int offset = mArena.size();
+    mArena.append(value);
+    return offset;
+}
+
+void LdapObjectPrivate::setValues(const LdapAttributeName &name, const LdapAttrValue &values)
+{
+    const bool mapValid = mMapValid.loadRelaxed();
+    QString oldName;
+    const qsizetype index = lowerBound(name);
+    if (index == mAttributes.count() || mAttributes.at(index).name != name) {
+        mAttributes.insert(index, Attribute());
+    } else if (mapValid) {
+        oldName = mAttributes.at(index).name.name();
+    }
+    Attribute &attr = mAttributes[index];
+    attr.name = name;
+    removeValues(attr);
+
+    // the values go to the end, so they are consecutive
+    attr.firstValue = mValues.count();
+    attr.valueCount = values.count();
+    for (const QByteArray &value : values) {
+        mValues.append({appendValue(value), static_cast<int>(value.size())});
+    }
+    if (mGarbage > 4096 && mGarbage > mArena.size() / 2) {
+        compact();
+    }
+
+    // values may be in the map, so update it last
+    if (mapValid) {
+        mMap.insert(name.name(), values);
+        if (!oldName.isNull() && oldName != name.name()) {
+            // the spelling changed
+            mMap.remove(oldName);
+        }
+    }
+}
+
+void LdapObjectPrivate::addValue(const LdapAttributeName &name, const QByteArray &value)
+{
+    const qsizetype index = lowerBound(name);
+    if (index == mAttributes.count() || mAttributes.at(index).name != name) {
+        Attribute attr;
+        attr.name = name;
+        attr.firstValue = mValues.count();
+        mAttributes.insert(index, attr);
+    }
+    Attribute &attr = mAttributes[index];
+    const int position = attr.firstValue + attr.valueCount;
+    mValues.insert(position, {appendValue(value), static_cast<int>(value.size())});
+    for (Attribute &other : mAttributes) {
+        if (&other != &attr && other.firstValue >= position) {
+            ++other.firstValue;
+        }
+    }
+    ++attr.valueCount;
+
+    if (mMapValid.loadRelaxed()) {
+        mMap[attr.name.name()].append(value);
+    }
+}
+
+void LdapObjectPrivate::clearAttributes()
 {
-public:
-    LdapObjectPrivate() = default;
+    mMap.clear();
+    mAttributes.clear();
+    mValues.clear();
+    mArena.clear();
+    mGarbage = 0;
+}
 
-    LdapObjectPrivate(const LdapObjectPrivate &other)
-        : QSharedData(other)
-        , mDn(other.mDn)
-        , mAttrs(other.mAttrs)
-    {
+void LdapObjectPrivate::compact()
+{
+    QByteArray arena;
+    arena.reserve(mArena.size() - mGarbage);
+    for (Span &span : mValues) {
+        const int offset = arena.size();
+        arena.append(mArena.constData() + span.offset, span.size);
+        span.offset = offset;
     }
+    mArena = arena;
+    mGarbage = 0;
+}
 
-    LdapDN mDn;
-    LdapAttrMap mAttrs;
-};
+QList<QPair<QString, const LdapObjectPrivate::Attribute *>> LdapObjectPrivate::sortedByName() const
+{
+    QList<QPair<QString, const Attribute *>> attrs;
+    attrs.reserve(mAttributes.count());
+    for (const Attribute &attr : mAttributes) {
+        attrs.append({attr.name.name(), &attr});
+    }
+    std::sort(attrs.begin(), attrs.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.first < rhs.first;
+    });
+    return attrs;
+}
+
+const LdapAttrMap &LdapObjectPrivate::attributeMap() const
+{
+    if (mMapValid.loadAcquire()) {
+        return mMap;
+    }
+    // objects can be shared between threads, so build it only once
+    QMutexLocker locker(&mMutex);
+    if (!mMapValid.loadRelaxed()) {
+        for (const Attribute &attr : mAttributes) {
+            mMap.insert(attr.name.name(), valuesOf(attr));
+        }
+        mMapValid.storeRelease(1);
+    }
+    return mMap;
+}
+
+LdapObject::LdapObject(LdapObjectPrivate *dd)
+    : d(dd)
+{
+}
 
 LdapObject::LdapObject()
     : d(new LdapObjectPrivate)
@@ -66,7 +261,13 @@ void LdapObject::setDn(const QString &dn)
 
 void LdapObject::setAttributes(const LdapAttrMap &attrs)
 {
-    d->mAttrs = attrs;
+    // attrs may be the map of this object, which is cleared below
+    const LdapAttrMap copy = attrs;
+    d->clearAttributes();
+    LdapAttrMap::ConstIterator end(copy.constEnd());
+    for (LdapAttrMap::ConstIterator it = copy.constBegin(); it != end; ++it) {
+        d->setValues(LdapAttributeName(it.key()), it.value());
+    }
 }
 
 LdapDN LdapObject::dn() const
@@ -76,43 +277,66 @@ LdapDN LdapObject::dn() const
 
 const LdapAttrMap &LdapObject::attributes() const
 {
-    return d->mAttrs;
+    return d->attributeMap();
 }
 
 QString LdapObject::toString() const
 {
-    QString result = QStringLiteral("dn: %1\n").arg(d->mDn.toString());
-    LdapAttrMap::ConstIterator end(d->mAttrs.constEnd());
-    for (LdapAttrMap::ConstIterator it = d->mAttrs.constBegin(); it != end; ++it) {
-        const QString attr = it.key();
-        LdapAttrValue::ConstIterator end2((*it).constEnd());
-        for (LdapAttrValue::ConstIterator it2 = (*it).constBegin(); it2 != end2; ++it2) {
-            result += QString::fromUtf8(Ldif::assembleLine(attr, *it2, 76)) + QLatin1Char('\n');
-        }
-    }
-    return result;
+    LdifWriter writer;
+    writer.writeObject(*this);
+    QByteArray ldif = writer.data();
+    // without the empty line after the record
+    ldif.chop(1);
+    return QString::fromUtf8(ldif);
 }
 
 void LdapObject::clear()
 {
     d->mDn.clear();
-    d->mAttrs.clear();
+    d->clearAttributes();
 }
 
 void LdapObject::setValues(const QString &attributeName, const LdapAttrValue &values)
 {
-    d->mAttrs[attributeName] = values;
+    d->setValues(LdapAttributeName(attributeName), values);
+}
+
+void LdapObject::setValues(const LdapAttributeName &attributeName, const LdapAttrValue &values)
+{
+    d->setValues(attributeName, values);
 }
 
 void LdapObject::addValue(const QString &attributeName, const QByteArray &value)
 {
-    d->mAttrs[attributeName].append(value);
+    d->addValue(LdapAttributeName(attributeName), value);
+}
+
+void LdapObject::addValue(const LdapAttributeName &attributeName, const QByteArray &value)
+{
+    d->addValue(attributeName, value);
+}
+
+QList<LdapAttributeName> LdapObject::attributeNames() const
+{
+    QList<LdapAttributeName> names;
+    const auto attrs = d->sortedByName();
+    names.reserve(attrs.count());
+    for (const auto &attr : attrs) {
+        names.append(attr.second->name);
+    }
+    return names;
 }
 
 LdapAttrValue LdapObject::values(const QString &attributeName) const
 {
-    if (hasAttribute(attributeName)) {
-        return d->mAttrs.value(attributeName);
+    return values(LdapAttributeName::find(attributeName));
+}
+
+LdapAttrValue LdapObject::values(const LdapAttributeName &attributeName) const
+{
+    const LdapObjectPrivate::Attribute *attr = d->find(attributeName);
+    if (attr) {
+        return d->valuesOf(*attr);
     } else {
         return {};
     }
@@ -120,8 +344,14 @@ LdapAttrValue LdapObject::values(const QString &attributeName) const
 
 QByteArray LdapObject::value(const QString &attributeName) const
 {
-    if (hasAttribute(attributeName)) {
-        return d->mAttrs.value(attributeName).first();
+    return value(LdapAttributeName::find(attributeName));
+}
+
+QByteArray LdapObject::value(const LdapAttributeName &attributeName) const
+{
+    const LdapObjectPrivate::Attribute *attr = d->find(attributeName);
+    if (attr && attr->valueCount > 0) {
+        return d->valueAt(attr->firstValue);
     } else {
         return {};
     }
@@ -129,5 +359,10 @@ QByteArray LdapObject::value(const QString &attributeName) const
 
 bool LdapObject::hasAttribute(const QString &attributeName) const
 {
-    return d->mAttrs.contains(attributeName);
+    return hasAttribute(LdapAttributeName::find(attributeName));
+}
+
+bool LdapObject::hasAttribute(const LdapAttributeName &attributeName) const
+{
+    return d->find(attributeName) != nullptr;
 }
@@ -14,6 +14,7 @@
 class LdapObjectPrivate;
 
 #include "kldap_core_export.h"
+#include "ldapattributename.h"
 #include "ldapdn.h"
 
 // clazy:excludeall=copyable-polymorphic
@@ -65,6 +66,11 @@ public:
      * @param values the values of attribute to set
      */
     void setValues(const QString &attributeName, const LdapAttrValue &values);
+    /**
+     * Sets the given attribute values.
+     * This is the same as the above function, but takes an interned name.
+     */
+    void setValues(const LdapAttributeName &attributeName, const LdapAttrValue &values);
     /**
      * Adds the given value to the specified attribute. If the given attribute
      * not exists, then it's created.
@@ -72,29 +78,49 @@ public:
      * @param value the attribute  value to add
      */
     void addValue(const QString &attributeName, const QByteArray &value);
+    /**
+     * Adds the given value to the specified attribute.
+     * This is the same as the above function, but takes an interned name.
+     */
+    void addValue(const LdapAttributeName &attributeName, const QByteArray &value);
     /**
      * Return the Distinguished Name of the object.
      */
     [[nodiscard]] LdapDN dn() const;
     /**
-     * Returns the attributes and their values.
+     * Returns the attributes and their values. The map is built on first
+     * use, and then kept up to date when the attributes are changed.
      */
     const LdapAttrMap &attributes() const;
+    /**
+     * Returns the names of the attributes, in the same order as attributes().
+     * Unlike attributes(), this does not copy any value.
+     */
+    [[nodiscard]] QList<LdapAttributeName> attributeNames() const;
     /**
      * Returns all values of the attribute with the given name.
+     * Attribute names are compared case-insensitively.
+     * The values are stored in one buffer per object, so they are copied
+     * out of it. Use attributeNames() to look at the names only.
      */
     [[nodiscard]] LdapAttrValue values(const QString &attributeName) const;
+    [[nodiscard]] LdapAttrValue values(const LdapAttributeName &attributeName) const;
     /**
      * Returns the first value of the attribute with the given name
      * or an empty byte array if the attribute does not exists.
+     * Like values(), this copies the value.
      */
     [[nodiscard]] QByteArray value(const QString &attributeName) const;
+    [[nodiscard]] QByteArray value(const LdapAttributeName &attributeName) const;
     /**
      * Returns true if the given attributethe exists, false otherwise.
      */
     [[nodiscard]] bool hasAttribute(const QString &attributeName) const;
+    [[nodiscard]] bool hasAttribute(const LdapAttributeName &attributeName) const;
 
 private:
+    friend class ::LdapObjectPrivate;
+    explicit LdapObject(LdapObjectPrivate *dd);
     QSharedDataPointer<LdapObjectPrivate> d;
 };
 
@@ -0,0 +1,101 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "ldapattributename.h"
+#include "ldapobject.h"
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QSharedData>
+
+/**
+ * @internal
+ * The attributes are kept in a vector sorted by the key of their interned
+ * name. All values of an object live in one buffer, every attribute
+ * references a consecutive range of spans into it. The attribute map of
+ * LdapObject::attributes() is only built when it is asked for. After that
+ * it is updated along with the attributes, so that references to it stay
+ * valid and current.
+ *
+ * valueView() gives access to a value without copying it. valueAt(), and
+ * so LdapObject::value() and values(), return copies, because the arena
+ * moves when values are added or compacted.
+ */
+class LdapObjectPrivate : public QSharedData
+{
+public:
+    struct Span {
+        int offset = 0;
+        int size = 0;
+    };
+
+    struct Attribute {
+        /** The name as spelled by the server or the caller, sorted by its key. */
+        KLDAPCore::LdapAttributeName name;
+        int firstValue = 0;
+        int valueCount = 0;
+    };
+
+    LdapObjectPrivate() = default;
+    LdapObjectPrivate(const LdapObjectPrivate &other);
+
+    static const LdapObjectPrivate *get(const KLDAPCore::LdapObject &object)
+    {
+        return object.d.constData();
+    }
+
+    /**
+     * Returns an object with the given DN which owns @p arena.
+     * The values of each attribute must be consecutive in @p values.
+     */
+    static KLDAPCore::LdapObject fromEntry(const KLDAPCore::LdapDN &dn, const QByteArray &arena, QList<Attribute> &attrs, const QList<Span> &values);
+
+    /**
+     * Returns the index of the first attribute whose name is not less than @p name.
+     */
+    [[nodiscard]] qsizetype lowerBound(const KLDAPCore::LdapAttributeName &name) const;
+    [[nodiscard]] const Attribute *find(const KLDAPCore::LdapAttributeName &name) const;
+    [[nodiscard]] QByteArray valueAt(int index) const;
+    [[nodiscard]] QByteArrayView valueView(int index) const;
+    [[nodiscard]] KLDAPCore::LdapAttrValue valuesOf(const Attribute &attr) const;
+
+    void setValues(const KLDAPCore::LdapAttributeName &name, const KLDAPCore::LdapAttrValue &values);
+    void addValue(const KLDAPCore::LdapAttributeName &name, const QByteArray &value);
+    void clearAttributes();
+
+    /**
+     * Returns the attributes with their names, in the order of attributes().
+     */
+    [[nodiscard]] QList<QPair<QString, const Attribute *>> sortedByName() const;
+
+    /**
+     * Builds the compatibility map on first use.
+     */
+    const KLDAPCore::LdapAttrMap &attributeMap() const;
+
+    KLDAPCore::LdapDN mDn;
+    QList<Attribute> mAttributes;
+    QList<Span> mValues;
+    QByteArray mArena;
+    // bytes in mArena which are not referenced anymore
+    int mGarbage = 0;
+
+    mutable KLDAPCore::LdapAttrMap mMap;
+    mutable QAtomicInt mMapValid = 0;
+    mutable QMutex mMutex;
+
+private:
+    void removeValues(Attribute &attr);
+    int appendValue(const QByteArray &value);
+    void compact();
+};
@@ -7,6 +7,8 @@
 
 #include "ldapoperation.h"
 #include "kldap_config.h"
+#include "ldapobject_p.h"
+#include "ldappreparedsearch_p.h"
 
 #include "ldap_core_debug.h"
 
@@ -61,6 +63,9 @@ public:
     ~LdapOperationPrivate();
 #if LDAP_FOUND
     int processResult(int rescode, LDAPMessage *msg);
+#if !HAVE_WINLDAP_H
+    bool decodeEntry(LDAP *ld, LDAPMessage *msg);
+#endif
     int bind(const QByteArray &creds, SASL_Callback_Proc *saslproc, void *data, bool async);
 #endif
     LdapControls mClientCtrls, mServerCtrls, mControls;
@@ -69,6 +74,7 @@ public:
     QByteArray mServerCred;
     QString mMatchedDn;
     QList<QByteArray> mReferrals;
+    int mMsgId = 0;
 
     LdapConnection *mConnection = nullptr;
 };
@@ -152,6 +158,11 @@ QByteArray LdapOperation::serverCred() const
     return d->mServerCred;
 }
 
+int LdapOperation::messageId() const
+{
+    return d->mMsgId;
+}
+
 LdapOperation::LdapOperationPrivate::LdapOperationPrivate() = default;
 
 LdapOperation::LdapOperationPrivate::~LdapOperationPrivate() = default;
@@ -345,6 +356,72 @@ int LdapOperation::LdapOperationPrivate::bind(const QByteArray &creds, SASL_Call
     return ret;
 }
 
+#if !HAVE_WINLDAP_H
+bool LdapOperation::LdapOperationPrivate::decodeEntry(LDAP *ld, LDAPMessage *msg)
+{
+    // Walk the BER of the entry directly. The values are not copied one by one,
+    // but appended to a single buffer which the object keeps, and the names are
+    // looked up in the table of known attribute names.
+    BerElement *ber = nullptr;
+    struct berval dn;
+    if (ldap_get_dn_ber(ld, msg, &ber, &dn) != LDAP_SUCCESS) {
+        return false;
+    }
+
+    // the values can't be longer than the encoding of the entry, so the buffer
+    // is allocated once
+    ber_len_t remaining = 0;
+    ber_get_option(ber, LBER_OPT_REMAINING_BYTES, &remaining);
+    QByteArray arena;
+    arena.reserve(remaining);
+    QList<LdapObjectPrivate::Attribute> attrs;
+    QList<LdapObjectPrivate::Span> values;
+
+    bool ok = true;
+    ber_len_t len;
+    // PartialAttribute ::= SEQUENCE { type AttributeDescription, vals SET OF value }
+    while (ber_peek_tag(ber, &len) != LBER_DEFAULT) {
+        struct berval name;
+        if (ber_skip_tag(ber, &len) == LBER_DEFAULT || ber_get_stringbv(ber, &name, LBER_BV_NOTERM) == LBER_DEFAULT) {
+            ok = false;
+            break;
+        }
+        LdapObjectPrivate::Attribute attr;
+        attr.name = LdapAttributeName::fromUtf8(name.bv_val, name.bv_len);
+        attr.firstValue = values.size();
+
+        char *last;
+        for (ber_tag_t tag = ber_first_element(ber, &len, &last); tag != LBER_DEFAULT; tag = ber_next_element(ber, &len, last)) {
+            struct berval value;
+            if (ber_get_stringbv(ber, &value, LBER_BV_NOTERM) == LBER_DEFAULT) {
+                ok = false;
+                break;
+            }
+            LdapObjectPrivate::Span span;
+            span.offset = arena.size();
+            span.size = value.bv_len;
+            arena.append(value.bv_val, value.bv_len);
+            values.append(span);
+        }
+        if (!ok) {
+            break;
+        }
+        attr.valueCount = values.size() - attr.firstValue;
+        attrs.append(attr);
+    }
+
+    if (ok) {
+        // don't keep the space of the names and tags around
+        arena.squeeze();
+        mObject = LdapObjectPrivate::fromEntry(LdapDN(QString::fromUtf8(dn.bv_val, dn.bv_len)), arena, attrs, values);
+    } else {
+        qCWarning(LDAP_LOG) << "cannot decode search entry";
+    }
+    ber_free(ber, 0);
+    return ok;
+}
+#endif
+
 int LdapOperation::LdapOperationPrivate::processResult(int rescode, LDAPMessage *msg)
 {
     // qCDebug(LDAP_LOG);
@@ -355,6 +432,20 @@ int LdapOperation::LdapOperationPrivate::processResult(int rescode, LDAPMessage
     switch (rescode) {
     case RES_SEARCH_ENTRY: {
         // qCDebug(LDAP_LOG) << "Found search entry";
+#if !HAVE_WINLDAP_H
+        if (!decodeEntry(ld, msg)) {
+            ldap_msgfree(msg);
+            return -1;
+        }
+        // entries carry controls only if a request control asked for them,
+        // like the sync state control of content synchronization
+        mControls.clear();
+        LDAPControl **entryctrls = nullptr;
+        if (ldap_get_entry_controls(ld, msg, &entryctrls) == KLDAP_SUCCESS && entryctrls) {
+            extractControls(mControls, entryctrls);
+            ldap_controls_free(entryctrls);
+        }
+#else
         mObject.clear();
         LdapAttrMap attrs;
         char *name;
@@ -388,6 +479,7 @@ int LdapOperation::LdapOperationPrivate::processResult(int rescode, LDAPMessage
         }
         ber_free(entry, 0);
         mObject.setAttributes(attrs);
+#endif
         break;
     }
     case RES_SEARCH_REFERENCE:
@@ -408,6 +500,29 @@ int LdapOperation::LdapOperationPrivate::processResult(int rescode, LDAPMessage
         ber_bvfree(retdata);
         break;
     }
+#if !HAVE_WINLDAP_H
+    case RES_EXTENDED_PARTIAL: {
+        // an intermediate response, which has no result code
+        char *retoid = nullptr;
+        struct berval *retdata = nullptr;
+        LDAPControl **serverctrls = nullptr;
+        retval = ldap_parse_intermediate(ld, msg, &retoid, &retdata, &serverctrls, 0);
+        if (retval != KLDAP_SUCCESS) {
+            ldap_msgfree(msg);
+            return -1;
+        }
+        mExtOid = retoid ? QByteArray(retoid) : QByteArray();
+        mExtData = retdata ? QByteArray(retdata->bv_val, retdata->bv_len) : QByteArray();
+        ldap_memfree(retoid);
+        ber_bvfree(retdata);
+        mControls.clear();
+        if (serverctrls) {
+            extractControls(mControls, serverctrls);
+            ldap_controls_free(serverctrls);
+        }
+        break;
+    }
+#endif
     case RES_BIND: {
         struct berval *servercred = nullptr;
 #if !HAVE_WINLDAP_H
@@ -683,6 +798,33 @@ int LdapOperation::search(const LdapDN &base, LdapUrl::Scope scope, const QStrin
     return retval;
 }
 
+int LdapOperation::search(const LdapPreparedSearch &search)
+{
+    Q_ASSERT(d->mConnection);
+    LDAP *ld = (LDAP *)d->mConnection->handle();
+    LdapPreparedSearch::LdapPreparedSearchPrivate *prepared = search.d.get();
+
+    int msgid;
+    qCDebug(LDAP_LOG) << "asyncSearch() base=" << prepared->mNativeBase << "scope=" << (int)prepared->mScope << "filter=" << prepared->mNativeFilter
+                      << "attrs=" << prepared->mAttributes << "cookie=" << prepared->mCookie.toHex();
+    int retval = ldap_search_ext(ld,
+                                 prepared->mNativeBase.data(),
+                                 prepared->mNativeScope,
+                                 prepared->mNativeFilter.data(),
+                                 prepared->mNativeAttrs.empty() ? nullptr : prepared->mNativeAttrs.data(),
+                                 0,
+                                 prepared->mNativeServerCtrls.data(),
+                                 prepared->mNativeClientCtrls.data(),
+                                 nullptr,
+                                 d->mConnection->sizeLimit(),
+                                 &msgid);
+
+    if (retval == 0) {
+        retval = msgid;
+    }
+    return retval;
+}
+
 int LdapOperation::add(const LdapObject &object)
 {
     Q_ASSERT(d->mConnection);
@@ -1135,6 +1277,7 @@ int LdapOperation::waitForResult(int id, int msecs)
     stopWatch.start();
     int attempt(1);
     int timeout(0);
+    d->mMsgId = 0;
 
     do {
         // Calculate the timeout value to use and assign it to a timeval structure
@@ -1153,6 +1296,11 @@ int LdapOperation::waitForResult(int id, int msecs)
         // Act on the return code
         if (rescode != 0) {
             // Some kind of result is available for processing
+#if !HAVE_WINLDAP_H
+            d->mMsgId = ldap_msgid(msg);
+#else
+            d->mMsgId = msg->lm_msgid;
+#endif
             return d->processResult(rescode, msg);
         }
     } while (msecs == -1 || stopWatch.elapsed() < msecs);
@@ -1180,6 +1328,12 @@ int LdapOperation::search(const LdapDN &base, LdapUrl::Scope scope, const QStrin
     return -1;
 }
 
+int LdapOperation::search(const LdapPreparedSearch &search)
+{
+    qCritical() << "LDAP support not compiled";
+    return -1;
+}
+
 int LdapOperation::add(const LdapObject &object)
 {
     qCritical() << "LDAP support not compiled";
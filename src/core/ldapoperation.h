@@ -12,6 +12,7 @@
 #include "ldapcontrol.h"
 #include "ldapdn.h"
 #include "ldapobject.h"
+#include "ldappreparedsearch.h"
 #include "ldapserver.h"
 #include "ldapurl.h"
 
@@ -122,6 +123,12 @@ public:
      * result attributes. Returns a message id if successful, -1 if not.
      */
     [[nodiscard]] int search(const LdapDN &base, LdapUrl::Scope scope, const QString &filter, const QStringList &attrs);
+    /**
+     * Starts the prepared search @p search. Its own controls are sent instead
+     * of the controls of this operation.
+     * Returns a message id if successful, -1 if not.
+     */
+    [[nodiscard]] int search(const LdapPreparedSearch &search);
     /**
      * Starts an addition operation.
      * Returns a message id if successful, -1 if not.
@@ -226,25 +233,34 @@ public:
      * Return code -1 means that fetching the message resulted in error,
      * not the LDAP operation error. Call connection().ldapErrorCode() to
      * determine if the operation succeeded.
+     *
+     * If \p id is -1, waits for the result of any outstanding request, and
+     * messageId() tells which one it belongs to.
      */
     [[nodiscard]] int waitForResult(int id, int msecs = -1);
+    /**
+     * Returns the message id of the message grabbed by the last
+     * waitForResult() call, or 0 if no message was received.
+     */
+    [[nodiscard]] int messageId() const;
     /**
      * Returns the result object if result() returned RES_SEARCH_ENTRY.
      */
     [[nodiscard]] LdapObject object() const;
     /**
      * Returns the server controls from the returned ldap message (grabbed
-     * by result()).
+     * by result()). Search entries and intermediate responses
+     * (RES_EXTENDED_PARTIAL) can have controls, too.
      */
     [[nodiscard]] LdapControls controls() const;
     /**
      * Returns the OID of the extended operation response (result
-     * returned RES_EXTENDED).
+     * returned RES_EXTENDED or RES_EXTENDED_PARTIAL).
      */
     [[nodiscard]] QByteArray extendedOid() const;
     /**
      * Returns the data from the extended operation response (result
-     * returned RES_EXTENDED).
+     * returned RES_EXTENDED or RES_EXTENDED_PARTIAL).
      */
     [[nodiscard]] QByteArray extendedData() const;
     /**
@@ -0,0 +1,239 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldappreparedsearch.h"
+#include "ldappreparedsearch_p.h"
+
+using namespace KLDAPCore;
+
+#define LDAP_CONTROL_PAGEDRESULTS_OID "1.2.840.113556.1.4.319"
+
+#if LDAP_FOUND
+void LdapNativeControls::assign(const LdapControls &ctrls)
+{
+    mOids.clear();
+    mValues.clear();
+    mCtrls.clear();
+    mPtrs.clear();
+    if (ctrls.isEmpty()) {
+        return;
+    }
+
+    mOids.reserve(ctrls.count());
+    mValues.reserve(ctrls.count());
+    mCtrls.resize(ctrls.count());
+    for (int i = 0; i < ctrls.count(); ++i) {
+        const LdapControl &ctrl = ctrls.at(i);
+        mOids.append(ctrl.oid().toUtf8());
+        mValues.append(ctrl.value());
+        mCtrls[i].ldctl_oid = mOids[i].data();
+        mCtrls[i].ldctl_iscritical = ctrl.critical();
+        setValue(i, mValues.at(i));
+    }
+    // the control structs don't move anymore, point to them
+    mPtrs.reserve(mCtrls.size() + 1);
+    for (LDAPControl &ctrl : mCtrls) {
+        mPtrs.push_back(&ctrl);
+    }
+    mPtrs.push_back(nullptr);
+}
+
+void LdapNativeControls::setValue(int index, const QByteArray &value)
+{
+    mValues[index] = value;
+    LDAPControl &ctrl = mCtrls[index];
+    ctrl.ldctl_value.bv_len = mValues.at(index).size();
+    ctrl.ldctl_value.bv_val = mValues.at(index).isEmpty() ? nullptr : mValues[index].data();
+}
+
+int LdapNativeControls::count() const
+{
+    return mCtrls.size();
+}
+
+LDAPControl **LdapNativeControls::data()
+{
+    return mPtrs.empty() ? nullptr : mPtrs.data();
+}
+#endif // LDAP_FOUND
+
+void LdapPreparedSearch::LdapPreparedSearchPrivate::updateAttributes()
+{
+    mNativeAttrNames.clear();
+#if LDAP_FOUND
+    mNativeAttrs.clear();
+#endif
+    if (mAttributes.isEmpty()) {
+        return;
+    }
+
+    mNativeAttrNames.reserve(mAttributes.count());
+    for (const QString &attr : std::as_const(mAttributes)) {
+        mNativeAttrNames.append(attr.toUtf8());
+    }
+#if LDAP_FOUND
+    mNativeAttrs.reserve(mNativeAttrNames.count() + 1);
+    for (QByteArray &name : mNativeAttrNames) {
+        mNativeAttrs.push_back(name.data());
+    }
+    mNativeAttrs.push_back(nullptr);
+#endif
+}
+
+void LdapPreparedSearch::LdapPreparedSearchPrivate::updateServerControls()
+{
+#if LDAP_FOUND
+    if (mPageSize <= 0) {
+        mNativeServerCtrls.assign(mServerCtrls);
+        return;
+    }
+    // the page control always comes last, so its value can be replaced
+    LdapControls ctrls;
+    ctrls.reserve(mServerCtrls.count() + 1);
+    for (const LdapControl &ctrl : std::as_const(mServerCtrls)) {
+        if (ctrl.oid() != QLatin1String(LDAP_CONTROL_PAGEDRESULTS_OID)) {
+            ctrls.append(ctrl);
+        }
+    }
+    ctrls.append(LdapControl::createPageControl(mPageSize, mCookie));
+    mNativeServerCtrls.assign(ctrls);
+#endif
+}
+
+LdapPreparedSearch::LdapPreparedSearch()
+    : d(new LdapPreparedSearchPrivate)
+{
+    d->mNativeFilter = QByteArrayLiteral("objectClass=*");
+}
+
+LdapPreparedSearch::LdapPreparedSearch(const LdapDN &base, LdapUrl::Scope scope, const QString &filter, const QStringList &attributes)
+    : d(new LdapPreparedSearchPrivate)
+{
+    setBase(base);
+    setScope(scope);
+    d->mNativeFilter = QByteArrayLiteral("objectClass=*");
+    setFilter(filter);
+    setAttributes(attributes);
+}
+
+LdapPreparedSearch::~LdapPreparedSearch() = default;
+
+void LdapPreparedSearch::setBase(const LdapDN &base)
+{
+    d->mBase = base;
+    d->mNativeBase = base.toString().toUtf8();
+}
+
+LdapDN LdapPreparedSearch::base() const
+{
+    return d->mBase;
+}
+
+void LdapPreparedSearch::setScope(LdapUrl::Scope scope)
+{
+    d->mScope = scope;
+#if LDAP_FOUND
+    switch (scope) {
+    case LdapUrl::Base:
+        d->mNativeScope = LDAP_SCOPE_BASE;
+        break;
+    case LdapUrl::One:
+        d->mNativeScope = LDAP_SCOPE_ONELEVEL;
+        break;
+    case LdapUrl::Sub:
+        d->mNativeScope = LDAP_SCOPE_SUBTREE;
+        break;
+    }
+#endif
+}
+
+LdapUrl::Scope LdapPreparedSearch::scope() const
+{
+    return d->mScope;
+}
+
+void LdapPreparedSearch::setFilter(const QString &filter)
+{
+    if (filter == d->mFilter) {
+        return;
+    }
+    d->mFilter = filter;
+    d->mNativeFilter = filter.isEmpty() ? QByteArrayLiteral("objectClass=*") : filter.toUtf8();
+}
+
+QString LdapPreparedSearch::filter() const
+{
+    return d->mFilter;
+}
+
+void LdapPreparedSearch::setAttributes(const QStringList &attributes)
+{
+    if (attributes == d->mAttributes) {
+        return;
+    }
+    d->mAttributes = attributes;
+    d->updateAttributes();
+}
+
+QStringList LdapPreparedSearch::attributes() const
+{
+    return d->mAttributes;
+}
+
+void LdapPreparedSearch::setServerControls(const LdapControls &ctrls)
+{
+    d->mServerCtrls = ctrls;
+    d->updateServerControls();
+}
+
+LdapControls LdapPreparedSearch::serverControls() const
+{
+    return d->mServerCtrls;
+}
+
+void LdapPreparedSearch::setClientControls(const LdapControls &ctrls)
+{
+    d->mClientCtrls = ctrls;
+#if LDAP_FOUND
+    d->mNativeClientCtrls.assign(ctrls);
+#endif
+}
+
+LdapControls LdapPreparedSearch::clientControls() const
+{
+    return d->mClientCtrls;
+}
+
+void LdapPreparedSearch::setPageControl(int pageSize, const QByteArray &cookie)
+{
+    pageSize = qMax(0, pageSize);
+    const bool resize = (pageSize > 0) != (d->mPageSize > 0);
+    if (pageSize == d->mPageSize && cookie == d->mCookie) {
+        return;
+    }
+    d->mPageSize = pageSize;
+    d->mCookie = cookie;
+#if LDAP_FOUND
+    if (resize) {
+        d->updateServerControls();
+    } else if (pageSize > 0) {
+        d->mNativeServerCtrls.setValue(d->mNativeServerCtrls.count() - 1, LdapControl::createPageControl(pageSize, cookie).value());
+    }
+#else
+    Q_UNUSED(resize)
+#endif
+}
+
+int LdapPreparedSearch::pageSize() const
+{
+    return d->mPageSize;
+}
+
+QByteArray LdapPreparedSearch::pageCookie() const
+{
+    return d->mCookie;
+}
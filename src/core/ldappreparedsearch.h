@@ -0,0 +1,121 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapcontrol.h"
+#include "ldapdn.h"
+#include "ldapurl.h"
+
+namespace KLDAPCore
+{
+class LdapOperation;
+
+/**
+ * @brief
+ * This class holds the parameters of a search operation in the form the
+ * LDAP client library expects them.
+ *
+ * The base DN, filter, attribute list and controls are converted once when
+ * they are set, so executing the same search repeatedly with
+ * LdapOperation::search() does not allocate them again. This is useful
+ * for paged searches, where only the page cookie changes between the
+ * requests, and for searches which only differ in their filter.
+ */
+class KLDAP_CORE_EXPORT LdapPreparedSearch
+{
+public:
+    LdapPreparedSearch();
+    LdapPreparedSearch(const LdapDN &base, LdapUrl::Scope scope, const QString &filter, const QStringList &attributes = QStringList());
+    ~LdapPreparedSearch();
+
+    /**
+     * Sets the base DN of the search.
+     */
+    void setBase(const LdapDN &base);
+    /**
+     * Returns the base DN of the search.
+     */
+    [[nodiscard]] LdapDN base() const;
+
+    /**
+     * Sets the scope of the search.
+     */
+    void setScope(LdapUrl::Scope scope);
+    /**
+     * Returns the scope of the search.
+     */
+    [[nodiscard]] LdapUrl::Scope scope() const;
+
+    /**
+     * Sets the filter of the search. An empty filter matches every object.
+     */
+    void setFilter(const QString &filter);
+    /**
+     * Returns the filter of the search.
+     */
+    [[nodiscard]] QString filter() const;
+
+    /**
+     * Sets the attributes to return. An empty list returns all user attributes.
+     */
+    void setAttributes(const QStringList &attributes);
+    /**
+     * Returns the attributes to return.
+     */
+    [[nodiscard]] QStringList attributes() const;
+
+    /**
+     * Sets the server controls which are sent with the search. The controls
+     * of the LdapOperation executing the search are not used.
+     */
+    void setServerControls(const LdapControls &ctrls);
+    /**
+     * Returns the server controls which are sent with the search.
+     */
+    [[nodiscard]] LdapControls serverControls() const;
+
+    /**
+     * Sets the client controls which are used for the search.
+     */
+    void setClientControls(const LdapControls &ctrls);
+    /**
+     * Returns the client controls which are used for the search.
+     */
+    [[nodiscard]] LdapControls clientControls() const;
+
+    /**
+     * Requests pages of @p pageSize entries, continuing after @p cookie, which
+     * is returned by the server with the last page. A page size of 0 disables
+     * paging. If only the cookie changes, just the value of the control is
+     * replaced.
+     */
+    void setPageControl(int pageSize, const QByteArray &cookie = QByteArray());
+    /**
+     * Returns the page size of the search, or 0 if paging is disabled.
+     */
+    [[nodiscard]] int pageSize() const;
+    /**
+     * Returns the page cookie which will be sent with the search.
+     */
+    [[nodiscard]] QByteArray pageCookie() const;
+
+private:
+    friend class LdapOperation;
+    class LdapPreparedSearchPrivate;
+    std::unique_ptr<LdapPreparedSearchPrivate> const d;
+
+    Q_DISABLE_COPY(LdapPreparedSearch)
+};
+}
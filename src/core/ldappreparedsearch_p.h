@@ -0,0 +1,75 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kldap_config.h"
+#include "ldappreparedsearch.h"
+
+#include <QList>
+
+#include <vector>
+
+#if LDAP_FOUND
+#if !HAVE_WINLDAP_H
+#include <lber.h>
+#include <ldap.h>
+#else
+#include <w32-ldap-help.h>
+#endif // HAVE_WINLDAP_H
+#endif // LDAP_FOUND
+
+namespace KLDAPCore
+{
+#if LDAP_FOUND
+/**
+ * A null terminated LDAPControl array which owns its data.
+ * @internal
+ */
+class LdapNativeControls
+{
+public:
+    void assign(const LdapControls &ctrls);
+    void setValue(int index, const QByteArray &value);
+    [[nodiscard]] int count() const;
+    [[nodiscard]] LDAPControl **data();
+
+private:
+    QList<QByteArray> mOids;
+    QList<QByteArray> mValues;
+    std::vector<LDAPControl> mCtrls;
+    std::vector<LDAPControl *> mPtrs;
+};
+#endif // LDAP_FOUND
+
+class Q_DECL_HIDDEN LdapPreparedSearch::LdapPreparedSearchPrivate
+{
+public:
+    void updateAttributes();
+    void updateServerControls();
+
+    LdapDN mBase;
+    LdapUrl::Scope mScope = LdapUrl::Sub;
+    QString mFilter;
+    QStringList mAttributes;
+    LdapControls mServerCtrls;
+    LdapControls mClientCtrls;
+    int mPageSize = 0;
+    QByteArray mCookie;
+
+    // the same in the form of the client library
+    QByteArray mNativeBase;
+    QByteArray mNativeFilter;
+    QList<QByteArray> mNativeAttrNames;
+#if LDAP_FOUND
+    int mNativeScope = LDAP_SCOPE_SUBTREE;
+    std::vector<char *> mNativeAttrs;
+    LdapNativeControls mNativeServerCtrls;
+    LdapNativeControls mNativeClientCtrls;
+#endif
+};
+}
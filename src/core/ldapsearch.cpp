@@ -6,9 +6,13 @@
 */
 
 #include "ldapsearch.h"
+#include "ldapconnectionpool.h"
 #include "ldapdefs.h"
 #include "ldapdn.h"
 
+#include <QHash>
+#include <QPointer>
+#include <QSocketNotifier>
 #include <QTimer>
 
 #include "ldap_core_debug.h"
@@ -27,29 +31,113 @@ public:
     }
 
     void result();
+    bool readyRead();
+    void fetch();
+    bool processResult(int res);
+    void startNotifier();
+    void stopNotifier();
     bool connect();
+    bool acquire(const LdapServer &server);
     void closeConnection();
-    bool startSearch(const LdapDN &base, LdapUrl::Scope scope, const QString &filter, const QStringList &attributes, int pagesize, int count);
+    int sendSearch(const QByteArray &cookie = QByteArray());
+    bool startSearch(const LdapDN &base,
+                     LdapUrl::Scope scope,
+                     const QString &filter,
+                     const QStringList &attributes,
+                     int pagesize,
+                     int count,
+                     const LdapControls &windowCtrls = LdapControls());
+    void parseWindowControls();
 
     LdapSearch *const mParent;
     LdapConnection *mConn = nullptr;
     LdapOperation mOp;
+    // registered with the notifier of the connection, see startNotifier()
+    bool mWatched = false;
+    // waiting for results, the notifier is enabled while any search waits
+    bool mWaiting = false;
     bool mOwnConnection = false;
+    bool mUsePool = false;
+    bool mPooled = false;
+    bool mBound = false;
     bool mAbandoned = false;
-    int mId;
+    int mId = 0;
     int mPageSize;
-    LdapDN mBase;
-    QString mFilter;
-    QStringList mAttributes;
-    LdapUrl::Scope mScope;
+    // converted once, only the page cookie changes between the requests
+    LdapPreparedSearch mSearch;
 
     QString mErrorString;
     int mError;
     int mCount;
     int mMaxCount;
     bool mFinished = false;
+
+    // the state of a window search, returned by the virtual list view control
+    bool mWindow = false;
+    int mTargetPosition = 0;
+    int mContentCount = 0;
+    QByteArray mContextId;
 };
 
+namespace
+{
+/**
+ * The searches reading from one connection. They share one socket notifier:
+ * reading the messages of a search also queues the messages of the others
+ * in libldap, and the socket would not become readable again for them.
+ */
+struct LdapSearchWatcher {
+    QSocketNotifier *notifier = nullptr;
+    QList<LdapSearchPrivate *> searches;
+};
+}
+
+static QHash<LdapConnection *, LdapSearchWatcher> &searchWatchers()
+{
+    // a socket notifier only works in its own thread
+    static thread_local QHash<LdapConnection *, LdapSearchWatcher> watchers;
+    return watchers;
+}
+
+static void updateSearchNotifier(const LdapSearchWatcher &watcher)
+{
+    bool waiting = false;
+    for (const LdapSearchPrivate *search : watcher.searches) {
+        waiting = waiting || search->mWaiting;
+    }
+    watcher.notifier->setEnabled(waiting);
+}
+
+static void dispatchSearches(LdapConnection *conn)
+{
+    // Every search takes its messages from the queue of libldap and reads the
+    // socket if there are none, queuing the messages of the others. Go round
+    // until no search finds anything.
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        const auto it = searchWatchers().constFind(conn);
+        if (it == searchWatchers().cend()) {
+            return;
+        }
+        const QList<LdapSearchPrivate *> searches = it->searches;
+        for (LdapSearchPrivate *search : searches) {
+            // the signals of a search may stop or delete the others
+            const auto current = searchWatchers().constFind(conn);
+            if (current == searchWatchers().cend()) {
+                return;
+            }
+            if (current->searches.contains(search) && search->mWaiting && search->readyRead()) {
+                progress = true;
+            }
+        }
+    }
+    const auto it = searchWatchers().constFind(conn);
+    if (it != searchWatchers().cend()) {
+        updateSearchNotifier(*it);
+    }
+}
+
 void LdapSearchPrivate::result()
 {
     if (mAbandoned) {
@@ -57,7 +145,100 @@ void LdapSearchPrivate::result()
         return;
     }
     const int res = mOp.waitForResult(mId, LDAPSEARCH_BLOCKING_TIMEOUT);
+    if (processResult(res)) {
+        QTimer::singleShot(0, mParent, [this]() {
+            result();
+        });
+    }
+}
 
+bool LdapSearchPrivate::readyRead()
+{
+    // The notifier only tells that the socket is readable, but libldap can
+    // have more complete messages in its buffers already, so read until it
+    // would block. Returns whether a message was read.
+    bool progress = false;
+    while (!mAbandoned) {
+        const int res = mOp.waitForResult(mId, 0);
+        if (res == 0) {
+            return progress;
+        }
+        progress = true;
+        const QPointer<LdapSearch> guard(mParent);
+        if (!processResult(res)) {
+            // finished, failed or reached the requested count
+            if (guard) {
+                mWaiting = false;
+            }
+            return true;
+        }
+    }
+    mOp.abandon(mId);
+    mWaiting = false;
+    return progress;
+}
+
+void LdapSearchPrivate::fetch()
+{
+    if (mWatched) {
+        mWaiting = true;
+        dispatchSearches(mConn);
+    } else {
+        result();
+    }
+}
+
+void LdapSearchPrivate::startNotifier()
+{
+    stopNotifier();
+    const int fd = mConn->socketDescriptor();
+    if (fd < 0) {
+        qCDebug(LDAP_LOG) << "no socket descriptor available, polling for results";
+        return;
+    }
+    LdapSearchWatcher &watcher = searchWatchers()[mConn];
+    if (watcher.notifier && watcher.notifier->socket() != fd) {
+        // the connection was opened again
+        watcher.notifier->setEnabled(false);
+        watcher.notifier->deleteLater();
+        watcher.notifier = nullptr;
+    }
+    if (!watcher.notifier) {
+        LdapConnection *conn = mConn;
+        watcher.notifier = new QSocketNotifier(fd, QSocketNotifier::Read);
+        watcher.notifier->setEnabled(false);
+        QObject::connect(watcher.notifier, &QSocketNotifier::activated, watcher.notifier, [conn]() {
+            dispatchSearches(conn);
+        });
+    }
+    watcher.searches.append(this);
+    mWatched = true;
+}
+
+void LdapSearchPrivate::stopNotifier()
+{
+    if (!mWatched) {
+        return;
+    }
+    mWatched = false;
+    mWaiting = false;
+    const auto it = searchWatchers().find(mConn);
+    if (it == searchWatchers().end()) {
+        return;
+    }
+    it->searches.removeOne(this);
+    if (it->searches.isEmpty()) {
+        it->notifier->setEnabled(false);
+        // we might be called from one of its signals
+        it->notifier->deleteLater();
+        searchWatchers().erase(it);
+    } else {
+        updateSearchNotifier(*it);
+    }
+}
+
+bool LdapSearchPrivate::processResult(int res)
+{
     qCDebug(LDAP_LOG) << "LDAP result:" << res;
 
     if (res != 0 && (res == -1 || (mConn->ldapErrorCode() != KLDAP_SUCCESS && mConn->ldapErrorCode() != KLDAP_SASL_BIND_IN_PROGRESS))) {
@@ -65,7 +246,7 @@ void LdapSearchPrivate::result()
         mError = mConn->ldapErrorCode();
         mErrorString = mConn->ldapErrorString();
         Q_EMIT mParent->result(mParent);
-        return;
+        return false;
     }
 
     // binding
@@ -75,15 +256,11 @@ void LdapSearchPrivate::result()
         qCDebug(LDAP_LOG) << "LdapSearch RES_BIND";
         if (mConn->ldapErrorCode() == KLDAP_SUCCESS) { // bind succeeded
             qCDebug(LDAP_LOG) << "bind succeeded";
-            LdapControls savedctrls = mOp.serverControls();
-            if (mPageSize) {
-                LdapControls ctrls = savedctrls;
-                LdapControl::insert(ctrls, LdapControl::createPageControl(mPageSize));
-                mOp.setServerControls(ctrls);
+            mBound = true;
+            if (mPooled) {
+                LdapConnectionPool::self()->markBound(mConn);
             }
-
-            mId = mOp.search(mBase, mScope, mFilter, mAttributes);
-            mOp.setServerControls(savedctrls);
+            mId = sendSearch();
         } else { // next bind step
             qCDebug(LDAP_LOG) << "bind next step";
             mId = mOp.bind(servercc);
@@ -97,16 +274,16 @@ void LdapSearchPrivate::result()
                 mErrorString = mConn->ldapErrorString();
             }
             Q_EMIT mParent->result(mParent);
-            return;
+            return false;
         }
-        QTimer::singleShot(0, mParent, [this]() {
-            result();
-        });
-        return;
+        return true;
     }
 
     // End of entries
     if (res == LdapOperation::RES_SEARCH_RESULT) {
+        if (mWindow) {
+            parseWindowControls();
+        }
         if (mPageSize) {
             QByteArray cookie;
             int estsize = -1;
@@ -119,30 +296,24 @@ void LdapSearchPrivate::result()
             }
             qCDebug(LDAP_LOG) << " estimated size:" << estsize;
             if (estsize != -1 && !cookie.isEmpty()) {
-                LdapControls ctrls;
-                LdapControls savedctrls;
-                savedctrls = mOp.serverControls();
-                ctrls = savedctrls;
-                LdapControl::insert(ctrls, LdapControl::createPageControl(mPageSize, cookie));
-                mOp.setServerControls(ctrls);
-                mId = mOp.search(mBase, mScope, mFilter, mAttributes);
-                mOp.setServerControls(savedctrls);
+                mId = sendSearch(cookie);
                 if (mId == -1) {
                     mError = mConn->ldapErrorCode();
                     mErrorString = mConn->ldapErrorString();
                     Q_EMIT mParent->result(mParent);
-                    return;
+                    return false;
                 }
                 // continue with the next page
-                QTimer::singleShot(0, mParent, [this]() {
-                    result();
-                });
-                return;
+                return true;
             }
         }
         mFinished = true;
+        if (mPooled) {
+            // nothing more to read, let others use the connection
+            closeConnection();
+        }
         Q_EMIT mParent->result(mParent);
-        return;
+        return false;
     }
 
     // Found an entry
@@ -151,17 +322,31 @@ void LdapSearchPrivate::result()
         mCount++;
     }
 
-    // If not reached the requested entries, continue
-    if (mMaxCount <= 0 || mCount < mMaxCount) {
-        QTimer::singleShot(0, mParent, [this]() {
-            result();
-        });
-    }
     // If reached the requested entries, indicate it
     if (mMaxCount > 0 && mCount == mMaxCount) {
         qCDebug(LDAP_LOG) << mCount << " entries reached";
         Q_EMIT mParent->result(mParent);
+        return false;
+    }
+    // If not reached the requested entries, continue
+    return mMaxCount <= 0 || mCount < mMaxCount;
+}
+
+void LdapSearchPrivate::parseWindowControls()
+{
+    const LdapControls ctrls = mOp.controls();
+    for (const LdapControl &ctrl : ctrls) {
+        QString attribute;
+        const int sortResult = ctrl.parseSortControl(attribute);
+        if (sortResult > 0) {
+            qCDebug(LDAP_LOG) << "sorting failed:" << sortResult << attribute;
+        }
+        const int vlvResult = ctrl.parseVlvControl(mTargetPosition, mContentCount, mContextId);
+        if (vlvResult > 0) {
+            qCDebug(LDAP_LOG) << "virtual list view failed:" << vlvResult;
+        }
     }
+    qCDebug(LDAP_LOG) << "window target position:" << mTargetPosition << "content count:" << mContentCount;
 }
 
 bool LdapSearchPrivate::connect()
@@ -176,16 +361,52 @@ bool LdapSearchPrivate::connect()
     return true;
 }
 
+bool LdapSearchPrivate::acquire(const LdapServer &server)
+{
+    // an idle connection is bound already, a new one is connected and bound
+    // like an own connection, without blocking for the bind
+    mConn = LdapConnectionPool::self()->acquireNonBlocking(server, mBound, mError, mErrorString);
+    mPooled = mConn != nullptr;
+    if (mPooled && !mBound) {
+        return connect();
+    }
+    return mPooled;
+}
+
 void LdapSearchPrivate::closeConnection()
 {
+    stopNotifier();
     if (mOwnConnection && mConn) {
-        delete mConn;
+        if (mPooled) {
+            if (!mFinished && mError == 0 && mId > 0) {
+                // don't leave responses for others on the connection
+                mOp.abandon(mId);
+            }
+            // the pool closes connections which were not bound
+            LdapConnectionPool::self()->release(mConn, !LdapConnectionPool::isConnectionError(mError));
+            mPooled = false;
+        } else {
+            delete mConn;
+        }
         mConn = nullptr;
     }
+    mBound = false;
+}
+
+int LdapSearchPrivate::sendSearch(const QByteArray &cookie)
+{
+    mSearch.setPageControl(mPageSize, cookie);
+    return mOp.search(mSearch);
 }
 
 // This starts the real job
-bool LdapSearchPrivate::startSearch(const LdapDN &base, LdapUrl::Scope scope, const QString &filter, const QStringList &attributes, int pagesize, int count)
+bool LdapSearchPrivate::startSearch(const LdapDN &base,
+                                    LdapUrl::Scope scope,
+                                    const QString &filter,
+                                    const QStringList &attributes,
+                                    int pagesize,
+                                    int count,
+                                    const LdapControls &windowCtrls)
 {
     qCDebug(LDAP_LOG) << "search: base=" << base.toString() << "scope=" << static_cast<int>(scope) << "filter=" << filter << "attributes=" << attributes
                       << "pagesize=" << pagesize;
@@ -194,23 +415,30 @@ bool LdapSearchPrivate::startSearch(const LdapDN &base, LdapUrl::Scope scope, co
     mErrorString.clear();
     mOp.setConnection(*mConn);
     mPageSize = pagesize;
-    mBase = base;
-    mScope = scope;
-    mFilter = filter;
-    mAttributes = attributes;
+    mSearch.setBase(base);
+    mSearch.setScope(scope);
+    mSearch.setFilter(filter);
+    mSearch.setAttributes(attributes);
+    LdapControls serverCtrls = mOp.serverControls();
+    for (const LdapControl &ctrl : windowCtrls) {
+        LdapControl::insert(serverCtrls, ctrl);
+    }
+    mSearch.setServerControls(serverCtrls);
+    mSearch.setClientControls(mOp.clientControls());
     mMaxCount = count;
     mCount = 0;
     mFinished = false;
+    mWindow = !windowCtrls.isEmpty();
+    mTargetPosition = 0;
+    mContentCount = 0;
+    mContextId.clear();
 
-    LdapControls savedctrls = mOp.serverControls();
     if (pagesize) {
-        LdapControls ctrls = savedctrls;
         mConn->setOption(0x0008, nullptr); // Disable referals or paging won't work
-        LdapControl::insert(ctrls, LdapControl::createPageControl(pagesize));
-        mOp.setServerControls(ctrls);
     }
 
-    mId = mOp.bind();
+    // idle connections from the pool are bound already
+    mId = mBound ? sendSearch() : mOp.bind();
     if (mId < 0) {
         if (mId == KLDAP_SASL_ERROR) {
             mError = mId;
@@ -226,9 +454,11 @@ bool LdapSearchPrivate::startSearch(const LdapDN &base, LdapUrl::Scope scope, co
     }
     qCDebug(LDAP_LOG) << "startSearch msg id=" << mId;
 
-    // maybe do this with threads?- need thread-safe client libs!!!
+    // The socket exists now that the first request was sent, so wait for it to become
+    // readable instead of polling. Fall back to polling if there is no descriptor.
+    startNotifier();
     QTimer::singleShot(0, mParent, [this]() {
-        result();
+        fetch();
     });
 
     return true;
@@ -272,13 +502,29 @@ void LdapSearch::setServerControls(const LdapControls &ctrls)
     d->mOp.setServerControls(ctrls);
 }
 
+void LdapSearch::setUseConnectionPool(bool enable)
+{
+    d->mUsePool = enable;
+}
+
+bool LdapSearch::useConnectionPool() const
+{
+    return d->mUsePool;
+}
+
 bool LdapSearch::search(const LdapServer &server, const QStringList &attributes, int count)
 {
     if (d->mOwnConnection) {
         d->closeConnection();
-        d->mConn = new LdapConnection(server);
-        if (!d->connect()) {
-            return false;
+        if (d->mUsePool) {
+            if (!d->acquire(server)) {
+                return false;
+            }
+        } else {
+            d->mConn = new LdapConnection(server);
+            if (!d->connect()) {
+                return false;
+            }
         }
     }
     return d->startSearch(server.baseDn(), server.scope(), server.filter(), attributes, server.pageSize(), count);
@@ -288,9 +534,15 @@ bool LdapSearch::search(const LdapUrl &url, int count)
 {
     if (d->mOwnConnection) {
         d->closeConnection();
-        d->mConn = new LdapConnection(url);
-        if (!d->connect()) {
-            return false;
+        if (d->mUsePool) {
+            if (!d->acquire(LdapServer(url))) {
+                return false;
+            }
+        } else {
+            d->mConn = new LdapConnection(url);
+            if (!d->connect()) {
+                return false;
+            }
         }
     }
     bool critical = true;
@@ -304,12 +556,60 @@ bool LdapSearch::search(const LdapDN &base, LdapUrl::Scope scope, const QString
     return d->startSearch(base, scope, filter, attributes, pagesize, count);
 }
 
+bool LdapSearch::searchWindow(const LdapDN &base,
+                              LdapUrl::Scope scope,
+                              const QString &filter,
+                              const QStringList &attributes,
+                              const LdapControl::SortKeys &sortKeys,
+                              int offset,
+                              int count,
+                              const QByteArray &contextId)
+{
+    Q_ASSERT(!d->mOwnConnection);
+    Q_ASSERT(count > 0);
+    // the target is the first entry of the window, and the server counts from 1
+    const LdapControls ctrls = {LdapControl::createSortControl(sortKeys, true),
+                                LdapControl::createVlvControl(0, qMax(0, count - 1), qMax(0, offset) + 1, 0, contextId)};
+    return d->startSearch(base, scope, filter, attributes, 0, 0, ctrls);
+}
+
+bool LdapSearch::searchWindow(const LdapDN &base,
+                              LdapUrl::Scope scope,
+                              const QString &filter,
+                              const QStringList &attributes,
+                              const LdapControl::SortKeys &sortKeys,
+                              const QString &target,
+                              int before,
+                              int after,
+                              const QByteArray &contextId)
+{
+    Q_ASSERT(!d->mOwnConnection);
+    const LdapControls ctrls = {LdapControl::createSortControl(sortKeys, true),
+                                LdapControl::createVlvControl(qMax(0, before), qMax(0, after), target.toUtf8(), contextId)};
+    return d->startSearch(base, scope, filter, attributes, 0, 0, ctrls);
+}
+
+int LdapSearch::windowTargetPosition() const
+{
+    return d->mTargetPosition;
+}
+
+int LdapSearch::windowContentCount() const
+{
+    return d->mContentCount;
+}
+
+QByteArray LdapSearch::windowContextId() const
+{
+    return d->mContextId;
+}
+
 void LdapSearch::continueSearch()
 {
     Q_ASSERT(!d->mFinished);
     d->mCount = 0;
     QTimer::singleShot(0, this, [this]() {
-        d->result();
+        d->fetch();
     });
 }
 
@@ -321,6 +621,12 @@ bool LdapSearch::isFinished()
 void LdapSearch::abandon()
 {
     d->mAbandoned = true;
+    if (d->mWatched && !d->mFinished) {
+        // no more data might arrive to wake us up, so send the abandon request now
+        QTimer::singleShot(0, this, [this]() {
+            d->fetch();
+        });
+    }
 }
 
 int LdapSearch::error() const
@@ -28,6 +28,13 @@ namespace KLDAPCore
  * @brief
  * This class starts a search operation on a LDAP server and returns the
  * search values via a Qt signal.
+ *
+ * The results are read when the socket of the connection becomes readable,
+ * so an idle search does not use any CPU. If the client library does not
+ * expose the socket, the results are polled from the event loop instead.
+ * Searches which share a connection set with setConnection() share one
+ * socket notifier, and every message is handed to the search with its
+ * message id.
  */
 class KLDAP_CORE_EXPORT LdapSearch : public QObject
 {
@@ -66,6 +73,19 @@ public:
      */
     void setServerControls(const LdapControls &ctrls);
 
+    /**
+     * If @p enable is true, searches on an LdapServer or LdapUrl take an
+     * already bound connection from LdapConnectionPool::self() instead of
+     * opening a new one, and give it back when the search is finished.
+     * Has no effect if a connection was set explicitly.
+     */
+    void setUseConnectionPool(bool enable);
+
+    /**
+     * Returns true if searches use the connection pool.
+     */
+    [[nodiscard]] bool useConnectionPool() const;
+
     /**
      * Starts a search operation on the LDAP server @param server,
      * returning the attributes specified with @param attributes.
@@ -91,6 +111,63 @@ public:
                               int pagesize = 0,
                               int count = 0);
 
+    /**
+     * Starts a search for a window of a sorted result list, if the
+     * LdapConnection object already set in the constructor. The server sorts
+     * the entries by @p sortKeys and only returns the @p count entries starting
+     * at the position @p offset, counted from 0, using the server side sort
+     * and virtual list view controls. The server must support both controls,
+     * otherwise the search fails.
+     *
+     * @p contextId is the value of windowContextId() of the previous window of
+     * the same list, if any, which lets the server reuse its sorted list.
+     * When the search finished, windowTargetPosition() and
+     * windowContentCount() tell where the window is in the list.
+     */
+    [[nodiscard]] bool searchWindow(const LdapDN &base,
+                                    LdapUrl::Scope scope,
+                                    const QString &filter,
+                                    const QStringList &attributes,
+                                    const LdapControl::SortKeys &sortKeys,
+                                    int offset,
+                                    int count,
+                                    const QByteArray &contextId = QByteArray());
+
+    /**
+     * Starts a search for a window of a sorted result list like above, which
+     * contains the first entry whose first sort key is greater than or equal
+     * to @p target, and @p before entries before and @p after entries after it.
+     */
+    [[nodiscard]] bool searchWindow(const LdapDN &base,
+                                    LdapUrl::Scope scope,
+                                    const QString &filter,
+                                    const QStringList &attributes,
+                                    const LdapControl::SortKeys &sortKeys,
+                                    const QString &target,
+                                    int before,
+                                    int after,
+                                    const QByteArray &contextId = QByteArray());
+
+    /**
+     * Returns the position of the target entry of the last window search in the
+     * sorted list, counted from 1, or 0 if the server did not tell it.
+     * The first entry of a window around a target is at the position
+     * max(1, windowTargetPosition() - before).
+     */
+    [[nodiscard]] int windowTargetPosition() const;
+
+    /**
+     * Returns the server's estimate of the number of entries in the sorted list
+     * of the last window search, or 0 if the server did not tell it.
+     */
+    [[nodiscard]] int windowContentCount() const;
+
+    /**
+     * Returns the context ID which the server returned with the last window
+     * search, to pass to the next window search of the same list.
+     */
+    [[nodiscard]] QByteArray windowContextId() const;
+
     /**
      * Continues the search (if you set count to non-zero in search(), and isFinished() is false)
      */
@@ -0,0 +1,511 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapsyncclient.h"
+#include "bercodec.h"
+#include "ldapcontrol.h"
+#include "ldapdefs.h"
+#include "ldapdispatcher.h"
+#include "ldappreparedsearch.h"
+
+#include "ldap_core_debug.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+
+#include <utility>
+
+using namespace KLDAPCore;
+
+#define KLDAP_SYNC_INFO_OID "1.3.6.1.4.1.4203.1.9.1.4"
+// the result code telling that the replica must be loaded again
+#define KLDAP_SYNC_REFRESH_REQUIRED 0x1000
+
+// the header of the state file, and its version
+#define LDAPSYNC_STATE_MAGIC 0x4b4c5359
+#define LDAPSYNC_STATE_VERSION 1
+
+class Q_DECL_HIDDEN LdapSyncClient::LdapSyncClientPrivate
+{
+public:
+    LdapSyncClientPrivate(LdapSyncClient *qq, LdapConnection &connection)
+        : q(qq)
+        , mConn(connection)
+        , mDispatcher(connection)
+    {
+    }
+
+    bool send();
+    void received(const LdapDispatcher::Response &response);
+    void parseSyncInfo(const QByteArray &data);
+    void changeEntry(const QByteArray &uuid, const LdapObject &object);
+    void removeEntry(const QByteArray &uuid);
+    void removeNotPresent();
+    void refreshDone();
+    void fail(int error, const QString &errorString);
+
+    LdapSyncClient *const q;
+    LdapConnection &mConn;
+    LdapDispatcher mDispatcher;
+    LdapPreparedSearch mSearch;
+
+    LdapDN mBase;
+    LdapUrl::Scope mScope = LdapUrl::Sub;
+    QString mFilter;
+    QStringList mAttributes;
+    QString mStateFile;
+
+    // the replica, keyed by the binary entryUUID
+    QHash<QByteArray, LdapObject> mEntries;
+    // the entries which the server reported as present during the present phase
+    QSet<QByteArray> mPresent;
+    QByteArray mCookie;
+    Mode mMode = RefreshOnly;
+    int mId = 0;
+    bool mRefreshed = false;
+    int mError = 0;
+    QString mErrorString;
+};
+
+bool LdapSyncClient::LdapSyncClientPrivate::send()
+{
+    mPresent.clear();
+    mRefreshed = false;
+    mError = 0;
+    mErrorString.clear();
+
+    mSearch.setBase(mBase);
+    mSearch.setScope(mScope);
+    mSearch.setFilter(mFilter);
+    mSearch.setAttributes(mAttributes);
+    const LdapControl::SyncMode mode = mMode == RefreshAndPersist ? LdapControl::SyncRefreshAndPersist : LdapControl::SyncRefreshOnly;
+    mSearch.setServerControls({LdapControl::createSyncRequestControl(mode, mCookie)});
+
+    mId = mDispatcher.search(mSearch, [this](const LdapDispatcher::Response &response) {
+        received(response);
+    });
+    if (mId < 0) {
+        mId = 0;
+        mError = mConn.ldapErrorCode();
+        mErrorString = mConn.ldapErrorString();
+        return false;
+    }
+    qCDebug(LDAP_LOG) << "sync started, msg id" << mId << "with cookie" << mCookie;
+    return true;
+}
+
+void LdapSyncClient::LdapSyncClientPrivate::received(const LdapDispatcher::Response &response)
+{
+    if (response.type == LdapOperation::RES_SEARCH_ENTRY) {
+        for (const LdapControl &ctrl : response.controls) {
+            QByteArray uuid;
+            const int state = ctrl.parseSyncStateControl(uuid, mCookie);
+            switch (state) {
+            case -1:
+                continue;
+            case LdapControl::SyncPresent:
+                mPresent.insert(uuid);
+                break;
+            case LdapControl::SyncAdd:
+            case LdapControl::SyncModify:
+                if (!mRefreshed) {
+                    mPresent.insert(uuid);
+                }
+                changeEntry(uuid, response.object);
+                break;
+            case LdapControl::SyncDelete:
+                removeEntry(uuid);
+                break;
+            default:
+                qCDebug(LDAP_LOG) << "unknown sync state" << state;
+                break;
+            }
+            return;
+        }
+        qCDebug(LDAP_LOG) << "entry without sync state:" << response.object.dn().toString();
+        return;
+    }
+
+    if (response.type == LdapOperation::RES_EXTENDED_PARTIAL) {
+        if (response.extendedOid == KLDAP_SYNC_INFO_OID) {
+            parseSyncInfo(response.extendedData);
+        }
+        return;
+    }
+
+    mId = 0;
+    if (response.type == -1) {
+        fail(response.error, response.errorString);
+        return;
+    }
+    if (response.error == KLDAP_SYNC_REFRESH_REQUIRED) {
+        // the server cannot continue after the cookie, start over
+        qCDebug(LDAP_LOG) << "sync refresh required, loading the replica again";
+        q->clear();
+        if (!send()) {
+            Q_EMIT q->result(q);
+        }
+        return;
+    }
+    if (response.error != KLDAP_SUCCESS) {
+        fail(response.error, response.errorString);
+        return;
+    }
+
+    for (const LdapControl &ctrl : response.controls) {
+        const int refreshDeletes = ctrl.parseSyncDoneControl(mCookie);
+        if (refreshDeletes == 0) {
+            removeNotPresent();
+        }
+        if (refreshDeletes != -1) {
+            break;
+        }
+    }
+    if (!mRefreshed) {
+        refreshDone();
+    }
+    Q_EMIT q->result(q);
+}
+
+void LdapSyncClient::LdapSyncClientPrivate::parseSyncInfo(const QByteArray &data)
+{
+    // syncInfoValue ::= CHOICE {
+    //     newcookie      [0] syncCookie,
+    //     refreshDelete  [1] SEQUENCE {
+    //         cookie         syncCookie OPTIONAL,
+    //         refreshDone    BOOLEAN DEFAULT TRUE },
+    //     refreshPresent [2] SEQUENCE {
+    //         cookie         syncCookie OPTIONAL,
+    //         refreshDone    BOOLEAN DEFAULT TRUE },
+    //     syncIdSet      [3] SEQUENCE {
+    //         cookie         syncCookie OPTIONAL,
+    //         refreshDeletes BOOLEAN DEFAULT FALSE,
+    //         syncUUIDs      SET OF syncUUID } }
+    BerReader ber(data);
+    QByteArray cookie;
+    const int tag = ber.peekTag();
+    switch (tag) {
+    case 0x80:
+        if (ber.readOctetString(cookie, 0x80)) {
+            mCookie = cookie;
+        }
+        break;
+    case 0xa1:
+    case 0xa2: {
+        bool done = true;
+        if (!ber.enterSequence(tag)) {
+            break;
+        }
+        ber.readOctetString(cookie);
+        ber.readBoolean(done);
+        if (!ber.leaveSequence()) {
+            break;
+        }
+        if (!cookie.isEmpty()) {
+            mCookie = cookie;
+        }
+        if (tag == 0xa2) {
+            // the end of the present phase, the entries which were not
+            // reported are gone
+            removeNotPresent();
+        }
+        if (done && !mRefreshed) {
+            refreshDone();
+        }
+        break;
+    }
+    case 0xa3: {
+        bool refreshDeletes = false;
+        QList<QByteArray> uuids;
+        if (!ber.enterSequence(tag)) {
+            break;
+        }
+        ber.readOctetString(cookie);
+        ber.readBoolean(refreshDeletes);
+        if (!ber.enterSet()) {
+            break;
+        }
+        QByteArray uuid;
+        while (!ber.atEnd() && ber.readOctetString(uuid)) {
+            uuids.append(uuid);
+        }
+        if (!ber.leaveSet() || !ber.leaveSequence()) {
+            break;
+        }
+        if (!cookie.isEmpty()) {
+            mCookie = cookie;
+        }
+        for (const QByteArray &id : std::as_const(uuids)) {
+            if (refreshDeletes) {
+                removeEntry(id);
+            } else {
+                mPresent.insert(id);
+            }
+        }
+        break;
+    }
+    default:
+        qCDebug(LDAP_LOG) << "unknown sync info message" << tag;
+        return;
+    }
+    if (ber.hasError()) {
+        qCDebug(LDAP_LOG) << "malformed sync info message";
+    }
+}
+
+void LdapSyncClient::LdapSyncClientPrivate::changeEntry(const QByteArray &uuid, const LdapObject &object)
+{
+    mEntries.insert(uuid, object);
+    Q_EMIT q->entryChanged(object);
+}
+
+void LdapSyncClient::LdapSyncClientPrivate::removeEntry(const QByteArray &uuid)
+{
+    const auto it = mEntries.constFind(uuid);
+    if (it == mEntries.cend()) {
+        return;
+    }
+    const LdapObject object = it.value();
+    mEntries.erase(it);
+    Q_EMIT q->entryRemoved(object);
+}
+
+void LdapSyncClient::LdapSyncClientPrivate::removeNotPresent()
+{
+    QList<QByteArray> gone;
+    for (auto it = mEntries.cbegin(), end = mEntries.cend(); it != end; ++it) {
+        if (!mPresent.contains(it.key())) {
+            gone.append(it.key());
+        }
+    }
+    mPresent.clear();
+    for (const QByteArray &uuid : std::as_const(gone)) {
+        removeEntry(uuid);
+    }
+}
+
+void LdapSyncClient::LdapSyncClientPrivate::refreshDone()
+{
+    mRefreshed = true;
+    mPresent.clear();
+    qCDebug(LDAP_LOG) << "replica refreshed," << mEntries.count() << "entries";
+    if (!mStateFile.isEmpty()) {
+        q->save();
+    }
+    Q_EMIT q->refreshed();
+}
+
+void LdapSyncClient::LdapSyncClientPrivate::fail(int error, const QString &errorString)
+{
+    qCDebug(LDAP_LOG) << "sync failed:" << error << errorString;
+    mError = error;
+    mErrorString = errorString;
+    Q_EMIT q->result(q);
+}
+
+LdapSyncClient::LdapSyncClient(LdapConnection &connection, QObject *parent)
+    : QObject(parent)
+    , d(new LdapSyncClientPrivate(this, connection))
+{
+}
+
+LdapSyncClient::~LdapSyncClient()
+{
+    stop();
+}
+
+void LdapSyncClient::setBaseDn(const LdapDN &dn)
+{
+    d->mBase = dn;
+}
+
+LdapDN LdapSyncClient::baseDn() const
+{
+    return d->mBase;
+}
+
+void LdapSyncClient::setScope(LdapUrl::Scope scope)
+{
+    d->mScope = scope;
+}
+
+LdapUrl::Scope LdapSyncClient::scope() const
+{
+    return d->mScope;
+}
+
+void LdapSyncClient::setFilter(const QString &filter)
+{
+    d->mFilter = filter;
+}
+
+QString LdapSyncClient::filter() const
+{
+    return d->mFilter;
+}
+
+void LdapSyncClient::setAttributes(const QStringList &attributes)
+{
+    d->mAttributes = attributes;
+}
+
+QStringList LdapSyncClient::attributes() const
+{
+    return d->mAttributes;
+}
+
+void LdapSyncClient::setStateFile(const QString &fileName)
+{
+    d->mStateFile = fileName;
+}
+
+QString LdapSyncClient::stateFile() const
+{
+    return d->mStateFile;
+}
+
+bool LdapSyncClient::load()
+{
+    clear();
+    QFile file(d->mStateFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic;
+    quint32 version;
+    QString base;
+    qint32 scope;
+    QString filter;
+    QStringList attributes;
+    stream >> magic >> version;
+    if (magic != LDAPSYNC_STATE_MAGIC || version != LDAPSYNC_STATE_VERSION) {
+        qCDebug(LDAP_LOG) << d->mStateFile << "is not a sync state file";
+        return false;
+    }
+    stream >> base >> scope >> filter >> attributes;
+    if (base != d->mBase.toString() || scope != d->mScope || filter != d->mFilter || attributes != d->mAttributes) {
+        qCDebug(LDAP_LOG) << d->mStateFile << "belongs to another replica";
+        return false;
+    }
+
+    QByteArray cookie;
+    qint32 count;
+    stream >> cookie >> count;
+    QHash<QByteArray, LdapObject> entries;
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QByteArray uuid;
+        QString dn;
+        LdapAttrMap attrs;
+        stream >> uuid >> dn >> attrs;
+        LdapObject object(dn);
+        object.setAttributes(attrs);
+        entries.insert(uuid, object);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCDebug(LDAP_LOG) << d->mStateFile << "is truncated";
+        return false;
+    }
+    d->mEntries = std::move(entries);
+    d->mCookie = cookie;
+    return true;
+}
+
+bool LdapSyncClient::save() const
+{
+    // replace the file only when it is written completely
+    QSaveFile file(d->mStateFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(LDAP_LOG) << "cannot write" << d->mStateFile << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << quint32(LDAPSYNC_STATE_MAGIC) << quint32(LDAPSYNC_STATE_VERSION);
+    stream << d->mBase.toString() << qint32(d->mScope) << d->mFilter << d->mAttributes;
+    stream << d->mCookie << qint32(d->mEntries.count());
+    for (auto it = d->mEntries.cbegin(), end = d->mEntries.cend(); it != end; ++it) {
+        stream << it.key() << it.value().dn().toString() << it.value().attributes();
+    }
+    return file.commit();
+}
+
+void LdapSyncClient::clear()
+{
+    d->mEntries.clear();
+    d->mPresent.clear();
+    d->mCookie.clear();
+    d->mRefreshed = false;
+}
+
+bool LdapSyncClient::start(Mode mode)
+{
+    if (d->mId) {
+        return false;
+    }
+    d->mMode = mode;
+    return d->send();
+}
+
+void LdapSyncClient::stop()
+{
+    if (!d->mId) {
+        return;
+    }
+    d->mDispatcher.abandon(d->mId);
+    d->mId = 0;
+    if (d->mRefreshed && !d->mStateFile.isEmpty()) {
+        save();
+    }
+}
+
+bool LdapSyncClient::isRunning() const
+{
+    return d->mId != 0;
+}
+
+bool LdapSyncClient::isRefreshed() const
+{
+    return d->mRefreshed;
+}
+
+QByteArray LdapSyncClient::cookie() const
+{
+    return d->mCookie;
+}
+
+int LdapSyncClient::count() const
+{
+    return int(d->mEntries.count());
+}
+
+LdapObject LdapSyncClient::entry(const QByteArray &entryUuid) const
+{
+    return d->mEntries.value(entryUuid);
+}
+
+QList<LdapObject> LdapSyncClient::entries() const
+{
+    return d->mEntries.values();
+}
+
+int LdapSyncClient::error() const
+{
+    return d->mError;
+}
+
+QString LdapSyncClient::errorString() const
+{
+    return d->mErrorString;
+}
+
+#include "moc_ldapsyncclient.cpp"
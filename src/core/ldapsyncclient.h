@@ -0,0 +1,179 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapconnection.h"
+#include "ldapdn.h"
+#include "ldapobject.h"
+#include "ldapurl.h"
+
+// clazy:excludeall=ctor-missing-parent-argument
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class keeps a local replica of a subtree of an LDAP directory using
+ * content synchronization (RFC 4533, also known as syncrepl).
+ *
+ * The replica holds the entries matching the filter below the base DN,
+ * with the configured attributes, keyed by their entryUUID. The first
+ * synchronization loads all of them, later ones continue after the sync
+ * cookie and only transfer the changes. If a state file is set, the
+ * replica and the cookie are written to it whenever the replica is up to
+ * date with the server, and load() reads them back, so a restarted
+ * application only pulls the changes since it last ran.
+ *
+ * In RefreshOnly mode the synchronization ends when the replica is up to
+ * date. In RefreshAndPersist mode the server keeps sending the changes
+ * until stop() is called.
+ *
+ * The connection must be connected and bound, and must outlive the client.
+ */
+class KLDAP_CORE_EXPORT LdapSyncClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        RefreshOnly, ///< Synchronize once.
+        RefreshAndPersist, ///< Synchronize, then keep receiving the changes.
+    };
+
+    explicit LdapSyncClient(LdapConnection &connection, QObject *parent = nullptr);
+    ~LdapSyncClient() override;
+
+    /**
+     * Sets the base DN of the replicated subtree.
+     */
+    void setBaseDn(const LdapDN &dn);
+    [[nodiscard]] LdapDN baseDn() const;
+
+    /**
+     * Sets the scope of the replicated subtree. The default is LdapUrl::Sub.
+     */
+    void setScope(LdapUrl::Scope scope);
+    [[nodiscard]] LdapUrl::Scope scope() const;
+
+    /**
+     * Sets the filter of the replicated entries. An empty filter matches every entry.
+     */
+    void setFilter(const QString &filter);
+    [[nodiscard]] QString filter() const;
+
+    /**
+     * Sets the replicated attributes. An empty list replicates all user attributes.
+     */
+    void setAttributes(const QStringList &attributes);
+    [[nodiscard]] QStringList attributes() const;
+
+    /**
+     * Sets the file which keeps the replica and the sync cookie between runs.
+     */
+    void setStateFile(const QString &fileName);
+    [[nodiscard]] QString stateFile() const;
+
+    /**
+     * Reads the replica and the sync cookie from the state file. Returns
+     * false if the file cannot be read, or was written for another base DN,
+     * scope, filter or attribute list, in which case the replica is empty.
+     */
+    bool load();
+    /**
+     * Writes the replica and the sync cookie to the state file.
+     * Returns false if writing failed.
+     */
+    bool save() const;
+    /**
+     * Discards the replica and the sync cookie, so the next synchronization
+     * loads all entries again.
+     */
+    void clear();
+
+    /**
+     * Starts a synchronization. Returns false if it could not be sent,
+     * error() and errorString() tell why.
+     */
+    bool start(Mode mode = RefreshOnly);
+    /**
+     * Stops the synchronization, and writes the state file if the replica
+     * is up to date.
+     */
+    void stop();
+    /**
+     * Returns true while a synchronization is running.
+     */
+    [[nodiscard]] bool isRunning() const;
+    /**
+     * Returns true if the replica was brought up to date by the current or
+     * last synchronization.
+     */
+    [[nodiscard]] bool isRefreshed() const;
+
+    /**
+     * Returns the sync cookie, which tells the server the state of the replica.
+     */
+    [[nodiscard]] QByteArray cookie() const;
+
+    /**
+     * Returns the number of entries in the replica.
+     */
+    [[nodiscard]] int count() const;
+    /**
+     * Returns the entry with the entryUUID @p entryUuid, given in its
+     * 16 byte binary form, or an empty object if there is none.
+     */
+    [[nodiscard]] LdapObject entry(const QByteArray &entryUuid) const;
+    /**
+     * Returns the entries of the replica, in no particular order.
+     */
+    [[nodiscard]] QList<LdapObject> entries() const;
+
+    /**
+     * Returns the error code of the last synchronization (0 if no error).
+     */
+    [[nodiscard]] int error() const;
+    /**
+     * Returns the error description of the last synchronization.
+     */
+    [[nodiscard]] QString errorString() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when an entry was added to the replica or changed.
+     */
+    void entryChanged(const KLDAPCore::LdapObject &object);
+    /**
+     * Emitted when an entry was removed from the replica.
+     */
+    void entryRemoved(const KLDAPCore::LdapObject &object);
+    /**
+     * Emitted when the replica is up to date with the server.
+     */
+    void refreshed();
+    /**
+     * Emitted when the synchronization ended, because the replica is up to
+     * date in RefreshOnly mode, or because of an error.
+     */
+    void result(KLDAPCore::LdapSyncClient *client);
+
+private:
+    class LdapSyncClientPrivate;
+    std::unique_ptr<LdapSyncClientPrivate> const d;
+    Q_DISABLE_COPY(LdapSyncClient)
+};
+}
@@ -6,27 +6,84 @@
 */
 
 #include "ldif.h"
+#include "ldifwriter.h"
 
 #include "ldap_core_debug.h"
 
+#include <cstring>
+
 using namespace KLDAPCore;
 
+namespace
+{
+// the directives of the LDIF format, compared as interned names
+struct LdifNames {
+    const LdapAttributeName version{QStringLiteral("version")};
+    const LdapAttributeName dn{QStringLiteral("dn")};
+    const LdapAttributeName changetype{QStringLiteral("changetype")};
+    const LdapAttributeName control{QStringLiteral("control")};
+    const LdapAttributeName add{QStringLiteral("add")};
+    const LdapAttributeName replace{QStringLiteral("replace")};
+    const LdapAttributeName del{QStringLiteral("delete")};
+    const LdapAttributeName newrdn{QStringLiteral("newrdn")};
+    const LdapAttributeName newsuperior{QStringLiteral("newsuperior")};
+    const LdapAttributeName deleteoldrdn{QStringLiteral("deleteoldrdn")};
+};
+
+Q_GLOBAL_STATIC(LdifNames, s_names)
+}
+
 class Q_DECL_HIDDEN Ldif::LdifPrivate
 {
 public:
     int mModType;
     bool mDelOldRdn, mUrl;
     LdapDN mDn;
-    QString mAttr, mNewRdn, mNewSuperior, mOid;
+    LdapAttributeName mAttr;
+    QString mNewRdn, mNewSuperior, mOid;
     QByteArray mLdif, mValue;
     EntryType mEntryType;
 
     bool mIsNewLine, mIsComment, mCritical;
+    // the last line ended with CR, so a following LF belongs to it
+    bool mLastEolCr;
     ParseValue mLastParseValue;
     uint mPos, mLineNumber;
+    // the logical line; while it is not folded it points into mLdif
     QByteArray mLine;
+    bool mLineIsView;
+
+    void appendLine(const char *data, qsizetype size);
+    void detachLine();
 };
 
+void Ldif::LdifPrivate::appendLine(const char *data, qsizetype size)
+{
+    if (mLine.isEmpty()) {
+        mLine = QByteArray::fromRawData(data, size);
+        mLineIsView = true;
+        return;
+    }
+    detachLine();
+    mLine.append(data, size);
+}
+
+void Ldif::LdifPrivate::detachLine()
+{
+    if (mLineIsView) {
+        mLine = QByteArray(mLine.constData(), mLine.size());
+        mLineIsView = false;
+    }
+}
+
+// Returns the first CR or LF in the range, or nullptr.
+static const char *kldap_find_line_end(const char *data, qsizetype size)
+{
+    const auto lf = static_cast<const char *>(std::memchr(data, '\n', size));
+    const auto cr = static_cast<const char *>(std::memchr(data, '\r', lf ? lf - data : size));
+    return cr ? cr : lf;
+}
+
 Ldif::Ldif()
     : d(new LdifPrivate)
 {
@@ -56,47 +113,12 @@ Ldif::~Ldif() = default;
 
 QByteArray Ldif::assembleLine(const QString &fieldname, const QByteArray &value, uint linelen, bool url)
 {
-    QByteArray result;
-
-    if (url) {
-        result = fieldname.toUtf8() + ":< " + value;
-    } else {
-        bool safe = false;
-        bool isDn = fieldname.toLower() == QLatin1String("dn");
-        // SAFE-INIT-CHAR
-        if (!value.isEmpty() && value[0] > 0 && value[0] != '\n' && value[0] != '\r' && value[0] != ':' && value[0] != '<') {
-            safe = true;
-        }
-
-        // SAFE-CHAR
-        if (safe) {
-            for (int i = 1; i < value.size(); i++) {
-                // allow utf-8 in Distinguished Names
-                if ((isDn && value[i] == 0) || (!isDn && value[i] <= 0) || value[i] == '\r' || value[i] == '\n') {
-                    safe = false;
-                    break;
-                }
-            }
-        }
-
-        if (value.isEmpty()) {
-            safe = true;
-        }
-
-        if (safe) {
-            result = fieldname.toUtf8() + ": " + value;
-        } else {
-            result = fieldname.toUtf8() + ":: " + value.toBase64();
-        }
-
-        if (linelen > 0) {
-            int i = (uint)(fieldname.length() + 2) > linelen ? fieldname.length() + 2 : linelen;
-            while (i < result.length()) {
-                result.insert(i, "\n ");
-                i += linelen + 2;
-            }
-        }
-    }
+    LdifWriter writer;
+    writer.setLineLength(linelen);
+    writer.writeLine(fieldname, value, url);
+    QByteArray result = writer.data();
+    // without the line end
+    result.chop(1);
     return result;
 }
 
@@ -105,32 +127,53 @@ QByteArray Ldif::assembleLine(const QString &fieldname, const QString &value, ui
     return assembleLine(fieldname, value.toUtf8(), linelen, url);
 }
 
-bool Ldif::splitLine(const QByteArray &line, QString &fieldname, QByteArray &value)
+/*
+   Splits an LDIF line. The name is the range [nameBegin, nameEnd) of the line,
+   which is empty if there is no name. Returns true if the value is an URL.
+*/
+static QByteArray kldap_decode_base64(const QByteArray &line, qsizetype begin)
+{
+    // the line may point into the parsed chunk: copy the encoded text once
+    // into a buffer of its own, and decode it in there
+    QByteArray buffer(line.constData() + begin, line.size() - begin);
+    return QByteArray::fromBase64Encoding(std::move(buffer)).decoded;
+}
+
+static bool kldap_split_line(const QByteArray &line, qsizetype &nameBegin, qsizetype &nameEnd, QByteArray &value)
 {
     int position;
     int linelen;
 
     //  qCDebug(LDAP_LOG) << "line:" << QString::fromUtf8(line);
 
-    position = line.indexOf(":");
+    nameBegin = nameEnd = 0;
+    position = line.indexOf(':');
     if (position == -1) {
         // strange: we did not find a fieldname
-        fieldname = QLatin1String("");
-        value = line.trimmed();
+        // the line may point into the parsed chunk, so make sure to copy it
+        const QByteArray trimmed = line.trimmed();
+        value = QByteArray(trimmed.constData(), trimmed.size());
         //    qCDebug(LDAP_LOG) << "value :" << value[0];
         return false;
     }
 
     linelen = line.size();
-    fieldname = QString::fromUtf8(line.left(position).trimmed());
+    // the same as line.left(position).trimmed(), without the copy
+    nameEnd = position;
+    while (nameBegin < nameEnd && QChar::isSpace(uchar(line.at(nameBegin)))) {
+        ++nameBegin;
+    }
+    while (nameEnd > nameBegin && QChar::isSpace(uchar(line.at(nameEnd - 1)))) {
+        --nameEnd;
+    }
 
     if (linelen > (position + 1) && line[position + 1] == ':') {
-        // String is BASE64 encoded -> decode it now.
+        // String is BASE64 encoded -> decode it now, in the copy of the value.
         if (linelen <= (position + 3)) {
             value.resize(0);
             return false;
         }
-        value = QByteArray::fromBase64(line.mid(position + 3));
+        value = kldap_decode_base64(line, position + 3);
         return false;
     }
 
@@ -140,7 +183,7 @@ bool Ldif::splitLine(const QByteArray &line, QString &fieldname, QByteArray &val
             value.resize(0);
             return false;
         }
-        value = QByteArray::fromBase64(line.mid(position + 3));
+        value = kldap_decode_base64(line, position + 3);
         return true;
     }
 
@@ -152,6 +195,24 @@ bool Ldif::splitLine(const QByteArray &line, QString &fieldname, QByteArray &val
     return false;
 }
 
+bool Ldif::splitLine(const QByteArray &line, QString &fieldname, QByteArray &value)
+{
+    qsizetype nameBegin;
+    qsizetype nameEnd;
+    const bool url = kldap_split_line(line, nameBegin, nameEnd, value);
+    fieldname = QString::fromUtf8(line.constData() + nameBegin, nameEnd - nameBegin);
+    return url;
+}
+
+bool Ldif::splitLine(const QByteArray &line, LdapAttributeName &fieldname, QByteArray &value)
+{
+    qsizetype nameBegin;
+    qsizetype nameEnd;
+    const bool url = kldap_split_line(line, nameBegin, nameEnd, value);
+    fieldname = LdapAttributeName::fromUtf8(line.constData() + nameBegin, nameEnd - nameBegin);
+    return url;
+}
+
 bool Ldif::splitControl(const QByteArray &line, QString &oid, bool &critical, QByteArray &value)
 {
     QString tmp;
@@ -186,58 +247,57 @@ Ldif::ParseValue Ldif::processLine()
     }
 
     d->mUrl = splitLine(d->mLine, d->mAttr, d->mValue);
-
-    const QString attrLower = d->mAttr.toLower();
+    const LdifNames &names = *s_names;
 
     switch (d->mEntryType) {
     case Entry_None:
-        if (attrLower == QLatin1String("version")) {
+        if (d->mAttr == names.version) {
             if (!d->mDn.isEmpty()) {
                 retval = Err;
             }
-        } else if (attrLower == QLatin1String("dn")) {
+        } else if (d->mAttr == names.dn) {
             qCDebug(LDAP_LOG) << "ldapentry dn:" << QString::fromUtf8(d->mValue);
             d->mDn = LdapDN(QString::fromUtf8(d->mValue));
             d->mModType = Mod_None;
             retval = NewEntry;
-        } else if (attrLower == QLatin1String("changetype")) {
+        } else if (d->mAttr == names.changetype) {
             if (d->mDn.isEmpty()) {
                 retval = Err;
             } else {
-                QString tmpval = QString::fromUtf8(d->mValue);
+                const QByteArray &tmpval = d->mValue;
                 qCDebug(LDAP_LOG) << "changetype:" << tmpval;
-                if (tmpval == QLatin1String("add")) {
+                if (tmpval == "add") {
                     d->mEntryType = Entry_Add;
-                } else if (tmpval == QLatin1String("delete")) {
+                } else if (tmpval == "delete") {
                     d->mEntryType = Entry_Del;
-                } else if (tmpval == QLatin1String("modrdn") || tmpval == QLatin1String("moddn")) {
+                } else if (tmpval == "modrdn" || tmpval == "moddn") {
                     d->mNewRdn.clear();
                     d->mNewSuperior.clear();
                     d->mDelOldRdn = true;
                     d->mEntryType = Entry_Modrdn;
-                } else if (tmpval == QLatin1String("modify")) {
+                } else if (tmpval == "modify") {
                     d->mEntryType = Entry_Mod;
                 } else {
                     retval = Err;
                 }
             }
-        } else if (attrLower == QLatin1String("control")) {
+        } else if (d->mAttr == names.control) {
             d->mUrl = splitControl(d->mValue, d->mOid, d->mCritical, d->mValue);
             retval = Control;
-        } else if (!d->mAttr.isEmpty() && !d->mValue.isEmpty()) {
+        } else if (d->mAttr.isValid() && !d->mValue.isEmpty()) {
             d->mEntryType = Entry_Add;
             retval = Item;
         }
         break;
     case Entry_Add:
-        if (d->mAttr.isEmpty() && d->mValue.isEmpty()) {
+        if (!d->mAttr.isValid() && d->mValue.isEmpty()) {
             retval = EndEntry;
         } else {
             retval = Item;
         }
         break;
     case Entry_Del:
-        if (d->mAttr.isEmpty() && d->mValue.isEmpty()) {
+        if (!d->mAttr.isValid() && d->mValue.isEmpty()) {
             retval = EndEntry;
         } else {
             retval = Err;
@@ -245,27 +305,27 @@ Ldif::ParseValue Ldif::processLine()
         break;
     case Entry_Mod:
         if (d->mModType == Mod_None) {
-            qCDebug(LDAP_LOG) << "new modtype" << d->mAttr;
-            if (d->mAttr.isEmpty() && d->mValue.isEmpty()) {
+            qCDebug(LDAP_LOG) << "new modtype" << d->mAttr.name();
+            if (!d->mAttr.isValid() && d->mValue.isEmpty()) {
                 retval = EndEntry;
-            } else if (attrLower == QLatin1String("add")) {
+            } else if (d->mAttr == names.add) {
                 d->mModType = Mod_Add;
-            } else if (attrLower == QLatin1String("replace")) {
+            } else if (d->mAttr == names.replace) {
                 d->mModType = Mod_Replace;
-                d->mAttr = QString::fromUtf8(d->mValue);
+                d->mAttr = LdapAttributeName::fromUtf8(d->mValue);
                 d->mValue = QByteArray();
                 retval = Item;
-            } else if (attrLower == QLatin1String("delete")) {
+            } else if (d->mAttr == names.del) {
                 d->mModType = Mod_Del;
-                d->mAttr = QString::fromUtf8(d->mValue);
+                d->mAttr = LdapAttributeName::fromUtf8(d->mValue);
                 d->mValue = QByteArray();
                 retval = Item;
             } else {
                 retval = Err;
             }
         } else {
-            if (d->mAttr.isEmpty()) {
-                if (QString::fromUtf8(d->mValue) == QLatin1String("-")) {
+            if (!d->mAttr.isValid()) {
+                if (d->mValue == "-") {
                     d->mModType = Mod_None;
                 } else if (d->mValue.isEmpty()) {
                     retval = EndEntry;
@@ -278,13 +338,13 @@ Ldif::ParseValue Ldif::processLine()
         }
         break;
     case Entry_Modrdn:
-        if (d->mAttr.isEmpty() && d->mValue.isEmpty()) {
+        if (!d->mAttr.isValid() && d->mValue.isEmpty()) {
             retval = EndEntry;
-        } else if (attrLower == QLatin1String("newrdn")) {
+        } else if (d->mAttr == names.newrdn) {
             d->mNewRdn = QString::fromUtf8(d->mValue);
-        } else if (attrLower == QLatin1String("newsuperior")) {
+        } else if (d->mAttr == names.newsuperior) {
             d->mNewSuperior = QString::fromUtf8(d->mValue);
-        } else if (attrLower == QLatin1String("deleteoldrdn")) {
+        } else if (d->mAttr == names.deleteoldrdn) {
             if (d->mValue.size() > 0 && d->mValue[0] == '0') {
                 d->mDelOldRdn = false;
             } else if (d->mValue.size() > 0 && d->mValue[0] == '1') {
@@ -302,46 +362,64 @@ Ldif::ParseValue Ldif::processLine()
 
 Ldif::ParseValue Ldif::nextItem()
 {
-    ParseValue retval = None;
-    char c = 0;
-
-    while (retval == None) {
-        if (d->mPos < (uint)d->mLdif.size()) {
-            c = d->mLdif.at(d->mPos);
-            d->mPos++;
-            if (d->mIsNewLine && c == '\r') {
+    const char *data = d->mLdif.constData();
+    const uint size = d->mLdif.size();
+
+    while (d->mPos < size) {
+        if (d->mIsNewLine) {
+            const char c = data[d->mPos];
+            if (c == '\n' && d->mLastEolCr) {
+                // the second half of a CRLF line end
+                d->mLastEolCr = false;
+                d->mPos++;
+                continue;
+            }
+            d->mLastEolCr = false;
+            if (c == '\r') {
+                d->mPos++;
                 continue; // handle \n\r line end
             }
-            if (d->mIsNewLine && (c == ' ' || c == '\t')) { // line folding
+            if (c == ' ' || c == '\t') { // line folding
+                d->mPos++;
                 d->mIsNewLine = false;
-                continue;
-            }
-            if (d->mIsNewLine) {
+            } else {
+                // the previous logical line is complete
                 d->mIsNewLine = false;
-                retval = processLine();
+                const ParseValue retval = processLine();
                 d->mLastParseValue = retval;
-                d->mLine.resize(0);
+                d->mLine.clear();
+                d->mLineIsView = false;
                 d->mIsComment = (c == '#');
+                if (retval != None) {
+                    return retval;
+                }
             }
-            if (c == '\n' || c == '\r') {
-                d->mLineNumber++;
-                d->mIsNewLine = true;
-                continue;
-            }
-        } else {
-            retval = MoreData;
-            break;
         }
 
+        // take the rest of the physical line at once
+        const char *begin = data + d->mPos;
+        const char *end = kldap_find_line_end(begin, size - d->mPos);
+        const qsizetype length = end ? end - begin : size - d->mPos;
         if (!d->mIsComment) {
-            d->mLine += c;
+            d->appendLine(begin, length);
+        }
+        d->mPos += length;
+        if (end) {
+            d->mPos++;
+            d->mLineNumber++;
+            d->mLastEolCr = (*end == '\r');
+            d->mIsNewLine = true;
         }
     }
-    return retval;
+
+    // the chunk will be replaced, so keep a copy of the pending line
+    d->detachLine();
+    return MoreData;
 }
 
 void Ldif::endLdif()
 {
+    d->detachLine();
     QByteArray tmp(3, '\n');
     d->mLdif = tmp;
     d->mPos = 0;
@@ -357,13 +435,17 @@ void Ldif::startParsing()
     d->mNewRdn.clear();
     d->mNewSuperior.clear();
     d->mLine = QByteArray();
-    d->mIsNewLine = false;
+    d->mLineIsView = false;
+    // the input starts with a new line, which may be a comment
+    d->mIsNewLine = true;
     d->mIsComment = false;
+    d->mLastEolCr = false;
     d->mLastParseValue = None;
 }
 
 void Ldif::setLdif(const QByteArray &ldif)
 {
+    d->detachLine();
     d->mLdif = ldif;
     d->mPos = 0;
 }
@@ -399,6 +481,11 @@ bool Ldif::delOldRdn() const
 }
 
 QString Ldif::attr() const
+{
+    return d->mAttr.name();
+}
+
+LdapAttributeName Ldif::attributeName() const
 {
     return d->mAttr;
 }
@@ -11,6 +11,7 @@
 #include <QString>
 
 #include "kldap_core_export.h"
+#include "ldapattributename.h"
 #include "ldapdn.h"
 
 // clazy:excludeall=copyable-polymorphic
@@ -61,6 +62,12 @@ public:
      * @return true if value is an URL, false otherwise
      */
     [[nodiscard]] static bool splitLine(const QByteArray &line, QString &fieldname, QByteArray &value);
+    /**
+     * Splits one line from an Ldif file to attribute and value components.
+     * This is the same as the above function, but interns the attribute name
+     * instead of converting it to a new string.
+     */
+    [[nodiscard]] static bool splitLine(const QByteArray &line, LdapAttributeName &fieldname, QByteArray &value);
 
     /**
      * Splits a control specification (without the "control:" directive)
@@ -142,6 +149,11 @@ public:
      */
     [[nodiscard]] QString attr() const;
 
+    /**
+     * Returns the interned attribute name.
+     */
+    [[nodiscard]] LdapAttributeName attributeName() const;
+
     /**
      * Returns the attribute value.
      */
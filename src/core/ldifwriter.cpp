@@ -0,0 +1,238 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldifwriter.h"
+#include "ldapobject_p.h"
+
+#include "ldap_core_debug.h"
+
+#include <QByteArrayView>
+#include <QHash>
+#include <QIODevice>
+
+using namespace KLDAPCore;
+
+// the output is written to the device when it grows beyond this
+#define LDIFWRITER_FLUSH_SIZE (64 * 1024)
+
+class Q_DECL_HIDDEN LdifWriter::LdifWriterPrivate
+{
+public:
+    void writeLine(const QByteArray &name, QByteArrayView value, bool url);
+    const QByteArray &encodedName(const LdapAttributeName &name);
+    void appendFolded(const char *data, qsizetype size);
+    void appendBase64(QByteArrayView value);
+    void maybeFlush();
+
+    QIODevice *mDevice = nullptr;
+    QByteArray mBuffer;
+    QHash<int, QByteArray> mNames;
+    QByteArray mUninternedName;
+    uint mLineLength = 76;
+
+    // the folding state of the current line, mLimit is -1 if it is not folded
+    qsizetype mColumn = 0;
+    qsizetype mLimit = -1;
+};
+
+static bool kldap_is_safe(QByteArrayView value, bool isDn)
+{
+    if (value.isEmpty()) {
+        return true;
+    }
+    // SAFE-INIT-CHAR
+    const uchar first = value.at(0);
+    if (first == 0 || first >= 0x80 || first == '\n' || first == '\r' || first == ':' || first == '<') {
+        return false;
+    }
+    // SAFE-CHAR
+    for (qsizetype i = 1; i < value.size(); ++i) {
+        const uchar c = value.at(i);
+        // allow utf-8 in Distinguished Names
+        if (c == 0 || (!isDn && c >= 0x80) || c == '\r' || c == '\n') {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LdifWriter::LdifWriterPrivate::writeLine(const QByteArray &name, QByteArrayView value, bool url)
+{
+    if (url) {
+        mBuffer += name;
+        mBuffer += ":< ";
+        mBuffer.append(value);
+        mBuffer += '\n';
+        return;
+    }
+
+    // the first line is at least as long as the field name and the separator
+    mColumn = 0;
+    mLimit = mLineLength > 0 ? qMax<qsizetype>(mLineLength, name.size() + 2) : -1;
+    appendFolded(name.constData(), name.size());
+    if (kldap_is_safe(value, name.compare("dn", Qt::CaseInsensitive) == 0)) {
+        appendFolded(": ", 2);
+        appendFolded(value.data(), value.size());
+    } else {
+        appendFolded(":: ", 3);
+        appendBase64(value);
+    }
+    mBuffer += '\n';
+}
+
+const QByteArray &LdifWriter::LdifWriterPrivate::encodedName(const LdapAttributeName &name)
+{
+    if (name.id() == -1) {
+        // not interned, see LdapAttributeName
+        mUninternedName = name.name().toUtf8();
+        return mUninternedName;
+    }
+    auto it = mNames.find(name.id());
+    if (it == mNames.end()) {
+        it = mNames.insert(name.id(), name.name().toUtf8());
+    }
+    return it.value();
+}
+
+void LdifWriter::LdifWriterPrivate::appendFolded(const char *data, qsizetype size)
+{
+    if (mLimit < 0) {
+        mBuffer.append(data, size);
+        return;
+    }
+    while (size > 0) {
+        if (mColumn == mLimit) {
+            // continuation lines start with a space
+            mBuffer.append("\n ", 2);
+            mColumn = 1;
+            mLimit = mLineLength + 1;
+        }
+        const qsizetype count = qMin(size, mLimit - mColumn);
+        mBuffer.append(data, count);
+        mColumn += count;
+        data += count;
+        size -= count;
+    }
+}
+
+void LdifWriter::LdifWriterPrivate::appendBase64(QByteArrayView value)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    // encode a block at a time, so the folding does not need a copy of the whole value
+    char block[1024];
+    qsizetype used = 0;
+    const auto *data = reinterpret_cast<const uchar *>(value.data());
+    const qsizetype size = value.size();
+    for (qsizetype i = 0; i < size; i += 3) {
+        const uint b0 = data[i];
+        const uint b1 = i + 1 < size ? data[i + 1] : 0;
+        const uint b2 = i + 2 < size ? data[i + 2] : 0;
+        block[used++] = alphabet[b0 >> 2];
+        block[used++] = alphabet[((b0 & 0x03) << 4) | (b1 >> 4)];
+        block[used++] = i + 1 < size ? alphabet[((b1 & 0x0f) << 2) | (b2 >> 6)] : '=';
+        block[used++] = i + 2 < size ? alphabet[b2 & 0x3f] : '=';
+        if (used == sizeof(block)) {
+            appendFolded(block, used);
+            used = 0;
+        }
+    }
+    appendFolded(block, used);
+}
+
+void LdifWriter::LdifWriterPrivate::maybeFlush()
+{
+    if (mDevice && mBuffer.size() >= LDIFWRITER_FLUSH_SIZE) {
+        // errors are reported by the next flush(), which writes the rest
+        const qint64 written = mDevice->write(mBuffer);
+        if (written == mBuffer.size()) {
+            mBuffer.resize(0);
+        } else if (written > 0) {
+            mBuffer.remove(0, written);
+        }
+    }
+}
+
+LdifWriter::LdifWriter()
+    : d(new LdifWriterPrivate)
+{
+}
+
+LdifWriter::LdifWriter(QIODevice *device)
+    : d(new LdifWriterPrivate)
+{
+    d->mDevice = device;
+}
+
+LdifWriter::~LdifWriter()
+{
+    flush();
+}
+
+void LdifWriter::setLineLength(uint length)
+{
+    d->mLineLength = length;
+}
+
+uint LdifWriter::lineLength() const
+{
+    return d->mLineLength;
+}
+
+void LdifWriter::writeLine(const QString &fieldname, const QByteArray &value, bool url)
+{
+    d->writeLine(fieldname.toUtf8(), value, url);
+    d->maybeFlush();
+}
+
+void LdifWriter::writeLine(const LdapAttributeName &fieldname, const QByteArray &value, bool url)
+{
+    d->writeLine(d->encodedName(fieldname), value, url);
+    d->maybeFlush();
+}
+
+void LdifWriter::writeObject(const LdapObject &object)
+{
+    const LdapObjectPrivate *o = LdapObjectPrivate::get(object);
+    d->writeLine(QByteArrayLiteral("dn"), o->mDn.toString().toUtf8(), false);
+    const auto attrs = o->sortedByName();
+    for (const auto &attr : attrs) {
+        const QByteArray &name = d->encodedName(attr.second->name);
+        for (int i = attr.second->firstValue; i < attr.second->firstValue + attr.second->valueCount; ++i) {
+            d->writeLine(name, o->valueView(i), false);
+        }
+    }
+    d->mBuffer += '\n';
+    d->maybeFlush();
+}
+
+QByteArray LdifWriter::data() const
+{
+    return d->mBuffer;
+}
+
+void LdifWriter::clear()
+{
+    d->mBuffer.resize(0);
+}
+
+bool LdifWriter::flush()
+{
+    if (!d->mDevice || d->mBuffer.isEmpty()) {
+        return true;
+    }
+    const qint64 written = d->mDevice->write(d->mBuffer);
+    if (written != d->mBuffer.size()) {
+        qCDebug(LDAP_LOG) << "writing LDIF failed:" << d->mDevice->errorString();
+        if (written > 0) {
+            d->mBuffer.remove(0, written);
+        }
+        return false;
+    }
+    d->mBuffer.resize(0);
+    return true;
+}
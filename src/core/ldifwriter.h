@@ -0,0 +1,97 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <memory>
+
+#include "kldap_core_export.h"
+#include "ldapattributename.h"
+#include "ldapobject.h"
+
+class QIODevice;
+
+namespace KLDAPCore
+{
+/**
+ * @brief
+ * This class writes LDIF as UTF-8 bytes.
+ *
+ * Lines are appended to an output buffer which is reused between records,
+ * values are checked, BASE64 encoded and folded in one pass without
+ * intermediate strings. If a device is given, the buffer is written to it
+ * whenever it grows large, and when flush() is called or the writer is
+ * destroyed.
+ *
+ * @code
+ * LdifWriter writer;
+ * writer.writeObject(object);
+ * send(writer.data());
+ * writer.clear();
+ * @endcode
+ */
+class KLDAP_CORE_EXPORT LdifWriter
+{
+public:
+    /**
+     * Constructs a writer which collects the output in data().
+     */
+    LdifWriter();
+    /**
+     * Constructs a writer which writes the output to @p device.
+     */
+    explicit LdifWriter(QIODevice *device);
+    ~LdifWriter();
+
+    /**
+     * Sets the length after which lines are folded, 0 disables folding.
+     * The default is 76.
+     */
+    void setLineLength(uint length);
+    [[nodiscard]] uint lineLength() const;
+
+    /**
+     * Writes a line with the given field name and value, BASE64 encodes
+     * the value if necessary. See Ldif::assembleLine().
+     */
+    void writeLine(const QString &fieldname, const QByteArray &value, bool url = false);
+    /**
+     * This is the same as the above function, but caches the encoded
+     * attribute name.
+     */
+    void writeLine(const LdapAttributeName &fieldname, const QByteArray &value, bool url = false);
+
+    /**
+     * Writes @p object as an LDIF record, followed by an empty line.
+     */
+    void writeObject(const LdapObject &object);
+
+    /**
+     * Returns the output which was not written to the device yet.
+     */
+    [[nodiscard]] QByteArray data() const;
+
+    /**
+     * Discards the output in data(), but keeps the memory for reuse.
+     */
+    void clear();
+
+    /**
+     * Writes the buffered output to the device.
+     * Returns false if writing failed.
+     */
+    bool flush();
+
+private:
+    class LdifWriterPrivate;
+    std::unique_ptr<LdifWriterPrivate> const d;
+    Q_DISABLE_COPY(LdifWriter)
+};
+}
@@ -0,0 +1,59 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapclienttest.h"
+#include "ldapclient.h"
+#include <kldapcore/ldapserver.h>
+#include <QTest>
+QTEST_GUILESS_MAIN(LdapClientTest)
+
+using namespace KLDAPWidgets;
+
+LdapClientTest::LdapClientTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void LdapClientTest::shouldHaveDefaultValues()
+{
+    LdapClient client(2);
+    QCOMPARE(client.clientNumber(), 2);
+    QCOMPARE(client.completionWeight(), 48);
+    QCOMPARE(client.backend(), LdapClient::KioBackend);
+    QVERIFY(!client.isActive());
+    QVERIFY(!client.hasConnectionError());
+}
+
+void LdapClientTest::shouldReportAFailedDirectQuery()
+{
+    // nothing listens on the port, the connection is refused
+    KLDAPCore::LdapServer server;
+    server.setHost(QStringLiteral("127.0.0.1"));
+    server.setPort(1);
+    server.setTimeout(5);
+
+    LdapClient client(0);
+    client.setServer(server);
+    client.setBackend(LdapClient::DirectBackend);
+
+    QStringList signals_;
+    connect(&client, &LdapClient::error, this, [&signals_]() {
+        signals_ << QStringLiteral("error");
+    });
+    connect(&client, &LdapClient::done, this, [&signals_]() {
+        signals_ << QStringLiteral("done");
+    });
+
+    client.startQuery(QStringLiteral("cn=*"));
+    // the failure is reported after startQuery() returned, like from the worker
+    QVERIFY(signals_.isEmpty());
+    QTRY_COMPARE(signals_, QStringList({QStringLiteral("error"), QStringLiteral("done")}));
+    QVERIFY(!client.isActive());
+    QVERIFY(client.hasConnectionError());
+}
+
+#include "moc_ldapclienttest.cpp"
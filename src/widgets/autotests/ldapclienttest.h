@@ -0,0 +1,21 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class LdapClientTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LdapClientTest(QObject *parent = nullptr);
+    ~LdapClientTest() override = default;
+private Q_SLOTS:
+    void shouldHaveDefaultValues();
+    void shouldReportAFailedDirectQuery();
+};
@@ -0,0 +1,127 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapquerytrackertest.h"
+#include "ldapclient.h"
+#include "ldapquerytracker_p.h"
+#include <QTest>
+QTEST_GUILESS_MAIN(LdapQueryTrackerTest)
+
+using namespace KLDAPWidgets;
+
+LdapQueryTrackerTest::LdapQueryTrackerTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void LdapQueryTrackerTest::shouldHaveDefaultValues()
+{
+    LdapQueryTracker tracker;
+    LdapClient client(0);
+    QCOMPARE(tracker.cooldown(), 60 * 1000);
+    QVERIFY(!tracker.hasRunningQueries());
+    QVERIFY(!tracker.isRunning(&client));
+    QVERIFY(!tracker.isSkipped(&client));
+    // a query which was not started can't finish
+    QVERIFY(!tracker.finish(&client, true));
+    QVERIFY(!tracker.isSkipped(&client));
+}
+
+void LdapQueryTrackerTest::shouldCoolDownOnConnectionErrors()
+{
+    LdapQueryTracker tracker;
+    LdapClient down(0);
+    LdapClient up(1);
+    tracker.start(&down);
+    tracker.start(&up);
+    QCOMPARE(tracker.runningClients().count(), 2);
+
+    QVERIFY(tracker.finish(&down, true));
+    QVERIFY(tracker.isSkipped(&down));
+    QVERIFY(tracker.hasRunningQueries());
+    QVERIFY(tracker.finish(&up, false));
+    QVERIFY(!tracker.isSkipped(&up));
+    QVERIFY(!tracker.hasRunningQueries());
+    // done() is only counted once
+    QVERIFY(!tracker.finish(&down, true));
+
+    // an answer ends the cooldown
+    tracker.start(&down);
+    QVERIFY(tracker.finish(&down, false));
+    QVERIFY(!tracker.isSkipped(&down));
+}
+
+void LdapQueryTrackerTest::shouldNotCoolDownOnQueryErrors()
+{
+    LdapQueryTracker tracker;
+    LdapClient client(0);
+    tracker.start(&client);
+    tracker.finish(&client, true);
+    QVERIFY(tracker.isSkipped(&client));
+
+    // e.g. the size limit was exceeded, the server is reachable
+    tracker.start(&client);
+    QVERIFY(tracker.finish(&client, false));
+    QVERIFY(!tracker.isSkipped(&client));
+}
+
+void LdapQueryTrackerTest::shouldNotCoolDownLateServers()
+{
+    LdapQueryTracker tracker;
+    LdapClient fast(0);
+    LdapClient slow(1);
+    LdapClient down(2);
+    tracker.start(&fast);
+    tracker.start(&slow);
+    tracker.start(&down);
+    tracker.finish(&fast, false);
+    tracker.finish(&down, true);
+
+    // the next search cancels the late query, the server is still asked
+    QVERIFY(tracker.isRunning(&slow));
+    tracker.cancel();
+    QVERIFY(!tracker.hasRunningQueries());
+    QVERIFY(!tracker.isSkipped(&fast));
+    QVERIFY(!tracker.isSkipped(&slow));
+    // a canceled search forgets its queries, but not the cooldowns
+    QVERIFY(tracker.isSkipped(&down));
+    QVERIFY(!tracker.finish(&slow, true));
+    QVERIFY(!tracker.isSkipped(&slow));
+    tracker.clear();
+    QVERIFY(!tracker.isSkipped(&down));
+}
+
+void LdapQueryTrackerTest::shouldExpireTheCooldown()
+{
+    LdapQueryTracker tracker;
+    LdapClient client(0);
+    tracker.setCooldown(50);
+    QCOMPARE(tracker.cooldown(), 50);
+    tracker.start(&client);
+    tracker.finish(&client, true);
+    QVERIFY(tracker.isSkipped(&client));
+    QTRY_VERIFY(!tracker.isSkipped(&client));
+}
+
+void LdapQueryTrackerTest::shouldNotCoolDownWithoutCooldown()
+{
+    LdapQueryTracker tracker;
+    LdapClient client(0);
+    tracker.start(&client);
+    tracker.finish(&client, true);
+    QVERIFY(tracker.isSkipped(&client));
+
+    // disabling the cooldown ends the running ones
+    tracker.setCooldown(-1);
+    QCOMPARE(tracker.cooldown(), 0);
+    QVERIFY(!tracker.isSkipped(&client));
+    tracker.start(&client);
+    tracker.finish(&client, true);
+    QVERIFY(!tracker.isSkipped(&client));
+}
+
+#include "moc_ldapquerytrackertest.cpp"
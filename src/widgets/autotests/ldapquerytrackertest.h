@@ -0,0 +1,25 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class LdapQueryTrackerTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LdapQueryTrackerTest(QObject *parent = nullptr);
+    ~LdapQueryTrackerTest() override = default;
+private Q_SLOTS:
+    void shouldHaveDefaultValues();
+    void shouldCoolDownOnConnectionErrors();
+    void shouldNotCoolDownOnQueryErrors();
+    void shouldNotCoolDownLateServers();
+    void shouldExpireTheCooldown();
+    void shouldNotCoolDownWithoutCooldown();
+};
@@ -0,0 +1,145 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapresultcachetest.h"
+#include "ldapclient.h"
+#include "ldapresultcache_p.h"
+#include <kldapcore/ldapfilter.h>
+#include <QTest>
+QTEST_GUILESS_MAIN(LdapResultCacheTest)
+
+using namespace KLDAPWidgets;
+
+namespace
+{
+KLDAPCore::LdapObject person(const QString &cn)
+{
+    KLDAPCore::LdapObject object(QStringLiteral("cn=%1,dc=example,dc=com").arg(cn));
+    object.addValue(QStringLiteral("cn"), cn.toUtf8());
+    return object;
+}
+
+QStringList names(const QList<KLDAPCore::LdapObject> &objects)
+{
+    QStringList result;
+    for (const KLDAPCore::LdapObject &object : objects) {
+        result << QString::fromUtf8(object.value(QStringLiteral("cn")));
+    }
+    return result;
+}
+
+KLDAPCore::LdapFilter prefixFilter(const QString &text)
+{
+    return KLDAPCore::LdapFilter(QStringLiteral("(cn=%1*)").arg(text));
+}
+}
+
+LdapResultCacheTest::LdapResultCacheTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void LdapResultCacheTest::shouldDetectRefinableFilters_data()
+{
+    QTest::addColumn<QString>("filter");
+    QTest::addColumn<bool>("refinable");
+
+    QTest::newRow("default") << QStringLiteral(
+        "&(|(objectclass=person)(objectclass=groupOfNames)(mail=*))"
+        "(|(cn=%1*)(mail=%1*)(givenName=%1*)(sn=%1*))")
+                             << true;
+    QTest::newRow("equality") << QStringLiteral("(cn=%1)") << false;
+    QTest::newRow("substring") << QStringLiteral("(cn=*%1)") << false;
+    QTest::newRow("negation") << QStringLiteral("(&(cn=%1*)(!(mail=*)))") << false;
+    QTest::newRow("approximate") << QStringLiteral("(cn~=%1*)") << false;
+    QTest::newRow("ordering") << QStringLiteral("(&(cn=%1*)(age>=3))") << false;
+    QTest::newRow("extensible") << QStringLiteral("(cn:caseExactMatch:=%1*)") << false;
+}
+
+void LdapResultCacheTest::shouldDetectRefinableFilters()
+{
+    QFETCH(QString, filter);
+    QFETCH(bool, refinable);
+    QCOMPARE(LdapResultCache::isRefinable(filter), refinable);
+}
+
+void LdapResultCacheTest::shouldRefineAnExtendedQuery()
+{
+    LdapResultCache cache;
+    LdapClient client(0);
+    LdapClient other(1);
+    QList<KLDAPCore::LdapObject> objects;
+    QVERIFY(!cache.refine(&client, QStringLiteral("jo"), prefixFilter(QStringLiteral("jo")), objects));
+
+    cache.insert(&client, QStringLiteral("jo"), {person(QStringLiteral("John")), person(QStringLiteral("Joe")), person(QStringLiteral("Johanna"))}, 10);
+    QVERIFY(cache.contains(&client));
+    QVERIFY(!cache.contains(&other));
+    QVERIFY(!cache.refine(&other, QStringLiteral("joh"), prefixFilter(QStringLiteral("joh")), objects));
+
+    QVERIFY(cache.refine(&client, QStringLiteral("joh"), prefixFilter(QStringLiteral("joh")), objects));
+    QCOMPARE(names(objects), QStringList({QStringLiteral("John"), QStringLiteral("Johanna")}));
+    // the prefix is compared case-insensitively, and the refined answer is kept
+    QVERIFY(cache.refine(&client, QStringLiteral("JOHN"), prefixFilter(QStringLiteral("JOHN")), objects));
+    QCOMPARE(names(objects), QStringList({QStringLiteral("John")}));
+    // the same query again
+    QVERIFY(cache.refine(&client, QStringLiteral("john"), prefixFilter(QStringLiteral("john")), objects));
+    QCOMPARE(names(objects), QStringList({QStringLiteral("John")}));
+    // nothing is left
+    QVERIFY(cache.refine(&client, QStringLiteral("johnny"), prefixFilter(QStringLiteral("johnny")), objects));
+    QVERIFY(objects.isEmpty());
+}
+
+void LdapResultCacheTest::shouldDropTheAnswerOfAnotherQuery()
+{
+    LdapResultCache cache;
+    LdapClient client(0);
+    QList<KLDAPCore::LdapObject> objects;
+    cache.insert(&client, QStringLiteral("joh"), {person(QStringLiteral("John"))}, 0);
+
+    // a shorter query may match entries which were not returned
+    QVERIFY(!cache.refine(&client, QStringLiteral("jo"), prefixFilter(QStringLiteral("jo")), objects));
+    QVERIFY(!cache.contains(&client));
+
+    cache.insert(&client, QStringLiteral("joh"), {person(QStringLiteral("John"))}, 0);
+    QVERIFY(!cache.refine(&client, QStringLiteral("ann"), prefixFilter(QStringLiteral("ann")), objects));
+    QVERIFY(!cache.contains(&client));
+
+    cache.insert(&client, QStringLiteral("joh"), {person(QStringLiteral("John"))}, 0);
+    cache.remove(&client);
+    QVERIFY(!cache.contains(&client));
+}
+
+void LdapResultCacheTest::shouldNotKeepSizeLimitedAnswers()
+{
+    LdapResultCache cache;
+    LdapClient client(0);
+    QList<KLDAPCore::LdapObject> objects;
+    cache.insert(&client, QStringLiteral("jo"), {person(QStringLiteral("John"))}, 3);
+    QVERIFY(cache.contains(&client));
+
+    // the server may have more entries than it returned
+    cache.insert(&client, QStringLiteral("jo"), {person(QStringLiteral("John")), person(QStringLiteral("Joe"))}, 2);
+    QVERIFY(!cache.contains(&client));
+    QVERIFY(!cache.refine(&client, QStringLiteral("joh"), prefixFilter(QStringLiteral("joh")), objects));
+}
+
+void LdapResultCacheTest::shouldExpireAnswers()
+{
+    LdapResultCache cache;
+    LdapClient client(0);
+    QList<KLDAPCore::LdapObject> objects;
+    QCOMPARE(cache.timeout(), 60 * 1000);
+    cache.setTimeout(50);
+    cache.insert(&client, QStringLiteral("jo"), {person(QStringLiteral("John"))}, 0);
+    QVERIFY(cache.refine(&client, QStringLiteral("joh"), prefixFilter(QStringLiteral("joh")), objects));
+
+    QTest::qWait(100);
+    QVERIFY(!cache.refine(&client, QStringLiteral("john"), prefixFilter(QStringLiteral("john")), objects));
+    QVERIFY(!cache.contains(&client));
+}
+
+#include "moc_ldapresultcachetest.cpp"
@@ -0,0 +1,25 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class LdapResultCacheTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LdapResultCacheTest(QObject *parent = nullptr);
+    ~LdapResultCacheTest() override = default;
+private Q_SLOTS:
+    void shouldDetectRefinableFilters_data();
+    void shouldDetectRefinableFilters();
+    void shouldRefineAnExtendedQuery();
+    void shouldDropTheAnswerOfAnotherQuery();
+    void shouldNotKeepSizeLimitedAnswers();
+    void shouldExpireAnswers();
+};
@@ -10,14 +10,20 @@
 #include "ldapclient.h"
 #include "ldapclient_debug.h"
 
+#include <kldapcore/ldapconnectionpool.h>
+#include <kldapcore/ldapentrystream.h>
+#include <kldapcore/ldapfilterbuilder.h>
 #include <kldapcore/ldapobject.h>
+#include <kldapcore/ldapsearch.h>
 #include <kldapcore/ldapserver.h>
 #include <kldapcore/ldapurl.h>
 #include <kldapcore/ldif.h>
 
 #include <KIO/Job>
+#include <KLocalizedString>
 
 #include <QPointer>
+#include <QTimer>
 
 using namespace KLDAPCore;
 using namespace KLDAPWidgets;
@@ -35,9 +41,13 @@ public:
     }
 
     void cancelQuery();
+    void startDirectQuery(const KLDAPCore::LdapUrl &url);
+    void slotSearchResult(KLDAPCore::LdapSearch *search);
+    void emitResult(KLDAPCore::LdapObject &object);
 
     void startParseLDIF();
     void parseLDIF(const QByteArray &data);
+    void parseEntries(const QByteArray &data);
     void endParseLDIF();
     void finishCurrentObject();
 
@@ -50,12 +60,21 @@ public:
     KLDAPCore::LdapServer mServer;
     QString mScope;
     QStringList mAttrs;
+    KLDAPCore::LdapFilterBuilder mFilterBuilder;
 
     QPointer<KJob> mJob = nullptr;
+    KLDAPCore::LdapSearch *mSearch = nullptr;
+    LdapClient::Backend mBackend = LdapClient::KioBackend;
     bool mActive = false;
+    bool mConnectionError = false;
 
     KLDAPCore::LdapObject mCurrentObject;
     KLDAPCore::Ldif mLdif;
+    KLDAPCore::LdapEntryStream mEntryStream;
+    // true if the worker sends the binary entry stream instead of LDIF
+    bool mBinary = false;
+    // the entry stream is broken, the rest of the data is ignored
+    bool mStreamError = false;
     int mClientNumber = 0;
     int mCompletionWeight = 0;
 };
@@ -109,19 +128,32 @@ void LdapClient::startQuery(const QString &filter)
     url.setAttributes(d->mAttrs);
     url.setScope(d->mScope == QLatin1String("one") ? KLDAPCore::LdapUrl::One : KLDAPCore::LdapUrl::Sub);
     const QString userFilter = url.filter();
-    QString finalFilter = filter;
     // combine the filter set by the user in the config dialog (url.filter()) and the filter from this query
+    d->mFilterBuilder.clear();
     if (!userFilter.isEmpty()) {
-        finalFilter = QLatin1String("&(") + finalFilter + QLatin1String(")(") + userFilter + QLatin1Char(')');
+        d->mFilterBuilder.beginAnd().filter(filter).filter(userFilter).end();
+    } else {
+        d->mFilterBuilder.filter(filter);
     }
-    url.setFilter(QLatin1Char('(') + finalFilter + QLatin1Char(')'));
+    url.setFilter(d->mFilterBuilder.toString());
 
     qCDebug(LDAPCLIENT_LOG) << "LdapClient: Doing query:" << url.toDisplayString();
+    d->mConnectionError = false;
+
+    if (d->mBackend == DirectBackend) {
+        d->startDirectQuery(url);
+        return;
+    }
 
     d->startParseLDIF();
     d->mActive = true;
     KIO::TransferJob *transfertJob = KIO::get(url, KIO::NoReload, KIO::HideProgressInfo);
+    // workers which don't know the binary stream ignore this and send LDIF
+    transfertJob->addMetaData(QStringLiteral("x-kldap-format"), QStringLiteral("binary"));
     d->mJob = transfertJob;
+    connect(transfertJob, &KIO::TransferJob::mimeTypeFound, this, [this](KIO::Job *, const QString &mimeType) {
+        d->mBinary = mimeType == KLDAPCore::LdapEntryStream::mimeType();
+    });
     connect(transfertJob, &KIO::TransferJob::data, this, [this](KIO::Job *job, const QByteArray &data) {
         d->slotData(job, data);
     });
@@ -138,19 +170,80 @@ void LdapClient::cancelQuery()
     d->cancelQuery();
 }
 
+void LdapClient::setBackend(Backend backend)
+{
+    d->mBackend = backend;
+}
+
+LdapClient::Backend LdapClient::backend() const
+{
+    return d->mBackend;
+}
+
+bool LdapClient::hasConnectionError() const
+{
+    return d->mConnectionError;
+}
+
 void LdapClient::LdapClientPrivate::cancelQuery()
 {
     if (mJob) {
         mJob->kill();
         mJob = nullptr;
     }
+    if (mSearch) {
+        // the search abandons the operation and gives back its connection when it is deleted
+        mSearch->disconnect(q);
+        mSearch->deleteLater();
+        mSearch = nullptr;
+    }
+
+    mActive = false;
+}
 
+void LdapClient::LdapClientPrivate::startDirectQuery(const KLDAPCore::LdapUrl &url)
+{
+    mActive = true;
+    mSearch = new KLDAPCore::LdapSearch;
+    mSearch->setUseConnectionPool(true);
+    q->connect(mSearch, &KLDAPCore::LdapSearch::data, q, [this](KLDAPCore::LdapSearch *, const KLDAPCore::LdapObject &obj) {
+        KLDAPCore::LdapObject object(obj);
+        emitResult(object);
+    });
+    q->connect(mSearch, &KLDAPCore::LdapSearch::result, q, [this](KLDAPCore::LdapSearch *search) {
+        slotSearchResult(search);
+    });
+    if (!mSearch->search(url)) {
+        // report it like the worker would, after startQuery() returned
+        KLDAPCore::LdapSearch *search = mSearch;
+        QTimer::singleShot(0, mSearch, [this, search]() {
+            slotSearchResult(search);
+        });
+    }
+}
+
+void LdapClient::LdapClientPrivate::slotSearchResult(KLDAPCore::LdapSearch *search)
+{
+    if (search != mSearch) {
+        return;
+    }
+    mSearch = nullptr;
     mActive = false;
+    search->deleteLater();
+    if (search->error()) {
+        mConnectionError = KLDAPCore::LdapConnectionPool::isConnectionError(search->error());
+        Q_EMIT q->error(search->errorString());
+    }
+    Q_EMIT q->done();
 }
 
 void LdapClient::LdapClientPrivate::slotData(KIO::Job *, const QByteArray &data)
 {
-    parseLDIF(data);
+    if (mBinary) {
+        parseEntries(data);
+    } else {
+        parseLDIF(data);
+    }
 }
 
 void LdapClient::LdapClientPrivate::slotInfoMessage(KJob *, const QString &info)
@@ -167,6 +260,16 @@ void LdapClient::LdapClientPrivate::slotDone()
     }
     int err = mJob->error();
     if (err && err != KIO::ERR_USER_CANCELED) {
+        switch (err) {
+        case KIO::ERR_CANNOT_CONNECT:
+        case KIO::ERR_CONNECTION_BROKEN:
+        case KIO::ERR_SERVER_TIMEOUT:
+        case KIO::ERR_UNKNOWN_HOST:
+            mConnectionError = true;
+            break;
+        default:
+            break;
+        }
         Q_EMIT q->error(mJob->errorString());
     }
     Q_EMIT q->done();
@@ -176,6 +279,9 @@ void LdapClient::LdapClientPrivate::startParseLDIF()
 {
     mCurrentObject.clear();
     mLdif.startParsing();
+    mEntryStream.startParsing();
+    mBinary = false;
+    mStreamError = false;
 }
 
 void LdapClient::LdapClientPrivate::endParseLDIF()
@@ -185,14 +291,17 @@ void LdapClient::LdapClientPrivate::endParseLDIF()
 void LdapClient::LdapClientPrivate::finishCurrentObject()
 {
     mCurrentObject.setDn(mLdif.dn());
-    KLDAPCore::LdapAttrValue objectclasses;
-    const KLDAPCore::LdapAttrMap::ConstIterator end = mCurrentObject.attributes().constEnd();
-    for (KLDAPCore::LdapAttrMap::ConstIterator it = mCurrentObject.attributes().constBegin(); it != end; ++it) {
-        if (it.key().toLower() == QLatin1String("objectclass")) {
-            objectclasses = it.value();
-            break;
-        }
-    }
+    emitResult(mCurrentObject);
+    mCurrentObject.clear();
+}
+
+void LdapClient::LdapClientPrivate::emitResult(KLDAPCore::LdapObject &object)
+{
+    static const KLDAPCore::LdapAttributeName objectClassName(QStringLiteral("objectClass"));
+    static const KLDAPCore::LdapAttributeName mailName(QStringLiteral("mail"));
+
+    // attribute names are compared case-insensitively
+    const KLDAPCore::LdapAttrValue objectclasses = object.values(objectClassName);
 
     bool groupofnames = false;
     const KLDAPCore::LdapAttrValue::ConstIterator endValue(objectclasses.constEnd());
@@ -204,12 +313,11 @@ void LdapClient::LdapClientPrivate::finishCurrentObject()
     }
 
     if (groupofnames) {
-        KLDAPCore::LdapAttrMap::ConstIterator it = mCurrentObject.attributes().find(QStringLiteral("mail"));
-        if (it == mCurrentObject.attributes().end()) {
+        if (!object.hasAttribute(mailName)) {
             // No explicit mail address found so far?
             // Fine, then we use the address stored in the DN.
             QString sMail;
-            const QStringList lMail = mCurrentObject.dn().toString().split(QStringLiteral(",dc="), Qt::SkipEmptyParts);
+            const QStringList lMail = object.dn().toString().split(QStringLiteral(",dc="), Qt::SkipEmptyParts);
             const int n = lMail.count();
             if (n) {
                 if (lMail.first().startsWith(QLatin1String("cn="), Qt::CaseInsensitive)) {
@@ -223,13 +331,12 @@ void LdapClient::LdapClientPrivate::finishCurrentObject()
                             sMail.append(QLatin1Char('.'));
                         }
                     }
-                    mCurrentObject.addValue(QStringLiteral("mail"), sMail.toUtf8());
+                    object.addValue(mailName, sMail.toUtf8());
                 }
             }
         }
     }
-    Q_EMIT q->result(*q, mCurrentObject);
-    mCurrentObject.clear();
+    Q_EMIT q->result(*q, object);
 }
 
 void LdapClient::LdapClientPrivate::parseLDIF(const QByteArray &data)
@@ -241,14 +348,12 @@ void LdapClient::LdapClientPrivate::parseLDIF(const QByteArray &data)
         mLdif.endLdif();
     }
     KLDAPCore::Ldif::ParseValue ret;
-    QString name;
     do {
         ret = mLdif.nextItem();
         switch (ret) {
         case KLDAPCore::Ldif::Item: {
-            name = mLdif.attr();
             const QByteArray value = mLdif.value();
-            mCurrentObject.addValue(name, value);
+            mCurrentObject.addValue(mLdif.attributeName(), value);
             break;
         }
         case KLDAPCore::Ldif::EndEntry:
@@ -260,6 +365,29 @@ void LdapClient::LdapClientPrivate::parseLDIF(const QByteArray &data)
     } while (ret != KLDAPCore::Ldif::MoreData);
 }
 
+void LdapClient::LdapClientPrivate::parseEntries(const QByteArray &data)
+{
+    if (mStreamError) {
+        return;
+    }
+    if (!data.isEmpty()) {
+        mEntryStream.setData(data);
+    } else {
+        mEntryStream.endData();
+    }
+    KLDAPCore::LdapEntryStream::ParseValue ret;
+    while ((ret = mEntryStream.nextItem()) == KLDAPCore::LdapEntryStream::Entry) {
+        KLDAPCore::LdapObject object = mEntryStream.object();
+        emitResult(object);
+    }
+    if (ret == KLDAPCore::LdapEntryStream::Err) {
+        qCDebug(LDAPCLIENT_LOG) << "LdapClient: invalid entry stream";
+        mStreamError = true;
+        // done() follows when the job ends
+        Q_EMIT q->error(i18n("The LDAP worker sent invalid entries."));
+    }
+}
+
 int LdapClient::clientNumber() const
 {
     return d->mClientNumber;
@@ -35,6 +35,28 @@ class KLDAPWIDGETS_EXPORT LdapClient : public QObject
     Q_OBJECT
 
 public:
+    /**
+     * Describes how the queries reach the LDAP server.
+     */
+    enum Backend {
+        /**
+         * The queries are run by the kio_ldap worker process, which sends
+         * the entries back as LDIF. This is the default.
+         */
+        KioBackend,
+        /**
+         * The queries are run in this process with KLDAPCore::LdapSearch,
+         * on a connection of KLDAPCore::LdapConnectionPool which stays
+         * bound between the queries. The entries are delivered without
+         * being serialized. The first query to a server binds
+         * asynchronously, only StartTLS blocks like in LdapSearch.
+         * LdapClientSearch uses it when the key "ClientBackend" of the
+         * group "LDAP" in its configuration is "Direct".
+         */
+        DirectBackend,
+    };
+    Q_ENUM(Backend)
+
     /**
      * Creates a new ldap client.
      *
@@ -110,11 +132,30 @@ public:
      */
     void startQuery(const QString &filter);
 
+    /**
+     * Sets how the following queries reach the server.
+     */
+    void setBackend(Backend backend);
+
+    /**
+     * Returns how the queries reach the server.
+     */
+    [[nodiscard]] Backend backend() const;
+
     /**
      * Cancels a running query.
      */
     void cancelQuery();
 
+    /**
+     * Returns whether the last query failed at the connection level: the
+     * server could not be reached, dropped the connection or did not
+     * answer in time. Errors of the query itself, like an exceeded size
+     * limit, are not connection errors. It is valid once error() was
+     * emitted and until the next query starts.
+     */
+    [[nodiscard]] bool hasConnectionError() const;
+
 Q_SIGNALS:
     /**
      * This signal is emitted when the query has finished.
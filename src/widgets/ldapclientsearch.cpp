@@ -15,7 +15,12 @@
 #include "ldapsearchclientreadconfigserverjob.h"
 
 #include "ldapclient.h"
+#include "ldapquerytracker_p.h"
+#include "ldapresultcache_p.h"
 
+#include <kldapcore/ldapcompletionindex.h>
+#include <kldapcore/ldapfilter.h>
+#include <kldapcore/ldapfilterbuilder.h>
 #include <kldapcore/ldapserver.h>
 #include <kldapcore/ldapurl.h>
 #include <kldapcore/ldif.h>
@@ -27,6 +32,10 @@
 
 #include <KIO/Job>
 
+#include <QCryptographicHash>
+#include <QDir>
+#include <QHash>
+#include <QSet>
 #include <QStandardPaths>
 #include <QTimer>
 
@@ -38,9 +47,15 @@ public:
     LdapClientSearchPrivate(LdapClientSearch *qq)
         : q(qq)
     {
+        mDeadlineTimer.setSingleShot(true);
+        mDeadlineTimer.setInterval(5 * 1000);
     }
 
-    ~LdapClientSearchPrivate() = default;
+    ~LdapClientSearchPrivate()
+    {
+        saveIndexes();
+        qDeleteAll(mIndexes);
+    }
 
     void readWeighForClient(LdapClient *client, const KConfigGroup &config, int clientNumber);
     void readConfig();
@@ -48,22 +63,51 @@ public:
     void makeSearchData(QStringList &ret, LdapResult::List &resList);
 
     void slotLDAPResult(const KLDAPWidgets::LdapClient &client, const KLDAPCore::LdapObject &);
-    void slotLDAPError(const QString &);
-    void slotLDAPDone();
+    void slotLDAPError(const LdapClient *client, const QString &);
+    void slotLDAPDone(const LdapClient *client);
+    void slotDeadline();
     void slotDataTimer();
     void slotFileChanged(const QString &);
     void init(const QStringList &attributes);
 
+    KLDAPCore::LdapCompletionIndex *index(const LdapClient *client);
+    void searchIndexes(const QList<LdapClient *> &clients);
+    void slotClientDone(const LdapClient *client);
+    void saveIndexes();
+
+    [[nodiscard]] QStringList clientAttributes() const;
+    bool refine(const LdapClient *client, const KLDAPCore::LdapFilter &filter);
+
     LdapClientSearch *const q;
     QList<LdapClient *> mClients;
     QStringList mAttributes;
     QString mSearchText;
     QString mFilter;
     QTimer mDataTimer;
-    int mActiveClients = 0;
+    // the clients whose query runs, searchDone() is emitted when there are none or at the deadline
+    LdapQueryTracker mQueries;
+    bool mSearchDone = false;
     bool mNoLDAPLookup = false;
     LdapResultObject::List mResults;
     QString mConfigFile;
+
+    bool mIndexEnabled = false;
+    QHash<const LdapClient *, KLDAPCore::LdapCompletionIndex *> mIndexes;
+    // the DNs emitted from the index per client, not yet returned by its server
+    QHash<const LdapClient *, QHash<QString, KLDAPCore::LdapDN>> mIndexHits;
+    QSet<const LdapClient *> mFailedClients;
+    QTimer mSaveTimer;
+
+    // the last complete result set of each client, and the query which returned it
+    LdapResultCache mCompleteResults;
+    QHash<const LdapClient *, QList<KLDAPCore::LdapObject>> mCurrentResults;
+    QTimer mRefineTimer;
+    KLDAPCore::LdapFilterBuilder mFilterBuilder;
+
+    QTimer mDeadlineTimer;
+    LdapClient::Backend mBackend = LdapClient::KioBackend;
+    // set by setClientBackend(), which takes precedence over the config
+    bool mBackendSet = false;
 };
 
 LdapClientSearch::LdapClientSearch(QObject *parent)
@@ -96,6 +140,21 @@ void LdapClientSearch::LdapClientSearchPrivate::init(const QStringList &attribut
         "&(|(objectclass=person)(objectclass=groupOfNames)(mail=*))"
         "(|(cn=%1*)(mail=%1*)(givenName=%1*)(sn=%1*))");
 
+    q->connect(&mDeadlineTimer, &QTimer::timeout, q, [this]() {
+        slotDeadline();
+    });
+
+    mRefineTimer.setSingleShot(true);
+    q->connect(&mRefineTimer, &QTimer::timeout, q, [this]() {
+        finish();
+    });
+
+    mSaveTimer.setSingleShot(true);
+    mSaveTimer.setInterval(30 * 1000);
+    q->connect(&mSaveTimer, &QTimer::timeout, q, [this]() {
+        saveIndexes();
+    });
+
     readConfig();
     q->connect(KDirWatch::self(), &KDirWatch::dirty, q, [this](const QString &filename) {
         slotFileChanged(filename);
@@ -130,7 +189,19 @@ QString LdapClientSearch::filter() const
 
 void LdapClientSearch::setFilter(const QString &filter)
 {
-    d->mFilter = filter;
+    if (filter != d->mFilter) {
+        // the indexes and result sets hold the results of the old filter
+        d->saveIndexes();
+        qDeleteAll(d->mIndexes);
+        d->mIndexes.clear();
+        d->mCompleteResults.clear();
+        d->mFilter = filter;
+
+        const QStringList attributes = d->clientAttributes();
+        for (LdapClient *client : std::as_const(d->mClients)) {
+            client->setAttributes(attributes);
+        }
+    }
 }
 
 QStringList LdapClientSearch::attributes() const
@@ -146,6 +217,50 @@ void LdapClientSearch::setAttributes(const QStringList &attrs)
     }
 }
 
+void LdapClientSearch::setCompletionIndexEnabled(bool enabled)
+{
+    d->mIndexEnabled = enabled;
+}
+
+bool LdapClientSearch::completionIndexEnabled() const
+{
+    return d->mIndexEnabled;
+}
+
+void LdapClientSearch::setServerTimeout(int msecs)
+{
+    d->mDeadlineTimer.setInterval(qMax(0, msecs));
+}
+
+int LdapClientSearch::serverTimeout() const
+{
+    return d->mDeadlineTimer.interval();
+}
+
+void LdapClientSearch::setServerCooldown(int msecs)
+{
+    d->mQueries.setCooldown(msecs);
+}
+
+int LdapClientSearch::serverCooldown() const
+{
+    return d->mQueries.cooldown();
+}
+
+void LdapClientSearch::setClientBackend(LdapClient::Backend backend)
+{
+    d->mBackend = backend;
+    d->mBackendSet = true;
+    for (LdapClient *client : std::as_const(d->mClients)) {
+        client->setBackend(backend);
+    }
+}
+
+LdapClient::Backend LdapClientSearch::clientBackend() const
+{
+    return d->mBackend;
+}
+
 QStringList LdapClientSearch::defaultAttributes()
 {
     const QStringList attr{QStringLiteral("cn"), QStringLiteral("mail"), QStringLiteral("givenname"), QStringLiteral("sn")};
@@ -155,11 +270,20 @@ QStringList LdapClientSearch::defaultAttributes()
 void LdapClientSearch::LdapClientSearchPrivate::readConfig()
 {
     q->cancelSearch();
+    saveIndexes();
+    qDeleteAll(mIndexes);
+    mIndexes.clear();
+    mCompleteResults.clear();
+    mQueries.clear();
     qDeleteAll(mClients);
     mClients.clear();
 
     // stolen from KAddressBook
     KConfigGroup config(KLDAPWidgets::LdapClientSearchConfig::config(), QStringLiteral("LDAP"));
+    if (!mBackendSet) {
+        const QString backend = config.readEntry("ClientBackend", QString());
+        mBackend = backend.compare(QLatin1String("Direct"), Qt::CaseInsensitive) == 0 ? LdapClient::DirectBackend : LdapClient::KioBackend;
+    }
     const int numHosts = config.readEntry("NumSelectedHosts", 0);
     if (!numHosts) {
         mNoLDAPLookup = true;
@@ -176,16 +300,17 @@ void LdapClientSearch::LdapClientSearchPrivate::readConfig()
             mNoLDAPLookup = false;
             readWeighForClient(ldapClient, config, j);
 
-            ldapClient->setAttributes(mAttributes);
+            ldapClient->setAttributes(clientAttributes());
+            ldapClient->setBackend(mBackend);
 
             q->connect(ldapClient, &LdapClient::result, q, [this](const LdapClient &client, const KLDAPCore::LdapObject &obj) {
                 slotLDAPResult(client, obj);
             });
-            q->connect(ldapClient, &LdapClient::done, q, [this]() {
-                slotLDAPDone();
+            q->connect(ldapClient, &LdapClient::done, q, [this, ldapClient]() {
+                slotLDAPDone(ldapClient);
             });
-            q->connect(ldapClient, qOverload<const QString &>(&LdapClient::error), q, [this](const QString &str) {
-                slotLDAPError(str);
+            q->connect(ldapClient, qOverload<const QString &>(&LdapClient::error), q, [this, ldapClient](const QString &str) {
+                slotLDAPError(ldapClient, str);
             });
 
             mClients.append(ldapClient);
@@ -228,17 +353,78 @@ void LdapClientSearch::startSearch(const QString &txt)
         d->mSearchText = txt;
     }
 
-    const QString filter = d->mFilter.arg(d->mSearchText);
+    // the search text is escaped, so it can't change the filter
+    d->mFilterBuilder.clear();
+    d->mFilterBuilder.expand(d->mFilter, d->mSearchText);
+    const QString filter = d->mFilterBuilder.toString();
+
+    // clients whose last complete answer covers this query are answered locally
+    QList<LdapClient *> queried;
+    const KLDAPCore::LdapFilter localFilter = d->mFilterBuilder.toFilter();
+    const bool refinable = LdapResultCache::isRefinable(d->mFilter) && localFilter.isValid();
+    for (LdapClient *client : std::as_const(d->mClients)) {
+        if (refinable && d->refine(client, localFilter)) {
+            continue;
+        }
+        if (d->mQueries.isSkipped(client)) {
+            qCDebug(LDAPCLIENT_LOG) << "LdapClientSearch: skipping client" << client->clientNumber() << "after a recent failure";
+            continue;
+        }
+        queried.append(client);
+    }
+
+    if (d->mIndexEnabled) {
+        d->searchIndexes(queried);
+    }
 
-    QList<LdapClient *>::Iterator it(d->mClients.begin());
-    const QList<LdapClient *>::Iterator end(d->mClients.end());
-    for (; it != end; ++it) {
-        (*it)->startQuery(filter);
+    for (LdapClient *client : std::as_const(queried)) {
+        client->startQuery(filter);
         qCDebug(LDAPCLIENT_LOG) << "LdapClientSearch::startSearch()" << filter;
-        ++d->mActiveClients;
+        d->mQueries.start(client);
+    }
+
+    if (queried.isEmpty()) {
+        d->mRefineTimer.start(0);
+        return;
+    }
+    if (!d->mResults.isEmpty()) {
+        d->mDataTimer.setSingleShot(true);
+        d->mDataTimer.start(0);
+    }
+    if (d->mDeadlineTimer.interval() > 0) {
+        d->mDeadlineTimer.start();
     }
 }
 
+QStringList LdapClientSearch::LdapClientSearchPrivate::clientAttributes() const
+{
+    // the attributes tested by the filter are needed to refine the results locally
+    QStringList attributes = mAttributes;
+    const QList<KLDAPCore::LdapAttributeName> filterAttributes = KLDAPCore::LdapFilter(mFilter.arg(QString())).attributes();
+    for (const KLDAPCore::LdapAttributeName &attribute : filterAttributes) {
+        if (!attributes.contains(attribute.name(), Qt::CaseInsensitive)) {
+            attributes.append(attribute.name());
+        }
+    }
+    return attributes;
+}
+
+bool LdapClientSearch::LdapClientSearchPrivate::refine(const LdapClient *client, const KLDAPCore::LdapFilter &filter)
+{
+    QList<KLDAPCore::LdapObject> objects;
+    if (!mCompleteResults.refine(client, mSearchText, filter, objects)) {
+        return false;
+    }
+    for (const KLDAPCore::LdapObject &object : std::as_const(objects)) {
+        LdapResultObject result;
+        result.client = client;
+        result.object = object;
+        mResults.append(result);
+    }
+    qCDebug(LDAPCLIENT_LOG) << "LdapClientSearch: refined the results of client" << client->clientNumber() << "locally";
+    return true;
+}
+
 void LdapClientSearch::cancelSearch()
 {
     QList<LdapClient *>::Iterator it(d->mClients.begin());
@@ -247,12 +433,114 @@ void LdapClientSearch::cancelSearch()
         (*it)->cancelQuery();
     }
 
-    d->mActiveClients = 0;
+    d->mQueries.cancel();
+    d->mSearchDone = false;
     d->mResults.clear();
+    d->mDeadlineTimer.stop();
+    d->mRefineTimer.stop();
+    d->mCurrentResults.clear();
+    d->mIndexHits.clear();
+    d->mFailedClients.clear();
+}
+
+KLDAPCore::LdapCompletionIndex *LdapClientSearch::LdapClientSearchPrivate::index(const LdapClient *client)
+{
+    KLDAPCore::LdapCompletionIndex *index = mIndexes.value(client);
+    if (index) {
+        return index;
+    }
+    // the server is read asynchronously, so the file is only known once it is there
+    const KLDAPCore::LdapServer server = client->server();
+    if (server.host().isEmpty()) {
+        return nullptr;
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QStringLiteral("%1:%2/%3").arg(server.host()).arg(server.port()).arg(server.baseDn().toString()).toUtf8());
+    hash.addData(mFilter.toUtf8());
+    hash.addData(mAttributes.join(QLatin1Char(',')).toUtf8());
+    const QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/kldap");
+    QDir().mkpath(path);
+
+    index = new KLDAPCore::LdapCompletionIndex(path + QStringLiteral("/completion-%1.idx").arg(QString::fromLatin1(hash.result().toHex().left(16))));
+    index->open();
+    mIndexes.insert(client, index);
+    return index;
+}
+
+void LdapClientSearch::LdapClientSearchPrivate::searchIndexes(const QList<LdapClient *> &clients)
+{
+    for (const LdapClient *client : clients) {
+        KLDAPCore::LdapCompletionIndex *clientIndex = index(client);
+        if (!clientIndex) {
+            continue;
+        }
+        const int sizeLimit = client->server().sizeLimit();
+        const QList<KLDAPCore::LdapObject> objects = clientIndex->find(mSearchText, sizeLimit > 0 ? sizeLimit : -1);
+        QHash<QString, KLDAPCore::LdapDN> &hits = mIndexHits[client];
+        for (const KLDAPCore::LdapObject &object : objects) {
+            LdapResultObject result;
+            result.client = client;
+            result.object = object;
+            mResults.append(result);
+            hits.insert(object.dn().toString(), object.dn());
+        }
+    }
+}
+
+void LdapClientSearch::LdapClientSearchPrivate::slotClientDone(const LdapClient *client)
+{
+    const QHash<QString, KLDAPCore::LdapDN> hits = mIndexHits.take(client);
+    const QList<KLDAPCore::LdapObject> objects = mCurrentResults.take(client);
+    if (mFailedClients.remove(client)) {
+        mCompleteResults.remove(client);
+        return;
+    }
+
+    mCompleteResults.insert(client, mSearchText, objects, client->server().sizeLimit());
+
+    // the server did not return these for a query they matched, so they are gone
+    KLDAPCore::LdapCompletionIndex *clientIndex = mIndexes.value(client);
+    if (clientIndex && !hits.isEmpty()) {
+        for (const KLDAPCore::LdapDN &dn : hits) {
+            clientIndex->remove(dn);
+        }
+        mSaveTimer.start();
+    }
+}
+
+void LdapClientSearch::LdapClientSearchPrivate::saveIndexes()
+{
+    mSaveTimer.stop();
+    for (KLDAPCore::LdapCompletionIndex *index : std::as_const(mIndexes)) {
+        if (index->isModified() && !index->save()) {
+            qCWarning(LDAPCLIENT_LOG) << "Unable to save the completion index" << index->fileName();
+        }
+    }
 }
 
 void LdapClientSearch::LdapClientSearchPrivate::slotLDAPResult(const LdapClient &client, const KLDAPCore::LdapObject &obj)
 {
+    mCurrentResults[&client].append(obj);
+
+    if (mIndexEnabled) {
+        if (KLDAPCore::LdapCompletionIndex *clientIndex = index(&client)) {
+            clientIndex->insert(obj);
+            mSaveTimer.start();
+        }
+        auto hits = mIndexHits.find(&client);
+        if (hits != mIndexHits.end() && hits->remove(obj.dn().toString())) {
+            // found in the index, the live entry replaces the indexed one if that is not
+            // emitted yet, otherwise it is left out so that the entry is not listed twice
+            for (LdapResultObject &result : mResults) {
+                if (result.client == &client && result.object.dn() == obj.dn()) {
+                    result.object = obj;
+                    break;
+                }
+            }
+            return;
+        }
+    }
+
     LdapResultObject result;
     result.client = &client;
     result.object = obj;
@@ -264,17 +552,46 @@ void LdapClientSearch::LdapClientSearchPrivate::slotLDAPResult(const LdapClient
     }
 }
 
-void LdapClientSearch::LdapClientSearchPrivate::slotLDAPError(const QString &)
+void LdapClientSearch::LdapClientSearchPrivate::slotLDAPError(const LdapClient *client, const QString &)
 {
-    slotLDAPDone();
+    // done() follows
+    mFailedClients.insert(client);
 }
 
-void LdapClientSearch::LdapClientSearchPrivate::slotLDAPDone()
+void LdapClientSearch::LdapClientSearchPrivate::slotLDAPDone(const LdapClient *client)
 {
-    if (--mActiveClients > 0) {
+    // only a server which can't be reached cools down, not one which refused the query
+    if (!mQueries.finish(client, mFailedClients.contains(client) && client->hasConnectionError())) {
         return;
     }
+    slotClientDone(client);
+
+    if (mSearchDone) {
+        // a late server, its results are merged into those already emitted
+        if (!mResults.isEmpty()) {
+            mDataTimer.setSingleShot(true);
+            mDataTimer.start(0);
+        }
+    } else if (!mQueries.hasRunningQueries()) {
+        finish();
+    } else if (!mResults.isEmpty()) {
+        // don't keep the results of a fast server waiting for the others
+        mDataTimer.setSingleShot(true);
+        mDataTimer.start(0);
+    }
+}
 
+void LdapClientSearch::LdapClientSearchPrivate::slotDeadline()
+{
+    if (mSearchDone || !mQueries.hasRunningQueries()) {
+        return;
+    }
+    // the late servers keep running until the next search cancels them, they
+    // are not left out of it: only a connection error cools a server down
+    const QSet<const LdapClient *> late = mQueries.runningClients();
+    for (const LdapClient *client : late) {
+        qCDebug(LDAPCLIENT_LOG) << "LdapClientSearch: client" << client->clientNumber() << "missed the deadline";
+    }
     finish();
 }
 
@@ -297,6 +614,8 @@ void LdapClientSearch::LdapClientSearchPrivate::slotDataTimer()
 void LdapClientSearch::LdapClientSearchPrivate::finish()
 {
     mDataTimer.stop();
+    mDeadlineTimer.stop();
+    mSearchDone = true;
 
     slotDataTimer(); // Q_EMIT final bunch of data
     Q_EMIT q->searchDone();
@@ -304,6 +623,15 @@ void LdapClientSearch::LdapClientSearchPrivate::finish()
 
 void LdapClientSearch::LdapClientSearchPrivate::makeSearchData(QStringList &ret, KLDAPWidgets::LdapResult::List &resList)
 {
+    static const struct {
+        const KLDAPCore::LdapAttributeName cn{QStringLiteral("cn")};
+        const KLDAPCore::LdapAttributeName dc{QStringLiteral("dc")};
+        const KLDAPCore::LdapAttributeName mail{QStringLiteral("mail")};
+        const KLDAPCore::LdapAttributeName givenName{QStringLiteral("givenName")};
+        const KLDAPCore::LdapAttributeName sn{QStringLiteral("sn")};
+        const KLDAPCore::LdapAttributeName objectClass{QStringLiteral("objectClass")};
+    } names;
+
     LdapResultObject::List::ConstIterator it1(mResults.constBegin());
     const LdapResultObject::List::ConstIterator end1(mResults.constEnd());
     for (; it1 != end1; ++it1) {
@@ -318,16 +646,21 @@ void LdapClientSearch::LdapClientSearchPrivate::makeSearchData(QStringList &ret,
 
         // qCDebug(LDAPCLIENT_LOG) <<"\n\nLdapClientSearch::makeSearchData()";
 
-        KLDAPCore::LdapAttrMap::ConstIterator it2;
-        for (it2 = (*it1).object.attributes().constBegin(); it2 != (*it1).object.attributes().constEnd(); ++it2) {
-            QByteArray val = (*it2).first();
+        const KLDAPCore::LdapObject &object = (*it1).object;
+        const QList<KLDAPCore::LdapAttributeName> attributeNames = object.attributeNames();
+        for (const KLDAPCore::LdapAttributeName &attributeName : attributeNames) {
+            const KLDAPCore::LdapAttrValue values = object.values(attributeName);
+            if (values.isEmpty()) {
+                continue;
+            }
+            QByteArray val = values.first();
             int len = val.size();
             if (len > 0 && '\0' == val[len - 1]) {
                 --len;
             }
             const QString tmp = QString::fromUtf8(val.constData(), len);
-            // qCDebug(LDAPCLIENT_LOG) <<"      key: \"" << it2.key() <<"\" value: \"" << tmp <<"\"";
-            if (it2.key() == QLatin1String("cn")) {
+            // qCDebug(LDAPCLIENT_LOG) <<"      key: \"" << attributeName.name() <<"\" value: \"" << tmp <<"\"";
+            if (attributeName == names.cn) {
                 name = tmp;
                 if (mail.isEmpty()) {
                     mail = tmp;
@@ -340,7 +673,7 @@ void LdapClientSearch::LdapClientSearchPrivate::makeSearchData(QStringList &ret,
                     mail.prepend(tmp);
                 }
                 wasCN = true;
-            } else if (it2.key() == QLatin1String("dc")) {
+            } else if (attributeName == names.dc) {
                 if (mail.isEmpty()) {
                     mail = tmp;
                 } else {
@@ -352,17 +685,17 @@ void LdapClientSearch::LdapClientSearchPrivate::makeSearchData(QStringList &ret,
                     mail.append(tmp);
                 }
                 wasDC = true;
-            } else if (it2.key() == QLatin1String("mail")) {
+            } else if (attributeName == names.mail) {
                 mail = tmp;
-                KLDAPCore::LdapAttrValue::ConstIterator it3 = it2.value().constBegin();
-                for (; it3 != it2.value().constEnd(); ++it3) {
+                KLDAPCore::LdapAttrValue::ConstIterator it3 = values.constBegin();
+                for (; it3 != values.constEnd(); ++it3) {
                     mails.append(QString::fromUtf8((*it3).data(), (*it3).size()));
                 }
-            } else if (it2.key() == QLatin1String("givenName")) {
+            } else if (attributeName == names.givenName) {
                 givenname = tmp;
-            } else if (it2.key() == QLatin1String("sn")) {
+            } else if (attributeName == names.sn) {
                 sn = tmp;
-            } else if (it2.key() == QLatin1String("objectClass") && (tmp == QLatin1String("groupOfNames") || tmp == QLatin1String("kolabGroupOfNames"))) {
+            } else if (attributeName == names.objectClass && (tmp == QLatin1String("groupOfNames") || tmp == QLatin1String("kolabGroupOfNames"))) {
                 isDistributionList = true;
             }
         }
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "kldapwidgets_export.h"
+#include "ldapclient.h"
 
 #include <KLDAPCore/LdapObject>
 #include <QObject>
@@ -15,7 +16,6 @@
 
 namespace KLDAPWidgets
 {
-class LdapClient;
 
 /**
  * Describes the result returned by an LdapClientSearch query.
@@ -133,6 +133,68 @@ public:
 
     [[nodiscard]] static QStringList defaultAttributes();
 
+    /**
+     * Sets whether the results of the searches are kept in a completion
+     * index on disk, one per configured LDAP client.
+     *
+     * When enabled, startSearch() emits the matching entries of the index
+     * right away, before the servers answered. The index is updated from
+     * the live results: entries returned by a server are added or
+     * refreshed, and indexed entries a server did not return for a query
+     * they matched are removed. It is disabled by default.
+     */
+    void setCompletionIndexEnabled(bool enabled);
+
+    /**
+     * Returns whether the completion index is used.
+     */
+    [[nodiscard]] bool completionIndexEnabled() const;
+
+    /**
+     * Sets how long startSearch() waits for the servers, in milliseconds.
+     *
+     * The results are emitted as they arrive. When the time is up,
+     * searchDone() is emitted even if some servers did not answer yet.
+     * Their queries keep running until the next search, and their results
+     * are emitted with searchData() after searchDone(). The default is 5
+     * seconds, 0 waits for all servers.
+     */
+    void setServerTimeout(int msecs);
+
+    /**
+     * Returns how long startSearch() waits for the servers, in milliseconds.
+     */
+    [[nodiscard]] int serverTimeout() const;
+
+    /**
+     * Sets for how long a server which could not be reached is left out of
+     * the following searches, in milliseconds, see
+     * LdapClient::hasConnectionError(). Other errors, like an exceeded size
+     * limit, and a missed deadline don't leave out the server. A server is
+     * used again as soon as it answers one of its queries. The default is
+     * one minute, 0 never leaves out servers.
+     */
+    void setServerCooldown(int msecs);
+
+    /**
+     * Returns for how long a server which could not be reached is left out, in milliseconds.
+     */
+    [[nodiscard]] int serverCooldown() const;
+
+    /**
+     * Sets how the queries of the LDAP clients reach the servers, see
+     * LdapClient::Backend. It overrides the key "ClientBackend" in the
+     * group "LDAP" of the configuration, which selects
+     * LdapClient::DirectBackend when it is "Direct". The default is
+     * LdapClient::KioBackend.
+     */
+    void setClientBackend(LdapClient::Backend backend);
+
+    /**
+     * Returns how the queries of the LDAP clients reach the servers.
+     */
+    [[nodiscard]] LdapClient::Backend clientBackend() const;
+
 Q_SIGNALS:
     /**
      * This signal is emitted whenever new contacts have been found
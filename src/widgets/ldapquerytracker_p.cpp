@@ -0,0 +1,81 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapquerytracker_p.h"
+
+using namespace KLDAPWidgets;
+
+void LdapQueryTracker::setCooldown(int msecs)
+{
+    mCooldown = qMax(0, msecs);
+    if (mCooldown == 0) {
+        mSkipped.clear();
+    }
+}
+
+int LdapQueryTracker::cooldown() const
+{
+    return mCooldown;
+}
+
+void LdapQueryTracker::start(const LdapClient *client)
+{
+    mRunning.insert(client);
+}
+
+bool LdapQueryTracker::finish(const LdapClient *client, bool connectionError)
+{
+    if (!mRunning.remove(client)) {
+        return false;
+    }
+    if (connectionError) {
+        coolDown(client);
+    } else {
+        // the server answered, even if only with an error
+        mSkipped.remove(client);
+    }
+    return true;
+}
+
+void LdapQueryTracker::cancel()
+{
+    mRunning.clear();
+}
+
+void LdapQueryTracker::clear()
+{
+    mRunning.clear();
+    mSkipped.clear();
+}
+
+bool LdapQueryTracker::isRunning(const LdapClient *client) const
+{
+    return mRunning.contains(client);
+}
+
+bool LdapQueryTracker::hasRunningQueries() const
+{
+    return !mRunning.isEmpty();
+}
+
+QSet<const LdapClient *> LdapQueryTracker::runningClients() const
+{
+    return mRunning;
+}
+
+bool LdapQueryTracker::isSkipped(const LdapClient *client) const
+{
+    const auto it = mSkipped.constFind(client);
+    return it != mSkipped.cend() && !it->hasExpired();
+}
+
+void LdapQueryTracker::coolDown(const LdapClient *client)
+{
+    if (mCooldown > 0) {
+        mSkipped.insert(client, QDeadlineTimer(mCooldown));
+    }
+}
@@ -0,0 +1,70 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QSet>
+
+namespace KLDAPWidgets
+{
+class LdapClient;
+
+/**
+ * Tracks the running queries of the clients of an LdapClientSearch, and
+ * leaves out servers which could not be reached for a while.
+ *
+ * A server cools down when its query fails at the connection level. A
+ * slow server does not: its query is canceled by the next search, so it
+ * could never answer and end its cooldown. Any other answer, including
+ * an error of the query itself, ends the cooldown.
+ */
+class LdapQueryTracker
+{
+public:
+    /**
+     * Sets for how long a server is left out, in milliseconds. 0 never
+     * leaves out servers.
+     */
+    void setCooldown(int msecs);
+    [[nodiscard]] int cooldown() const;
+
+    /**
+     * Records that a query of @p client was started.
+     */
+    void start(const LdapClient *client);
+    /**
+     * Records that the query of @p client ended. Returns false if it was
+     * not running.
+     */
+    bool finish(const LdapClient *client, bool connectionError);
+    /**
+     * Forgets the running queries.
+     */
+    void cancel();
+    /**
+     * Forgets the running queries and the cooldowns.
+     */
+    void clear();
+
+    [[nodiscard]] bool isRunning(const LdapClient *client) const;
+    [[nodiscard]] bool hasRunningQueries() const;
+    [[nodiscard]] QSet<const LdapClient *> runningClients() const;
+    /**
+     * Returns whether @p client is left out of the next search.
+     */
+    [[nodiscard]] bool isSkipped(const LdapClient *client) const;
+
+private:
+    void coolDown(const LdapClient *client);
+
+    int mCooldown = 60 * 1000;
+    QSet<const LdapClient *> mRunning;
+    QHash<const LdapClient *, QDeadlineTimer> mSkipped;
+};
+}
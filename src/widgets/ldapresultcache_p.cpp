@@ -0,0 +1,97 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ldapresultcache_p.h"
+
+#include <kldapcore/ldapfilter.h>
+
+using namespace KLDAPWidgets;
+
+bool LdapResultCache::isRefinable(const QString &filter)
+{
+    // a longer query must match a subset of the entries: the search text may only
+    // appear in front of a wildcard, and not below a negation
+    if (filter.contains(QLatin1Char('!'))) {
+        return false;
+    }
+    // approximate, ordering and extensible matches depend on the schema of the server
+    static const QLatin1String schemaMatches[] = {QLatin1String("~="), QLatin1String(">="), QLatin1String("<="), QLatin1String(":=")};
+    for (const QLatin1String &match : schemaMatches) {
+        if (filter.contains(match)) {
+            return false;
+        }
+    }
+    qsizetype pos = 0;
+    while ((pos = filter.indexOf(QLatin1String("%1"), pos)) >= 0) {
+        pos += 2;
+        if (pos >= filter.size() || filter.at(pos) != QLatin1Char('*')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LdapResultCache::setTimeout(qint64 msecs)
+{
+    mTimeout = msecs;
+}
+
+qint64 LdapResultCache::timeout() const
+{
+    return mTimeout;
+}
+
+void LdapResultCache::insert(const LdapClient *client, const QString &searchText, const QList<KLDAPCore::LdapObject> &objects, int sizeLimit)
+{
+    // an answer cut off by the size limit can't be refined locally
+    if (sizeLimit > 0 && objects.count() >= sizeLimit) {
+        mEntries.remove(client);
+        return;
+    }
+    Entry &entry = mEntries[client];
+    entry.searchText = searchText;
+    entry.objects = objects;
+    entry.age.start();
+}
+
+void LdapResultCache::remove(const LdapClient *client)
+{
+    mEntries.remove(client);
+}
+
+void LdapResultCache::clear()
+{
+    mEntries.clear();
+}
+
+bool LdapResultCache::contains(const LdapClient *client) const
+{
+    return mEntries.contains(client);
+}
+
+bool LdapResultCache::refine(const LdapClient *client, const QString &searchText, const KLDAPCore::LdapFilter &filter, QList<KLDAPCore::LdapObject> &objects)
+{
+    auto it = mEntries.find(client);
+    if (it == mEntries.end()) {
+        return false;
+    }
+    if (it->age.hasExpired(mTimeout) || !searchText.startsWith(it->searchText, Qt::CaseInsensitive)) {
+        mEntries.erase(it);
+        return false;
+    }
+
+    objects.clear();
+    for (const KLDAPCore::LdapObject &object : std::as_const(it->objects)) {
+        if (filter.matches(object)) {
+            objects.append(object);
+        }
+    }
+    // a subset of a complete answer is complete too
+    it->searchText = searchText;
+    it->objects = objects;
+    return true;
+}
@@ -0,0 +1,79 @@
+/*
+  This file is part of libkldap.
+  SPDX-FileCopyrightText: 2026 KDE PIM contributors
+
+  SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <kldapcore/ldapobject.h>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+namespace KLDAPCore
+{
+class LdapFilter;
+}
+
+namespace KLDAPWidgets
+{
+class LdapClient;
+
+/**
+ * Keeps the last complete answer of each client of an LdapClientSearch,
+ * so that a query which only grows is answered without the server.
+ *
+ * When the search text is extended, the entries matching the longer
+ * query are a subset of those matching the shorter one, as long as the
+ * filter is refinable. An answer cut off by the size limit is not
+ * complete and is not kept.
+ */
+class LdapResultCache
+{
+public:
+    /**
+     * Returns whether a filter template, with %1 for the search text,
+     * matches a subset of its entries when the search text is extended:
+     * the search text is only followed by a wildcard, and there is no
+     * negation or match which depends on the schema of the server.
+     */
+    [[nodiscard]] static bool isRefinable(const QString &filter);
+
+    /**
+     * Sets for how long an answer is refined, in milliseconds.
+     */
+    void setTimeout(qint64 msecs);
+    [[nodiscard]] qint64 timeout() const;
+
+    /**
+     * Keeps the @p objects which @p client returned for @p searchText,
+     * unless there are @p sizeLimit of them or more.
+     */
+    void insert(const LdapClient *client, const QString &searchText, const QList<KLDAPCore::LdapObject> &objects, int sizeLimit);
+    void remove(const LdapClient *client);
+    void clear();
+    [[nodiscard]] bool contains(const LdapClient *client) const;
+
+    /**
+     * Answers @p searchText for @p client from the kept answer: if it is
+     * younger than timeout() and its search text is a prefix of
+     * @p searchText, returns true and sets @p objects to the kept entries
+     * matching @p filter. They replace the kept answer. Otherwise the
+     * answer is dropped and false is returned.
+     */
+    bool refine(const LdapClient *client, const QString &searchText, const KLDAPCore::LdapFilter &filter, QList<KLDAPCore::LdapObject> &objects);
+
+private:
+    struct Entry {
+        QString searchText;
+        QList<KLDAPCore::LdapObject> objects;
+        QElapsedTimer age;
+    };
+    QHash<const LdapClient *, Entry> mEntries;
+    qint64 mTimeout = 60 * 1000;
+};
+}